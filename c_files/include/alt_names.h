@@ -0,0 +1,98 @@
+#ifndef ALT_NAMES_H
+#define ALT_NAMES_H
+
+/**
+ * Included by numtype.h when building the alternate precision (ALT_PRECISION is
+ * defined). Renames every function and global variable defined by the sources
+ * built in both precisions, so that the alternate build can be linked in
+ * alongside the normal one. Anything added to those sources must be added
+ * here too. See include/ica/alt_precision.h for how the normal build calls the
+ * alternate one.
+ */
+
+// src/matrix.c
+#define mat_newFromFile       mat_newFromFile_alt
+#define mat_freeMatrix        mat_freeMatrix_alt
+#define mat_similar           mat_similar_alt
+#define mat_printToFile       mat_printToFile_alt
+#define mat_eigSym            mat_eigSym_alt
+#define _not_transpose        _not_transpose_alt
+#define _transpose            _transpose_alt
+#define _alpha                _alpha_alt
+#define _beta                 _beta_alt
+#define _beta_add             _beta_add_alt
+#define _jobz                 _jobz_alt
+#define _uplo                 _uplo_alt
+#define _left                 _left_alt
+#define _one                  _one_alt
+#define _n1                   _n1_alt
+#define _info                 _info_alt
+
+// src/ica/aux.c
+#define remmean               remmean_alt
+#define remmeanTranspose      remmeanTranspose_alt
+#define whiten                whiten_alt
+#define computeWhiten         computeWhiten_alt
+#define covarianceWhiten      covarianceWhiten_alt
+#define meanCovariance        meanCovariance_alt
+#define updateStats           updateStats_alt
+#define statsCovariance       statsCovariance_alt
+#define whitenMean            whitenMean_alt
+#define decimate              decimate_alt
+#define unmixObservations     unmixObservations_alt
+#define symDecorrelate        symDecorrelate_alt
+#define iterDecorrelate       iterDecorrelate_alt
+#define warmRotate            warmRotate_alt
+#define jointDiagonalize      jointDiagonalize_alt
+#define monitorStart          monitorStart_alt
+#define monitorPhase          monitorPhase_alt
+#define monitorReport         monitorReport_alt
+#define monitorFinish         monitorFinish_alt
+#define monitorStop           monitorStop_alt
+#define monitorMaxIter        monitorMaxIter_alt
+
+// src/ica/vmath.c
+#define vmath_init            vmath_init_alt
+#define vmath_isa             vmath_isa_alt
+#define vmath_supported       vmath_supported_alt
+#define vmath_isaName         vmath_isaName_alt
+#define vmath_tanh            vmath_tanh_alt
+#define vmath_exp             vmath_exp_alt
+#define vmath_verify          vmath_verify_alt
+
+// src/ica/fastica/contrast.c
+#define contrast_initWork     contrast_initWork_alt
+#define contrast_freeWork     contrast_freeWork_alt
+#define contrast_workSize     contrast_workSize_alt
+#define contrast_nonlin       contrast_nonlin_alt
+#define contrast_applyRule    contrast_applyRule_alt
+#define negent_tanh           negent_tanh_alt
+#define negent_cube           negent_cube_alt
+#define negent_gauss          negent_gauss_alt
+#define tiledContrast         tiledContrast_alt
+
+// src/ica/fastica/fastica.c
+#define fastica_init          fastica_init_alt
+#define fastica_shutdown      fastica_shutdown_alt
+#define fastica_status        fastica_status_alt
+#define fastica               fastica_alt
+
+// src/ica/jade/jade.c
+#define jade_init             jade_init_alt
+#define jade_shutdown         jade_shutdown_alt
+#define jade_status           jade_status_alt
+#define jade                  jade_alt
+
+// src/ica/picard/picard.c
+#define picard_init           picard_init_alt
+#define picard_shutdown       picard_shutdown_alt
+#define picard_status         picard_status_alt
+#define picard                picard_alt
+
+// src/ica/sobi/sobi.c
+#define sobi_init             sobi_init_alt
+#define sobi_shutdown         sobi_shutdown_alt
+#define sobi_status           sobi_status_alt
+#define sobi                  sobi_alt
+
+#endif
@@ -149,6 +149,27 @@ void movingAverage( NUMTYPE *output, const NUMTYPE *input,
 void blinkFlatten( Matrix *mat_S, const int *blinks, int num_blinks, int row,
                    const BlinkParams *b_params );
 
+/**
+ * Name: blinkPattern
+ *
+ * Description:
+ * Finds the average spatial pattern of the given blinks: for each row of
+ * `mat_X', the average value of the row at the blink locations minus the mean
+ * of the row. The result is an estimate of the column of the mixing matrix
+ * that belongs to the blink source, and may be used to seed ICA.
+ *
+ * Parameters:
+ * @param pattern           where to store the pattern (mat_X->rows values)
+ * @param mat_X             the observation matrix
+ * @param blinks            the locations of blinks (column indices)
+ * @param num_blinks        the number of blinks
+ *
+ * Returns:
+ * @return int              zero if there were no blinks, nonzero otherwise
+ */
+int blinkPattern( NUMTYPE *pattern, const Matrix *mat_X, const int *blinks,
+                  int num_blinks );
+
 #ifdef __cplusplus
 }
 #endif
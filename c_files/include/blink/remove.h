@@ -51,6 +51,14 @@ void blinkRemoveFromEDF( const char *input_edf, const char *output_edf,
  * unmodified. This can be used, for example, to prevent the obliteration of
  * blinks from the EOG.
  *
+ * If `mat_W' is not NULL, it is used to carry the ICA unmixing matrix from one
+ * call to the next, which is much faster when consecutive calls are given
+ * similar observations (e.g., overlapping windows of a recording). It must be
+ * allocated with room for a square matrix with one row per EEG sensor. If its
+ * `rows' value is nonzero, ICA starts from the unmixing matrix it holds (see
+ * ica_warm()), and when this function returns it holds the unmixing matrix
+ * that was found. Set its `rows' value to zero before the first call.
+ *
  * Parameters:
  * @param mat_R             where to store the results
  * @param mat_X             the observation matrix
@@ -60,6 +68,7 @@ void blinkRemoveFromEDF( const char *input_edf, const char *output_edf,
  * @param num_keep          the length of the `keep' array
  * @param ica_params        parameters to use for ICA
  * @param b_params          blink detection parameters
+ * @param mat_W             where to keep the unmixing matrix, or NULL
  *
  * Returns:
  * @return int              the number of blinks removed
@@ -67,7 +76,8 @@ void blinkRemoveFromEDF( const char *input_edf, const char *output_edf,
 int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
                  const NUMTYPE *channels, int num_channels,
                  const int *keep, int num_keep,
-                 ICAParams *ica_params, const BlinkParams *b_params );
+                 ICAParams *ica_params, const BlinkParams *b_params,
+                 Matrix *mat_W );
 
 #ifdef __cplusplus
 }
@@ -20,6 +20,9 @@ typedef struct CmdLineArgs {
   int           max_iter;
   ICA_TYPE      implem;
   int           use_gpu;
+  unsigned int  decimate;
+  char const   *calibration;
+  NUMTYPE       time_limit;
 } CmdLineArgs;
 
 /**
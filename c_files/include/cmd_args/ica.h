@@ -2,6 +2,7 @@
 #define CMD_ARGS_H
 
 #include "ica/ica.h"
+#include "ica/vmath.h"
 #include "numtype.h"
 
 #ifdef __cplusplus
@@ -20,6 +21,24 @@ typedef struct CmdLineArgs {
   int           gpu_only;
   int           compare;
   int           print;
+  unsigned int  num_threads;
+  unsigned int  num_components;
+  unsigned int  pca_dims;
+  NUMTYPE       pca_variance;
+  DecorrType    decorr;
+  unsigned int  num_lags;
+  ICAPrecision  precision;
+  VMathISA      vmath;
+  int           verify_vmath;
+  int           warm_start;
+  int           trace;
+  NUMTYPE       time_limit;
+  double        mem_budget;
+  unsigned int  decimate;
+  int           jade_eigenmats;
+  unsigned int  online_block;
+  NUMTYPE       forget;
+  char const   *calibration;
 } CmdLineArgs;
 
 /**
@@ -12,6 +12,7 @@ extern "C" {
 typedef struct CmdLineArgs {
   int demo;
   int samples;
+  char const *calibration;
 } CmdLineArgs;
 
 /**
@@ -0,0 +1,81 @@
+#ifndef ICA_ALT_PRECISION_H
+#define ICA_ALT_PRECISION_H
+
+#include "matrix.h"
+#include "numtype.h"
+#include "ica/ica.h"
+#include "ica/vmath.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The functions of the alternate precision build of the ICA library (see
+ * numtype.h and alt_names.h), as seen from the normal build. Each is the same
+ * as the function without the "_alt" suffix, except that its matrices are in
+ * the alternate precision. The ICAParams struct is shared by both builds. The
+ * workspaces are as opaque as the normal build's, and must only be handed back
+ * to the alternate build's functions.
+ *
+ * These should only be used by the functions that configure and run an ICA
+ * context (see ica.cpp).
+ */
+
+/**
+ * The Matrix struct of the alternate precision build.
+ */
+typedef struct MatrixAlt {
+  NUMTYPE_ALT *elem;
+  int rows;
+  int cols;
+  int ld;
+  int lag;
+} MatrixAlt;
+
+/**
+ * The ICAWhitenStats struct of the alternate precision build. The normal build
+ * never has any, so it always passes NULL.
+ */
+typedef struct ICAWhitenStatsAlt ICAWhitenStatsAlt;
+
+int fastica_init_alt( FastICAState **state, ICAParams *params );
+void fastica_shutdown_alt( FastICAState *st );
+ICAStatus fastica_status_alt( FastICAState const *st );
+unsigned int fastica_alt( FastICAState *st, MatrixAlt *W, MatrixAlt *A,
+                          MatrixAlt *S, NUMTYPE_ALT *mu_S, MatrixAlt const *X,
+                          MatrixAlt const *W_init,
+                          ICAWhitenStatsAlt const *stats );
+
+int jade_init_alt( JadeState **state, ICAParams *params );
+void jade_shutdown_alt( JadeState *st );
+ICAStatus jade_status_alt( JadeState const *st );
+unsigned int jade_alt( JadeState *st, MatrixAlt *W, MatrixAlt *A,
+                       MatrixAlt *S, NUMTYPE_ALT *mu_S, MatrixAlt const *X,
+                       MatrixAlt const *W_init,
+                       ICAWhitenStatsAlt const *stats );
+
+int picard_init_alt( PicardState **state, ICAParams *params );
+void picard_shutdown_alt( PicardState *st );
+ICAStatus picard_status_alt( PicardState const *st );
+unsigned int picard_alt( PicardState *st, MatrixAlt *W, MatrixAlt *A,
+                         MatrixAlt *S, NUMTYPE_ALT *mu_S, MatrixAlt const *X,
+                         MatrixAlt const *W_init,
+                         ICAWhitenStatsAlt const *stats );
+
+int sobi_init_alt( SobiState **state, ICAParams *params );
+void sobi_shutdown_alt( SobiState *st );
+ICAStatus sobi_status_alt( SobiState const *st );
+unsigned int sobi_alt( SobiState *st, MatrixAlt *W, MatrixAlt *A,
+                       MatrixAlt *S, NUMTYPE_ALT *mu_S, MatrixAlt const *X,
+                       MatrixAlt const *W_init,
+                       ICAWhitenStatsAlt const *stats );
+
+VMathISA vmath_init_alt( VMathISA isa );
+VMathISA vmath_isa_alt();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
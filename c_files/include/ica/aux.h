@@ -3,6 +3,7 @@
 
 #include "matrix.h"
 #include "numtype.h"
+#include "ica/ica.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -77,22 +78,34 @@ void remmeanTranspose( NUMTYPE *means, Matrix *Z, Matrix const *X );
  * matrix will be equal to white_Z = W * Z. If transpose is nonzero, then the
  * white_Z matrix will equal white_Z = W * Z'.
  *
+ * If computeWhiten() keeps only k principal components, the white_Z matrix has
+ * its `rows' and `ld' values set to k.
+ *
  * Parameters:
  * @param white_Z   where to store the whitened observations
  * @param whiten    where to store the whitening matrix
  * @param dewhiten  where to store the dewhitening matrix
  * @param Z         where to find the zero-mean observations
  * @param transpose   whether or not the Z matrix must be transposed
+ * @param eig_vals    scratch space for the covariance eigenvalues
+ * @param max_dims    the most principal components to keep (0 for no limit)
+ * @param variance    the fraction of the variance to keep (0 to keep it all)
+ *
+ * Returns:
+ * @return unsigned int   the number of principal components kept
  *
  * PRE:
- * The same preconditions that apply to computeWhiten apply to this function.
+ * The same preconditions that apply to computeWhiten apply to this function,
+ * and white_Z must have room for as many rows as the observations have
+ * variables.
  *
  * POST:
  * The white_Z, whiten, and dewhiten matrices will be filled with column-major
  * formatted data.
  */
-void whiten( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
-             Matrix const *Z, int transpose );
+unsigned int whiten( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
+                     Matrix const *Z, int transpose, NUMTYPE *eig_vals,
+                     unsigned int max_dims, NUMTYPE variance );
 
 /**
  * Name: computeWhiten
@@ -127,25 +140,521 @@ void whiten( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
  * transpose parameter is nonzero, then Y = W * Z' will yield the whitened
  * observations, where .' represents the transpose operator.
  *
+ * The whitening can also reduce the dimension of the observations (principal
+ * component analysis), by only keeping the eigenvectors with the k largest
+ * eigenvalues. Then, for N variables, the whitening matrix is k x N and the
+ * dewhitening matrix is N x k. k is the smallest number of components that
+ * keeps at least `variance' of the total variance, but no more than max_dims.
+ * Zero for either value means no limit. The first k values of eig_vals are
+ * left holding the kept eigenvalues, in ascending order.
+ *
  * Parameters:
  * @param whiten      where to store the whitening matrix
  * @param dewhiten    where to store the dewhitening matrix
  * @param Z           where to find the zero-mean observations
  * @param transpose   whether or not the Z matrix must be transposed
+ * @param eig_vals    scratch space for the covariance eigenvalues
+ * @param max_dims    the most principal components to keep (0 for no limit)
+ * @param variance    the fraction of the variance to keep (0 to keep it all)
+ *
+ * Returns:
+ * @return unsigned int   the number of principal components kept, k
  *
  * PRE:
  * The matrices are all assumed to be initialized, and the Z matrix is expected
- * to be stored in column-major format.
+ * to be stored in column-major format. The eig_vals array must have room for
+ * one value per variable.
  *
- * The whitening/dewhitening matrices will be square matrices with the same
- * number of rows as Z (same number of columns if transpose is nonzero).
+ * The whitening/dewhitening matrices must have room for square matrices with
+ * the same number of rows as Z (same number of columns if transpose is
+ * nonzero), and the dewhitening matrix's `rows' must be that number.
  *
  * POST:
  * The whiten, and dewhiten matrices will be filled with column-major formatted
- * data.
+ * data. The whitening matrix is k x N (with `ld' set to k), and the dewhitening
+ * matrix is N x k.
+ */
+unsigned int computeWhiten( Matrix *whiten, Matrix *dewhiten, Matrix const *Z,
+                            int transpose, NUMTYPE *eig_vals,
+                            unsigned int max_dims, NUMTYPE variance );
+
+/**
+ * Name: covarianceWhiten
+ *
+ * Description:
+ * Computes the whitening and dewhitening matrices from the covariance matrix
+ * of a set of observations, rather than from the observations themselves. See
+ * computeWhiten() for an explanation of the whitening matrices and of the
+ * max_dims and variance parameters.
+ *
+ * Parameters:
+ * @param whiten      where to store the whitening matrix
+ * @param dewhiten    holds the covariance matrix, and where to store the
+ *                    dewhitening matrix
+ * @param eig_vals    scratch space for the covariance eigenvalues
+ * @param max_dims    the most principal components to keep (0 for no limit)
+ * @param variance    the fraction of the variance to keep (0 to keep it all)
+ *
+ * Returns:
+ * @return unsigned int   the number of principal components kept, k
+ *
+ * PRE:
+ * The dewhiten matrix holds the covariance matrix, with its `rows' set to the
+ * number of variables, and the whitening matrix has room for as many values.
+ *
+ * POST:
+ * The whiten and dewhiten matrices are filled in as for computeWhiten().
+ */
+unsigned int covarianceWhiten( Matrix *whiten, Matrix *dewhiten,
+                               NUMTYPE *eig_vals, unsigned int max_dims,
+                               NUMTYPE variance );
+
+// How many values meanCovariance(), updateStats(), and whitenMean() center at
+// a time. Blocks of observations this size stay in the cache while they are
+// being centered and multiplied, and are big enough for GEMM to run at full
+// speed.
+#define WHITEN_BLOCK 8192
+
+/**
+ * Name: meanCovariance
+ *
+ * Description:
+ * Computes the means and the covariance matrix of a set of observation
+ * vectors in a single pass over them, without making a zero-mean copy.
+ *
+ * See updateStats() for how the observations are handled.
+ *
+ * Parameters:
+ * @param means     where to store the calculated means
+ * @param C         where to store the covariance matrix
+ * @param X         the observations vectors
+ * @param block     scratch space for a centered block of observations
+ * @param sums      scratch space for one value per variable
+ *
+ * PRE:
+ * The X matrix is assumed to be stored in column-major format, with each row
+ * a variable and each column an observation, and must have at least two
+ * columns. C must have room for a square matrix with as many rows as X. The
+ * block array must have room for as many values as X, or for the larger of
+ * WHITEN_BLOCK and X->rows values if X has more than that.
+ *
+ * POST:
+ * The means and C parameters will be filled with data. C is stored in
+ * column-major format, and is scaled by 1 / (T - 1) like COVARIANCE. As with
+ * COVARIANCE, only its upper triangle is computed.
+ */
+void meanCovariance( NUMTYPE *means, Matrix *C, Matrix const *X,
+                     NUMTYPE *block, NUMTYPE *sums );
+
+/**
+ * Name: updateStats
+ *
+ * Description:
+ * Adds a set of observation vectors to, or removes them from, the means and
+ * scatter matrix (the sum of the outer products of the zero-mean observations)
+ * of `count' observations. This costs O(N^2 * T) for T observations of N
+ * variables, no matter how many observations the statistics already hold.
+ *
+ * The observations are handled a block of columns at a time. Each block is
+ * centered on its own mean, and its mean and scatter matrix are merged with
+ * those of the other observations using the pairwise update of Chan et al.,
+ * which is as stable as centering all of the observations on their overall
+ * mean. Removing observations undoes the update. Each removal rounds a little,
+ * so statistics that have had many observations removed should now and then
+ * be found again from scratch.
+ *
+ * Parameters:
+ * @param means     the means of the observations so far
+ * @param M2        the scatter matrix of the observations so far
+ * @param count     the number of observations so far
+ * @param X         the observation vectors to add or remove
+ * @param remove    nonzero to remove the observations rather than add them
+ * @param block     scratch space for a centered block of observations
+ * @param sums      scratch space for one value per variable
+ *
+ * PRE:
+ * The X matrix is stored as for meanCovariance(), and the block array must have
+ * as much room. M2 has as many rows and columns as X has rows. Observations
+ * that are removed must have been added before. If `count' is zero, the means
+ * and M2 must be zero.
+ *
+ * POST:
+ * The means, M2, and count parameters describe the observations, with those
+ * of X added or removed. Only the upper triangle of M2 is updated (see
+ * SYRK_ADD). Removing all of them (or more) zeroes the statistics.
+ */
+void updateStats( NUMTYPE *means, Matrix *M2, unsigned int *count,
+                  Matrix const *X, int remove, NUMTYPE *block, NUMTYPE *sums );
+
+/**
+ * Name: statsCovariance
+ *
+ * Description:
+ * Finds the means and covariance matrix of a set of observations from
+ * statistics kept with updateStats() (see ica_addStats()), instead of from the
+ * observations themselves.
+ *
+ * Parameters:
+ * @param means     where to store the means
+ * @param C         where to store the covariance matrix
+ * @param stats     the statistics of the observations, or NULL
+ * @param X         the observations the statistics were kept for
+ *
+ * Returns:
+ * @return int      zero if the statistics can't be used for X, nonzero
+ *                  otherwise
+ *
+ * PRE:
+ * C must have room for a square matrix with as many rows as X.
+ *
+ * POST:
+ * If the statistics are for as many variables and observations as X has, the
+ * means and C are filled in, as for meanCovariance(). Otherwise, they are left
+ * alone.
+ */
+int statsCovariance( NUMTYPE *means, Matrix *C, ICAWhitenStats const *stats,
+                     Matrix const *X );
+
+/**
+ * Name: whitenMean
+ *
+ * Description:
+ * Whitens a set of observations that still have their means, given their
+ * means and covariance matrix (see meanCovariance()), returning the resulting
+ * whitened observations and the whitening and dewhitening matrices.
+ *
+ * If we let W be the whitening matrix, then the white_Z matrix will be equal to
+ * white_Z = W * (X - means). The means are removed a block of columns at a time
+ * as the observations are multiplied, so X is only read once. See
+ * computeWhiten() for an explanation of the whitening matrices and of the
+ * max_dims and variance parameters.
+ *
+ * Parameters:
+ * @param white_Z   where to store the whitened observations
+ * @param whiten    where to store the whitening matrix
+ * @param dewhiten  holds the covariance matrix, and where to store the
+ *                  dewhitening matrix
+ * @param X         the observation vectors
+ * @param means     the means of the observations
+ * @param block     scratch space for a centered block of observations
+ * @param eig_vals  scratch space for the covariance eigenvalues
+ * @param max_dims  the most principal components to keep (0 for no limit)
+ * @param variance  the fraction of the variance to keep (0 to keep it all)
+ *
+ * Returns:
+ * @return unsigned int   the number of principal components kept
+ *
+ * PRE:
+ * The dewhiten matrix holds the covariance matrix of X, with its `rows' set to
+ * the number of variables. The block array must have room for as many values
+ * as it needs for meanCovariance(), and white_Z must have room for as many rows
+ * as the observations have variables.
+ *
+ * POST:
+ * The white_Z, whiten, and dewhiten matrices will be filled with column-major
+ * formatted data, as for whiten().
+ */
+unsigned int whitenMean( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
+                         Matrix const *X, NUMTYPE const *means, NUMTYPE *block,
+                         NUMTYPE *eig_vals, unsigned int max_dims,
+                         NUMTYPE variance );
+
+// How many decimated observations on either side of each one the low-pass
+// filter of decimate() reaches, and so how many values its taps array needs.
+#define DECIMATE_ZEROS 4
+#define DECIMATE_TAPS( factor ) (2 * DECIMATE_ZEROS * (factor) + 1)
+
+/**
+ * Name: decimate
+ *
+ * Description:
+ * Low-pass filters a set of observation vectors and keeps every factor-th
+ * one. The filter is a Hamming-windowed sinc with its cutoff at the Nyquist
+ * frequency of the decimated observations, and is only evaluated at the
+ * observations that are kept, so this costs O(N * T * DECIMATE_ZEROS) for T
+ * observations of N variables. The observations at either end are repeated
+ * as far as the filter reaches past them.
+ *
+ * Filtering every variable the same way doesn't change how the sources are
+ * mixed (X = A * S gives filter(X) = A * filter(S)), so the decimated
+ * observations have the same mixing matrix as the originals.
+ *
+ * Parameters:
+ * @param Y         where to store the decimated observations
+ * @param X         the observation vectors
+ * @param factor    how many observations to replace with one (at least 2)
+ * @param taps      scratch space for DECIMATE_TAPS(factor) filter taps
+ *
+ * PRE:
+ * Y must have room for X->rows by ceil(X->cols / factor) values.
+ *
+ * POST:
+ * Y is filled in (column-major, with ld = X->rows), and its size is set.
+ */
+void decimate( Matrix *Y, Matrix const *X, unsigned int factor,
+               NUMTYPE *taps );
+
+/**
+ * Name: unmixObservations
+ *
+ * Description:
+ * Computes the source signals and their means from a set of observation
+ * vectors and an unmixing matrix, as the implementations do at the end of a
+ * run:
+ *
+ *    mu_S = W * mean(X)
+ *    S    = W * X - mu_S
+ *
+ * This is how an unmixing matrix learned from decimated observations (see
+ * decimate()) is applied at the full rate.
+ *
+ * Parameters:
+ * @param S         where to store the source signals
+ * @param mu_S      where to store the means of the source signals
+ * @param W         the unmixing matrix
+ * @param X         the observation vectors
+ * @param means     scratch space for one value per variable
+ *
+ * PRE:
+ * S must have room for W->rows by X->cols values.
+ */
+void unmixObservations( Matrix *S, NUMTYPE *mu_S, Matrix const *W,
+                        Matrix const *X, NUMTYPE *means );
+
+/**
+ * Name: symDecorrelate
+ *
+ * Description:
+ * Symmetrically decorrelates the rows of a square matrix, computing:
+ *
+ *    B = (M * M')^(-1/2) * M
+ *
+ * The rows of the result are orthonormal, and are as close as possible to the
+ * rows of M. This is the orthogonalization step of the symmetric FastICA
+ * update, and is also used to turn an initial guess at an unmixing matrix into
+ * a rotation.
+ *
+ * Parameters:
+ * @param B           where to store the decorrelated matrix
+ * @param M           the matrix to decorrelate
+ * @param T1          scratch space, the same size as M
+ * @param T2          scratch space, the same size as M
+ * @param eig_vals    scratch space for M's row count of eigenvalues
+ *
+ * PRE:
+ * All of the matrices must be distinct, square, and the same size.
+ */
+void symDecorrelate( Matrix *B, Matrix const *M, Matrix *T1, Matrix *T2,
+                     NUMTYPE *eig_vals );
+
+/**
+ * Name: iterDecorrelate
+ *
+ * Description:
+ * Computes the same symmetric decorrelation as symDecorrelate(),
+ *
+ *    B = (M * M')^(-1/2) * M
+ *
+ * but without an eigenvalue decomposition, using the iteration that the GPU
+ * FastICA implementation uses:
+ *
+ *    B = M / sqrt( ||M * M'|| )
+ *    B = 1.5 * B - 0.5 * B * B' * B    (repeated)
+ *
+ * The scaling makes every singular value of B at most one, and the iteration
+ * then drives them all up to one. It stops once trace(B * B') is within
+ * ITER_DECORR_EPSILON per row of the number of rows, or after
+ * ITER_DECORR_MAX_ITER iterations. All of the O(n^3) work is done with matrix
+ * multiplications.
+ *
+ * Parameters:
+ * @param B           where to store the decorrelated matrix
+ * @param M           the matrix to decorrelate
+ * @param T1          scratch space, the same size as M
+ * @param T2          scratch space, the same size as M
+ *
+ * Returns:
+ * @return int        the number of iterations performed
+ *
+ * PRE:
+ * All of the matrices must be distinct, square, and the same size.
+ */
+int iterDecorrelate( Matrix *B, Matrix const *M, Matrix *T1, Matrix *T2 );
+
+/**
+ * Name: warmRotate
+ *
+ * Description:
+ * Turns a guess at the unmixing matrix into the matching rotation of the
+ * whitened observations, R, by making the rows of W_init * dewhiten
+ * orthonormal, and folds that rotation into the whitened observations and the
+ * whitening/dewhitening matrices:
+ *
+ *    Z <- R * Z,  whiten <- R * whiten,  dewhiten <- dewhiten * R'
+ *
+ * This is how the Jacobi implementations (JADE and SOBI) start from a guess;
+ * their sweeps then only need to find the (small) rotation that is left over.
+ * The results are swapped into place rather than copied, so Z and temp trade
+ * storage, and whiten, dewhiten, and warm trade storage among themselves.
+ *
+ * Parameters:
+ * @param Z           the whitened observations
+ * @param whiten      the whitening matrix
+ * @param dewhiten    the dewhitening matrix
+ * @param W_init      the guess at the unmixing matrix
+ * @param R           where to store the rotation
+ * @param warm        scratch space, the same size as R
+ * @param temp        scratch space, the same size as Z
+ * @param T1          scratch space, the same size as R
+ * @param T2          scratch space, the same size as R
+ * @param eig_vals    scratch space for R's row count of eigenvalues
+ *
+ * PRE:
+ * R, warm, T1, and T2 must be distinct and square, with one row per whitened
+ * variable. W_init must have that many rows.
+ */
+void warmRotate( Matrix *Z, Matrix *whiten, Matrix *dewhiten,
+                 Matrix const *W_init, Matrix *R, Matrix *warm, Matrix *temp,
+                 Matrix *T1, Matrix *T2, NUMTYPE *eig_vals );
+
+/**
+ * Keeps track of the progress of a run for the observer given in ICAParams (see
+ * ICAObserver), and of whether the run should stop early (see the `cancel' and
+ * `time_limit' parameters). Each implementation keeps one in its state, starts
+ * it at the beginning of a run, and then marks the end of every phase of the
+ * run with monitorPhase(), which charges the time since the last mark to that
+ * phase. Between iterations, it asks monitorStop() whether to carry on.
+ *
+ * When there is no observer and no time limit, none of the monitor functions
+ * read the clock, so that monitoring costs next to nothing.
+ */
+typedef struct ICAMonitor {
+  ICAObserver observer;
+  void *data;
+  ICAProgress progress;
+  unsigned long long mark;      // When the current phase began (nanoseconds).
+  int const volatile *cancel;   // Stop once this is nonzero (may be NULL).
+  unsigned long long deadline;  // Stop at this time (nanoseconds, 0 for never).
+  ICAStatus status;             // How the run ended (or is going to).
+} ICAMonitor;
+
+/**
+ * Name: monitorStart
+ *
+ * Description:
+ * Readies a monitor for a new run: picks up the observer from the parameters,
+ * clears the progress and timings, and starts timing the first phase.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ * @param params    the parameters of the run
+ */
+void monitorStart( ICAMonitor *mon, ICAParams const *params );
+
+/**
+ * Name: monitorPhase
+ *
+ * Description:
+ * Charges the time since the last mark to the given phase, and starts timing
+ * the next phase.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ * @param phase     the phase that just ended
+ */
+void monitorPhase( ICAMonitor *mon, ICAPhase phase );
+
+/**
+ * Name: monitorReport
+ *
+ * Description:
+ * Tells the observer that an iteration/sweep has finished. The time spent in
+ * the observer itself is not charged to any phase.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ * @param iter      the number of iterations/sweeps finished so far
+ * @param metric    the convergence metric of the last iteration/sweep
+ */
+void monitorReport( ICAMonitor *mon, unsigned int iter, double metric );
+
+/**
+ * Name: monitorFinish
+ *
+ * Description:
+ * Gives the observer its last report of the run, with `done' set. The metric
+ * is that of the last report.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ * @param iter      the total number of iterations/sweeps of the run
+ */
+void monitorFinish( ICAMonitor *mon, unsigned int iter );
+
+/**
+ * Name: monitorStop
+ *
+ * Description:
+ * Checks whether the run should stop early, because its `cancel' flag has been
+ * raised or its time limit has run out, and if so sets the monitor's status to
+ * match. Once a run has been told to stop, it is always told to stop.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ *
+ * Returns:
+ * @return int      nonzero if the run should stop, zero otherwise
+ */
+int monitorStop( ICAMonitor *mon );
+
+/**
+ * Name: monitorMaxIter
+ *
+ * Description:
+ * Records that the run reached its iteration/sweep limit without converging,
+ * unless it was stopped early for another reason.
+ *
+ * Parameters:
+ * @param mon       the monitor
+ */
+void monitorMaxIter( ICAMonitor *mon );
+
+/**
+ * Name: jointDiagonalize
+ *
+ * Description:
+ * Finds the rotation that makes a set of symmetric matrices as close to
+ * diagonal as possible all at once, using Jacobi (Givens) sweeps. Every pair
+ * of rows/columns p, q is rotated by the angle that minimizes the sum of the
+ * squares of the p,q'th elements of all of the matrices, and sweeps over all
+ * of the pairs continue until no rotation angle exceeds `threshold' (or after
+ * JOINT_DIAG_MAX_SWEEPS sweeps, which the monitor is told of, or as soon as the
+ * monitor says to stop).
+ *
+ * The rotations are applied to the matrices, of which only the upper triangles
+ * are kept up to date, and accumulated into V (V <- V * J for each rotation J).
+ * If M is one of the original matrices, then V' * M * V is the nearly diagonal
+ * result.
+ *
+ * This is the joint diagonalization step of both JADE, which diagonalizes the
+ * fourth-order cumulant matrices, and SOBI, which diagonalizes time-lagged
+ * covariance matrices.
+ *
+ * Parameters:
+ * @param mats        the matrices, each n x n and stored one after another
+ * @param num_mats    the number of matrices
+ * @param V           the rotation to update (n x n, usually the identity)
+ * @param threshold   the smallest rotation angle worth applying
+ * @param mon         reported to after every sweep, with the largest rotation
+ *                    angle, and polled between rotations to see whether to
+ *                    stop early (may be NULL)
+ *
+ * Returns:
+ * @return unsigned int   the number of sweeps performed
  */
-void computeWhiten( Matrix *whiten, Matrix *dewhiten, Matrix const *Z,
-                    int transpose );
+unsigned int jointDiagonalize( NUMTYPE *mats, unsigned int num_mats,
+                               Matrix *V, NUMTYPE threshold,
+                               ICAMonitor *mon );
 
 #ifdef __cplusplus
 }
@@ -3,6 +3,7 @@
 
 #include "matrix.h"
 #include "numtype.h"
+#include "ica/ica.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,13 +34,195 @@ extern "C" {
  * elements stored on the device (GPU).
  *
  * Each function applies a different definition for g(x).
+ *
+ * The element-wise tanh() and exp() evaluations of the CPU functions are done
+ * with the vectorized functions in ica/vmath.h.
+ *
+ * The CPU functions never form the full W * Z product. Instead, they walk the
+ * columns of Z in cache-sized tiles (see tiledContrast()), so that each tile of
+ * Z is read from main memory once per iteration and all of the work for that
+ * tile is done while it is still in cache.
+ *
+ * All of the scratch space needed by the CPU functions lives in a ContrastWork
+ * structure that is allocated once, by contrast_initWork(), before any
+ * iterations are run. The contrast functions themselves never allocate memory.
+ */
+
+// How many bytes a tile of Z together with the matching tile of W * Z should
+// occupy. This is chosen to fit comfortably within a per-core L2 cache.
+#define TILE_BYTES    (128 * 1024)
+
+/**
+ * Scratch space used by the CPU contrast functions. The sizes of the buffers
+ * are set up by contrast_initWork() and depend only on the dimensions of the
+ * data and on the number of threads in the thread pool at the time of the call.
  */
+typedef struct ContrastWork {
+  unsigned int num_tasks; // How many tasks the buffers have room for.
+  unsigned int num_stats; // Max number of per-row statistics per task.
+  int tile_cols;          // Width (in columns) of a tile of Z.
+  int num_var;            // Max number of rows in W.
+  int num_obs;            // Number of observations (columns of Z).
+  NUMTYPE *tiles;         // Per-task storage for a tile of W * Z.
+  NUMTYPE *scratch;       // Per-task scratch space for the nonlinearity.
+  NUMTYPE *GZ;            // Per-task partial g(W * Z) * Z' products.
+  NUMTYPE *stats;         // Per-task partial statistics.
+  NUMTYPE *sums;          // The summed statistics.
+} ContrastWork;
 
 // The general form of a contrast function for the CPU. Three matrix parameters
 // are given. The first is where the next guess at the unmixing matrix will be
 // stored. The second is where to find the current guess at the unmixing matrix,
-// and the third is where to find the whitened set of observation data.
-typedef void (*ContFunc)( Matrix*, Matrix*, Matrix* );
+// and the third is where to find the whitened set of observation data. The last
+// parameter is the scratch space the function may use.
+typedef void (*ContFunc)( Matrix*, Matrix*, Matrix*, ContrastWork* );
+
+// The general form of a nonlinearity applied by tiledContrast(). The first
+// parameter is a tile of the product W * Z, which should be overwritten with
+// g(W * Z). The tile is always stored contiguously (its ld equals its number of
+// rows). The second parameter points to per-row statistics of the tile that
+// the function should add to (e.g. the sum of g`(W * Z) over the tile's
+// columns). The statistics are stored with statistic k of row r at index
+// k * rows + r. The third parameter is scratch space with room for as many
+// elements as the tile, and the last is the data given to tiledContrast().
+typedef void (*NonlinFunc)( Matrix*, NUMTYPE*, NUMTYPE*, void* );
+
+/**
+ * Name: contrast_initWork
+ *
+ * Description:
+ * Allocates the scratch space needed to apply a contrast function to a W
+ * matrix with at most `num_var' rows and a Z matrix with `num_var' rows and
+ * `num_obs' columns, accumulating at most `num_stats' statistics per row.
+ *
+ * The scratch space is split between as many tasks as there are threads in the
+ * thread pool when this function is called. If the pool later grows, the extra
+ * threads simply go unused by the contrast functions.
+ *
+ * If `max_bytes' is nonzero, the scratch space is kept within that many bytes
+ * by narrowing the tiles of Z, and then by splitting them between fewer tasks.
+ * This only fails if not even one task with the narrowest tile fits.
+ *
+ * Parameters:
+ * @param work        the workspace to set up
+ * @param num_var     the number of variables (rows of Z)
+ * @param num_obs     the number of observations (columns of Z)
+ * @param num_stats   the maximum number of statistics per row
+ * @param max_bytes   the most bytes to allocate, or zero for no limit
+ *
+ * Returns:
+ * @return int        zero if a problem occurs, nonzero otherwise
+ */
+int contrast_initWork( ContrastWork *work, int num_var, int num_obs,
+                       unsigned int num_stats, size_t max_bytes );
+
+/**
+ * Name: contrast_workSize
+ *
+ * Description:
+ * Returns how many bytes contrast_initWork() would allocate for the same
+ * arguments, given the current size of the thread pool.
+ *
+ * Parameters:
+ * @param num_var     the number of variables (rows of Z)
+ * @param num_obs     the number of observations (columns of Z)
+ * @param num_stats   the maximum number of statistics per row
+ * @param max_bytes   the most bytes to allocate, or zero for no limit
+ *
+ * Returns:
+ * @return size_t     the size of the workspace in bytes, or zero if it can't
+ *                    be kept within `max_bytes'
+ */
+size_t contrast_workSize( int num_var, int num_obs, unsigned int num_stats,
+                          size_t max_bytes );
+
+/**
+ * Name: contrast_freeWork
+ *
+ * Description:
+ * Frees the scratch space allocated by contrast_initWork(). Calling this on a
+ * workspace that has already been freed does nothing.
+ *
+ * Parameters:
+ * @param work    the workspace to free
+ */
+void contrast_freeWork( ContrastWork *work );
+
+/**
+ * Name: tiledContrast
+ *
+ * Description:
+ * Computes the two quantities needed by the learning rule without ever forming
+ * the full W * Z product:
+ *
+ *    GZ    = g(W * Z) * Z'
+ *    stats = the per-row statistics accumulated by `nonlin'
+ *
+ * Z is walked in tiles of columns small enough that a tile of Z and the
+ * matching tile of W * Z fit in cache. For each tile, W * Z, the nonlinearity,
+ * its statistics, and the rank update of GZ are all computed before moving on
+ * to the next tile. Tiles are split between the threads of the thread pool,
+ * each of which accumulates its own partial results that are summed at the end.
+ *
+ * Neither GZ nor stats are scaled by the number of observations.
+ *
+ * The `stats' array may be the work->sums array. The `data' pointer is handed
+ * to every call of `nonlin', so that it can use values (read only, since it
+ * runs on several threads at once) belonging to whoever called this function.
+ *
+ * Parameters:
+ * @param GZ          where to store g(W * Z) * Z' (W->rows x Z->rows)
+ * @param stats       where to store the statistics (num_stats * W->rows)
+ * @param num_stats   how many statistics per row `nonlin' accumulates
+ * @param W           the current guess at the unmixing matrix W
+ * @param Z           the whitened set of observation data
+ * @param nonlin      the nonlinearity to apply
+ * @param data        passed on to `nonlin' (may be NULL)
+ * @param work        scratch space set up by contrast_initWork()
+ */
+void tiledContrast( Matrix *GZ, NUMTYPE *stats, unsigned int num_stats,
+                    Matrix const *W, Matrix const *Z, NonlinFunc nonlin,
+                    void *data, ContrastWork *work );
+
+/**
+ * Name: contrast_nonlin
+ *
+ * Description:
+ * Returns the nonlinearity that negent_tanh(), negent_cube(), or negent_gauss()
+ * hands to tiledContrast() for the given contrast type. Each accumulates one
+ * statistic per row, the sum of g`(W * Z). This lets callers that see Z a few
+ * columns at a time sum GZ and the statistics over all of the columns before
+ * applying the learning rule with contrast_applyRule().
+ *
+ * Parameters:
+ * @param type        the contrast type
+ *
+ * Returns:
+ * @return NonlinFunc the nonlinearity, which takes no data
+ */
+NonlinFunc contrast_nonlin( ContrastType type );
+
+/**
+ * Name: contrast_applyRule
+ *
+ * Description:
+ * Applies the learning rule to the unscaled sums found by tiledContrast():
+ *
+ *    W_next = (GZ - diag(dg_sum) * W) / T
+ *
+ * where GZ is what W_next holds on entry and T is the number of observations.
+ *
+ * Parameters:
+ * @param W_next      holds GZ, and where to store the next guess at W
+ * @param W           the current guess at the unmixing matrix W
+ * @param dg_sum      the sum of g`(W * Z) along each row
+ * @param num_obs     the number of observations the sums are over
+ *
+ * PRE:
+ * W_next and W are the same size, and are stored contiguously.
+ */
+void contrast_applyRule( Matrix *W_next, Matrix const *W,
+                         NUMTYPE const *dg_sum, int num_obs );
 
 /**
  * Name: negent_tanh
@@ -51,8 +234,9 @@ typedef void (*ContFunc)( Matrix*, Matrix*, Matrix* );
  * @param W_next  where to store the next guess at the unmixing matrix W
  * @param W       the current guess at the unmixing matrix W
  * @param Z       the whitened set of observation data
+ * @param work    scratch space set up by contrast_initWork()
  */
-void negent_tanh( Matrix *W_next, Matrix *W, Matrix *Z );
+void negent_tanh( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work );
 
 /**
  * Name: negent_cube
@@ -64,8 +248,9 @@ void negent_tanh( Matrix *W_next, Matrix *W, Matrix *Z );
  * @param W_next  where to store the next guess at the unmixing matrix W
  * @param W       the current guess at the unmixing matrix W
  * @param Z       the whitened set of observation data
+ * @param work    scratch space set up by contrast_initWork()
  */
-void negent_cube( Matrix *W_next, Matrix *W, Matrix *Z );
+void negent_cube( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work );
 
 /**
  * Name: negent_gauss
@@ -77,8 +262,9 @@ void negent_cube( Matrix *W_next, Matrix *W, Matrix *Z );
  * @param W_next  where to store the next guess at the unmixing matrix W
  * @param W       the current guess at the unmixing matrix W
  * @param Z       the whitened set of observation data
+ * @param work    scratch space set up by contrast_initWork()
  */
-void negent_gauss( Matrix *W_next, Matrix *W, Matrix *Z );
+void negent_gauss( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work );
 
 #ifdef __cplusplus
 }
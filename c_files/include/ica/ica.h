@@ -4,12 +4,32 @@
 #include "matrix.h"
 #include "numtype.h"
 
+#include <stddef.h>
+
 // Default values used in the ICA algorithm.
 #define DEF_IMPLEM      ICA_FASTICA
 #define DEF_EPSILON     0.0001
 #define DEF_CONTRAST    NONLIN_TANH
 #define DEF_MAX_ITER    400
 #define DEF_GPU_DEVICE  1
+#define DEF_NUM_THREADS 0
+#define DEF_NUM_COMPONENTS 0
+#define DEF_PCA_DIMS    0
+#define DEF_PCA_VARIANCE 0.0
+#define DEF_DECORR      DECORR_EIG
+#define DEF_NUM_LAGS    100
+#define DEF_PRECISION   ICA_PRECISION_NATIVE
+#define DEF_TIME_LIMIT  0.0
+#define DEF_MEM_BUDGET  (256 * 1024 * 1024)
+#define DEF_DECIMATE    1
+#define DEF_JADE_EIGENMATS 0
+#define DEF_FORGET      0.999
+#define DEF_CAL_MAX_VAR 64
+#define DEF_CAL_SAMPLES 3
+
+// The implementations and contrasts a calibration table times, in the order of
+// its columns (see ica_calibrate()).
+#define ICA_CAL_CHOICES 8
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +45,15 @@ typedef enum ContrastType {
   NONLIN_GAUSS
 } ContrastType;
 
+/**
+ * This enum is used to switch how the symmetric FastICA update makes the rows
+ * of the unmixing matrix orthonormal again after every iteration.
+ */
+typedef enum DecorrType {
+  DECORR_EIG,     // Using an eigenvalue decomposition (LAPACK xSYEV).
+  DECORR_ITER     // Iteratively, using only matrix multiplications.
+} DecorrType;
+
 /**
  * This enum is used to switch between implementations of ICA (e.g. JADE and
  * FastICA).
@@ -32,23 +61,177 @@ typedef enum ContrastType {
 typedef enum ICA_TYPE {
   ICA_FASTICA,
   ICA_JADE,
+  ICA_PICARD,
+  ICA_SOBI,
+  ICA_AUTO        // Chosen per problem size from a calibration table.
 } ICA_TYPE;
 
+/**
+ * This enum is used to switch which floating point precision the CPU
+ * implementations compute in (see numtype.h).
+ */
+typedef enum ICAPrecision {
+  ICA_PRECISION_NATIVE,   // NUMTYPE, as chosen at compile time by USE_SINGLE.
+  ICA_PRECISION_SINGLE,   // float
+  ICA_PRECISION_DOUBLE,   // double
+  ICA_PRECISION_MIXED     // Iterate in float, then finish up in double.
+} ICAPrecision;
+
+/**
+ * How an ICA run ended (see ica_status()).
+ */
+typedef enum ICAStatus {
+  ICA_STATUS_CONVERGED,   // The convergence criteria were met.
+  ICA_STATUS_MAX_ITER,    // The iteration/sweep limit was reached first.
+  ICA_STATUS_CANCELLED,   // The `cancel' flag was raised.
+  ICA_STATUS_DEADLINE,    // The `time_limit' ran out.
+  ICA_STATUS_FAILED       // The run couldn't be started (e.g. out of memory).
+} ICAStatus;
+
+/**
+ * The phases of an ICA run that are timed for an observer (see ICAObserver).
+ * What falls in the middle two depends on the implementation:
+ *
+ *   implem   | ICA_PHASE_CONTRAST            | ICA_PHASE_ORTHO
+ *  ----------+-------------------------------+--------------------------------
+ *   FastICA  | the fixed-point update        | decorrelating the unmixing
+ *            |                               | matrix (or, when deflating,
+ *            |                               | Gram-Schmidt)
+ *   JADE     | the fourth-order cumulants    | the joint diagonalization
+ *   Picard   | the gradient and loss (line   | the L-BFGS direction and the
+ *            | search steps included)        | rotations
+ *   SOBI     | the lagged covariances        | the joint diagonalization
+ */
+typedef enum ICAPhase {
+  ICA_PHASE_REMMEAN,      // Finding the observation means and covariance.
+  ICA_PHASE_WHITEN,       // Whitening the observations (and PCA).
+  ICA_PHASE_CONTRAST,
+  ICA_PHASE_ORTHO,
+  ICA_PHASE_FINALIZE,     // Finding W, A, S, and mu_S.
+  ICA_NUM_PHASES
+} ICAPhase;
+
+/**
+ * What an observer (see ICAObserver) is told about the progress of a run.
+ */
+typedef struct ICAProgress {
+  ICA_TYPE      implem;
+  unsigned int  iter;       // Iterations/sweeps finished so far.
+  int           done;       // Nonzero for the last report of a run.
+  double        metric;     // The convergence metric of the last iteration
+                            // (1 - min |cos| for FastICA, the largest rotation
+                            // angle for JADE and SOBI, the largest element of
+                            // the relative gradient for Picard).
+  unsigned long long ns[ICA_NUM_PHASES];  // Nanoseconds spent so far in each
+                                          // phase.
+} ICAProgress;
+
+/**
+ * An optional function called by the CPU implementations after every
+ * iteration/sweep, and once more (with `done' set) at the end of every run,
+ * along with the `observer_data' given in the ICAParams struct.
+ */
+typedef void (*ICAObserver)( ICAProgress const *progress, void *data );
+
 /**
  * A struct of this type must be passed to the ica() function. The meaning of
- * each value is described in the ica_init() function comment block.
+ * each value is described in the ica_init() function comment block. Its
+ * floating point values are always in the native precision (see numtype.h),
+ * whichever precision the computation runs in.
  */
 typedef struct ICAParams {
   ICA_TYPE     implem;
-  NUMTYPE      epsilon;
+  NUMTYPE_NATIVE epsilon;
   ContrastType contrast;
   unsigned int max_iter;
   unsigned int num_var;
   unsigned int num_obs;
   int          gpu_device;
   int          use_gpu;
+  unsigned int num_threads;
+  unsigned int num_components;
+  NUMTYPE_NATIVE const *seed;
+  unsigned int pca_dims;
+  NUMTYPE_NATIVE pca_variance;
+  DecorrType   decorr;
+  unsigned int num_lags;
+  ICAPrecision precision;
+  ICAObserver  observer;
+  void        *observer_data;
+  int const volatile *cancel;
+  NUMTYPE_NATIVE time_limit;
+  unsigned int decimate;
+  int          jade_eigenmats;
 } ICAParams;
 
+/**
+ * An ICA context: a copy of the configuration parameters together with all of
+ * the workspace the chosen implementation needs. Each context owns its own
+ * implementation state, so separate contexts may run at the same time (see
+ * ica_create() for the exceptions).
+ */
+typedef struct ICAContext ICAContext;
+
+/**
+ * The statistics of a set of observations that whitening needs: their means
+ * and scatter matrix (the sum of the outer products of the zero-mean
+ * observations). Observations can be added and removed a few columns at a
+ * time, so when the observations are a window sliding over a recording, the
+ * statistics of each window are found from the previous window's, for a cost
+ * that depends on how far the window moved rather than on its size. See
+ * ica_createStats() and ica_runStats().
+ */
+typedef struct ICAWhitenStats {
+  unsigned int num_var;   // How many variables the observations have.
+  unsigned int count;     // How many observations the statistics describe.
+  NUMTYPE     *means;     // The means of the observations.
+  Matrix       scatter;   // The scatter matrix (upper triangle only).
+  NUMTYPE     *work;      // Scratch space for adding and removing observations.
+} ICAWhitenStats;
+
+/**
+ * A source of observations too large to hold in memory at once, for
+ * ica_stream(). The observations are read a chunk of columns at a time, in
+ * order, as often as the computation needs them (once per iteration, plus
+ * twice more). `read' fills the columns of X (num_var x X->cols, with ld equal
+ * to num_var) with the observations starting at observation `first', and
+ * returns zero if it can't. If `write' isn't NULL, it is handed the source
+ * signals for the observations starting at `first' once the unmixing matrix is
+ * known, a chunk at a time and in order, and returns zero to stop. Both are
+ * given `data'.
+ *
+ * The workspace used by ica_stream(), including the chunks, is kept within
+ * `mem_budget' bytes (DEF_MEM_BUDGET if it is zero). The chunks are as wide as
+ * the budget allows, so a bigger budget means fewer calls to `read'. Besides
+ * the chunks, the budget must hold a few num_var x num_var matrices and the
+ * contrast function's tiles (see contrast_initWork()). The tiles take about
+ * TILE_BYTES (see contrast.h) per thread, but are narrowed (and split between
+ * fewer threads) when the budget is tight; ica_stream() only fails if not even
+ * a chunk of two observations and one narrow tile fit.
+ */
+typedef struct ICAStream {
+  unsigned int num_var;   // How many variables the observations have.
+  unsigned int num_obs;   // How many observations there are.
+  size_t mem_budget;      // Most bytes of workspace to use (0 for default).
+  int (*read)( void *data, Matrix *X, unsigned int first );
+  int (*write)( void *data, Matrix const *S, unsigned int first );
+  void *data;
+} ICAStream;
+
+/**
+ * A running FastICA estimate that is updated as blocks of observations arrive
+ * (see ica_createOnline()), for separating sources while they are recorded
+ * rather than rerunning ICA over a window of them.
+ */
+typedef struct ICAOnline ICAOnline;
+
+/**
+ * How long each implementation and contrast takes to separate observations of
+ * a range of sizes on this host, from which ICA_AUTO picks one for each run
+ * (see ica_calibrate() and ica_setCalibration()).
+ */
+typedef struct ICACalibration ICACalibration;
+
 /**
  * Data passed to a call to icaMainThread.
  */
@@ -57,6 +240,8 @@ typedef struct ICAThreadData {
   Matrix *W, *A, *S;
   NUMTYPE *mu_S;
   const ICAParams *ica_params;
+  const Matrix *W_init;     // Optional initial guess at W (see ica_warm()).
+  ICAContext *ctx;          // Context to run in, or NULL for the default one.
 } ICAThreadData;
 
 /**
@@ -65,7 +250,14 @@ typedef struct ICAThreadData {
  * Description:
  * This function is meant to provide an entry point for a pthread that will
  * perform ICA on the data contained in the ICAThreadData struct that should be
- * its parameter.
+ * its parameter. If the struct's `W_init' field is not NULL, ica_warm() is used
+ * to start from that guess at the unmixing matrix.
+ *
+ * If the struct's `ctx' field is not NULL, that context is configured with the
+ * `ica_params' and the ICA computation is run in it (see ica_run()), so that
+ * several of these threads may run at once, each with its own context.
+ * Otherwise the library's default context is used, as by ica_init() and
+ * ica_warm().
  *
  * Parameters:
  * @param data        should be of type ICAThreadData*; the data to process
@@ -83,9 +275,11 @@ void *icaMainThread( void *data );
  * Name: ica_init
  *
  * Description:
- * Initializes the ICA library, allocated memory and setting up global variables
- * needed to run the ICA computation. This function should be called before any
- * other ICA function, and whenever the values in the ICAParams struct change.
+ * Initializes the ICA library's default context, allocating memory and setting
+ * up everything needed to run the ICA computation. This function should be
+ * called before any other ICA function, and whenever the values in the
+ * ICAParams struct change. It is the same as calling ica_configure() on the
+ * default context, which ica(), ica_warm(), and ica_shutdown() also use.
  *
  * This function takes in a pointer to an ICAParams struct containing some
  * configuration parameters for the function. If this function is not called,
@@ -98,7 +292,17 @@ void *icaMainThread( void *data );
  *    implem      | ICA_FASTICA | Which ICA implementation to use. If one of the
  *                |             | JADE implementations is specified, the
  *                |             | `epsilon', `contrast', and `max_iter'
- *                |             | parameters are unused.
+ *                |             | parameters are unused. ICA_PICARD (CPU only)
+ *                |             | always uses a tanh() density, so it ignores
+ *                |             | `contrast'. ICA_SOBI (CPU only) uses the
+ *                |             | time structure of the sources rather than
+ *                |             | their distributions (see `num_lags'), and
+ *                |             | also ignores those three parameters.
+ *                |             | ICA_AUTO picks FastICA (and its contrast) or
+ *                |             | JADE for each size of X, from the table set
+ *                |             | with ica_setCalibration() (see ica_choose()),
+ *                |             | and is FastICA with the given contrast on the
+ *                |             | CPU if no table is set.
  *  --------------+-------------+-----------------------------------------------
  *    epsilon     |      0.0001 | Convergence criteria. An iterative process is
  *                |             | used to find the unmixing matrix, and this
@@ -109,6 +313,8 @@ void *icaMainThread( void *data );
  *                |             | Convergence means that the cosine of the angle
  *                |             | between the previous unmixing vectors and the
  *                |             | current vectors is within 'epsilon' of +/- 1.
+ *                |             | For ICA_PICARD, it means that no element of
+ *                |             | the relative gradient exceeds 'epsilon'.
  *  --------------+-------------+-----------------------------------------------
  *    contrast    | NONLIN_TANH | The contrast/learning rule that is used to
  *                |             | find the mixing matrix. Valid values that use
@@ -139,6 +345,150 @@ void *icaMainThread( void *data );
  *                |             | should be different from the device supporting
  *                |             | a display.
  *  --------------+-------------+-----------------------------------------------
+ *    num_threads |           0 | How many threads the CPU implementations may
+ *                |             | use. Parallel work is handed to a persistent
+ *                |             | thread pool shared by the whole library, and
+ *                |             | this sets the number of threads in that pool.
+ *                |             | Zero means one thread per online processor.
+ *  --------------+-------------+-----------------------------------------------
+ *  num_components|           0 | How many independent components to extract.
+ *                |             | Zero (or any value >= num_var) extracts all of
+ *                |             | them using the symmetric FastICA update. A
+ *                |             | smaller value, k, makes the CPU FastICA
+ *                |             | implementation estimate one component at a
+ *                |             | time with Gram-Schmidt deflation, stopping
+ *                |             | after k components, so that the cost scales
+ *                |             | with k * num_var * num_obs rather than with
+ *                |             | num_var^2 * num_obs. The other implementations
+ *                |             | ignore this value and extract every component.
+ *  --------------+-------------+-----------------------------------------------
+ *    seed        |        NULL | Optional initial guess for the first
+ *                |             | component when extracting fewer than num_var
+ *                |             | components: a spatial pattern (num_var
+ *                |             | values, i.e. a column of the mixing matrix)
+ *                |             | such as the average scalp distribution of an
+ *                |             | eyeblink. The array is read on every call to
+ *                |             | ica(), so it must remain valid until the next
+ *                |             | call to ica_init(). Changing only this value
+ *                |             | does not cause the library to reinitialize.
+ *  --------------+-------------+-----------------------------------------------
+ *    pca_dims    |           0 | The most principal components to keep when
+ *                |             | whitening the observations. The CPU
+ *                |             | implementations then separate at most this
+ *                |             | many sources, working in the reduced space,
+ *                |             | which is much cheaper when there are many
+ *                |             | variables. Zero means no limit.
+ *  --------------+-------------+-----------------------------------------------
+ *  pca_variance  |         0.0 | The fraction (in (0, 1)) of the total
+ *                |             | variance of the observations that the kept
+ *                |             | principal components must explain. The
+ *                |             | fewest components that do so are kept (but no
+ *                |             | more than pca_dims). Zero (or one) keeps them
+ *                |             | all. Ignored by the GPU implementations.
+ *  --------------+-------------+-----------------------------------------------
+ *    decorr      |  DECORR_EIG | How the CPU FastICA implementation keeps the
+ *                |             | rows of the unmixing matrix orthonormal when
+ *                |             | extracting every component. Valid values are:
+ *                |             |  DECORR_EIG   W = (W * W')^(-1/2) * W, using
+ *                |             |               an eigenvalue decomposition
+ *                |             |  DECORR_ITER  W = 1.5 * W - 0.5 * W * W' * W,
+ *                |             |               repeated until W * W' = I (as
+ *                |             |               the GPU implementation does)
+ *                |             | The iterative method only uses matrix
+ *                |             | multiplications, which can be faster for
+ *                |             | small numbers of variables.
+ *  --------------+-------------+-----------------------------------------------
+ *    num_lags    |         100 | How many time lags the SOBI implementation
+ *                |             | uses. The covariance matrices of the whitened
+ *                |             | observations at lags of 1, 2, ..., num_lags
+ *                |             | observations are jointly diagonalized, which
+ *                |             | separates sources with different
+ *                |             | autocorrelations (e.g., slow eyeblinks from
+ *                |             | faster brain activity). Zero means the
+ *                |             | default. The cost grows linearly with this
+ *                |             | value.
+ *  --------------+-------------+-----------------------------------------------
+ *    precision   |      NATIVE | Which precision the CPU implementations
+ *                |             | compute in. Valid values are:
+ *                |             |  ICA_PRECISION_NATIVE  NUMTYPE
+ *                |             |  ICA_PRECISION_SINGLE  float
+ *                |             |  ICA_PRECISION_DOUBLE  double
+ *                |             |  ICA_PRECISION_MIXED   iterate in float, then
+ *                |             |     whiten again and finish in double,
+ *                |             |     starting from the float result (a few
+ *                |             |     iterations)
+ *                |             | The matrices passed to and from the library
+ *                |             | are always NUMTYPE, and are converted if the
+ *                |             | computation runs in the other precision. The
+ *                |             | mixed mode is only for FastICA and Picard,
+ *                |             | whose iterations are the bulk of the cost;
+ *                |             | JADE and SOBI would have to rebuild all of
+ *                |             | their matrices to finish up, so they treat
+ *                |             | it as ICA_PRECISION_DOUBLE. Ignored by the
+ *                |             | GPU implementations.
+ *  --------------+-------------+-----------------------------------------------
+ *    observer    |        NULL | Optional function called after every
+ *                |             | iteration/sweep of the CPU implementations
+ *                |             | with the convergence metric and the time
+ *                |             | spent in each phase of the run so far, and
+ *                |             | once more at the end of the run (see
+ *                |             | ICAObserver). Timing is skipped entirely if
+ *                |             | there is no observer. It is called on the
+ *                |             | thread running ica() (or ica_batch()'s
+ *                |             | workers). Changing only this value, or
+ *                |             | `observer_data', does not cause the library
+ *                |             | to reinitialize.
+ *  --------------+-------------+-----------------------------------------------
+ *  observer_data |        NULL | Passed to the observer with every report.
+ *  --------------+-------------+-----------------------------------------------
+ *    cancel      |        NULL | Optional flag, polled by the CPU
+ *                |             | implementations between iterations (FastICA,
+ *                |             | Picard) and between Jacobi rotations (JADE,
+ *                |             | SOBI). Once it is nonzero, the run stops
+ *                |             | early, finishing up with its best guess so far
+ *                |             | at the unmixing matrix, and its status is
+ *                |             | ICA_STATUS_CANCELLED (see ica_status()). It
+ *                |             | may be raised from any thread.
+ *  --------------+-------------+-----------------------------------------------
+ *   time_limit   |         0.0 | How many seconds of wall-clock time a run may
+ *                |             | take, after which it stops early just as if
+ *                |             | it had been cancelled (the status is then
+ *                |             | ICA_STATUS_DEADLINE). Zero means no limit.
+ *                |             | Changing only this value, or `cancel', does
+ *                |             | not cause the library to reinitialize. Both
+ *                |             | are ignored by the GPU implementations.
+ *  --------------+-------------+-----------------------------------------------
+ *    decimate    |           1 | Learn the unmixing matrix from a copy of the
+ *                |             | observations that is low-pass filtered and
+ *                |             | decimated by this factor, then apply it to
+ *                |             | all of the observations to find the source
+ *                |             | signals. Filtering doesn't change how the
+ *                |             | sources are mixed, so signals well below the
+ *                |             | new Nyquist frequency (e.g. eyeblinks in EEG
+ *                |             | sampled at 500 Hz) separate almost as well,
+ *                |             | for about 1 / decimate of the cost. Zero or
+ *                |             | one means no decimation. Whitening statistics
+ *                |             | passed to ica_runStats() are ignored, since
+ *                |             | they describe the full-rate observations, and
+ *                |             | so is this value if too few observations
+ *                |             | would be left. Ignored by the GPU
+ *                |             | implementations and by ica_stream().
+ *  --------------+-------------+-----------------------------------------------
+ * jade_eigenmats |           0 | Nonzero makes JADE jointly diagonalize only
+ *                |             | the n eigenmatrices of the cumulant tensor
+ *                |             | with the largest eigenvalues (in magnitude),
+ *                |             | as the original JADE algorithm does, rather
+ *                |             | than all n(n+1)/2 cumulant matrices. Each
+ *                |             | Jacobi rotation then costs O(n^2) rather than
+ *                |             | O(n^3), in return for an eigenvalue
+ *                |             | decomposition of an n(n+1)/2 square matrix,
+ *                |             | and the result is close to, but not the same
+ *                |             | as, full JADE's. The saving outweighs the
+ *                |             | decomposition only for a few dozen variables
+ *                |             | or more. Changing only this value does not
+ *                |             | cause the library to reinitialize. Ignored by
+ *                |             | the GPU implementation.
+ *  --------------+-------------+-----------------------------------------------
  *
  *
  * Parameters:
@@ -153,7 +503,9 @@ int ica_init( ICAParams const *params );
  * Name: ica_shutdown
  *
  * Description:
- * Cleans up and shuts down the ICA library, freeing allocated memory, etc.
+ * Cleans up and shuts down the ICA library's default context, freeing
+ * allocated memory, etc. The thread pool is also shut down, unless a context
+ * made with ica_create() is still alive.
  */
 void ica_shutdown();
 
@@ -195,6 +547,14 @@ void ica_shutdown();
  *             _
  *    X = A * (S + mu_S)
  *
+ * If only k < N components were extracted (see `num_components', `pca_dims',
+ * and `pca_variance' in ica_init()), where N is the number of rows of X, then
+ * this function sets W->rows, S->rows, and A->cols to k. The matrices must
+ * still be allocated with room for all N components (their `ld' and `lag'
+ * values are left unchanged), and the S matrix must still have room for N
+ * rows, since it is used as scratch space. The reconstruction above then only
+ * recovers the part of X explained by the extracted components.
+ *
  * Parameters:
  * @param W           OUTPUT  where the resulting W matrix will be stored
  * @param A           OUTPUT  where the resulting A matrix will be stored
@@ -208,49 +568,719 @@ void ica_shutdown();
 unsigned int ica( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
                   Matrix const *X );
 
+/**
+ * Name: ica_warm
+ *
+ * Description:
+ * Same as ica(), but starts the search for the unmixing matrix from the guess
+ * W_init rather than from scratch. When the observations are similar to ones
+ * for which W_init was found (e.g., overlapping windows of a recording), this
+ * is usually close to the answer, and far fewer iterations/sweeps are needed.
+ *
+ * W_init is an unmixing matrix for the original observations, such as the W
+ * returned by a previous call, so it must have one column per row of X. Its
+ * rows are made orthonormal after whitening the observations, so it does not
+ * need to be exact. W_init may be the same matrix as W.
+ *
+ * The symmetric FastICA update, JADE, Picard, and SOBI need W_init to have a
+ * row for every component; if it doesn't, it is ignored. When extracting k
+ * components with deflation, its first rows are used as the starting guesses
+ * for the first components (taking the place of the `seed' parameter). If
+ * W_init is NULL, or a GPU implementation is used, this is exactly the same as
+ * ica().
+ *
+ * Parameters:
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param S           OUTPUT  where the resulting S matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   the initial guess at the unmixing matrix
+ *
+ * Returns:
+ * @return unsigned int   how many iterations/sweeps the algorithm took
+ */
+unsigned int ica_warm( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
+                       Matrix const *X, Matrix const *W_init );
+
+/**
+ * Name: ica_lastStatus
+ *
+ * Description:
+ * Returns how the last run in the library's default context (see ica() and
+ * ica_warm()) ended. Same as ica_status() for the default context.
+ *
+ * Returns:
+ * @return ICAStatus    how the last run ended
+ */
+ICAStatus ica_lastStatus();
+
+/**
+ * Name: ica_create
+ *
+ * Description:
+ * Creates a new ICA context configured with the given parameters (see
+ * ica_init() for their meaning). A context owns a copy of the parameters and
+ * all of the workspace that the chosen implementation needs, so any number of
+ * contexts may run the ICA computation (see ica_run()) at the same time, each
+ * on its own thread. A single context must only be used by one thread at a
+ * time.
+ *
+ * The library's default context, used by ica_init(), ica(), ica_warm(), and
+ * ica_shutdown(), is just another context.
+ *
+ * Every CPU implementation hands its parallel work to the same thread pool. The
+ * `num_threads' parameter only resizes the pool if no other context is
+ * configured at the time; otherwise the pool is used as it is. The GPU
+ * implementations keep their state on the device, so only one context at a
+ * time may use one of them.
+ *
+ * Parameters:
+ * @param params        configuration parameters for the ICA algorithm
+ *
+ * Returns:
+ * @return ICAContext*  the new context, or NULL if there was a problem
+ */
+ICAContext *ica_create( ICAParams const *params );
+
+/**
+ * Name: ica_configure
+ *
+ * Description:
+ * Changes the configuration parameters of a context. As with ica_init(), the
+ * context's workspace is only set up again if parameters other than
+ * `num_threads', `seed', `observer', `observer_data', `cancel', and
+ * `time_limit' have changed.
+ *
+ * Parameters:
+ * @param ctx           the context to configure
+ * @param params        configuration parameters for the ICA algorithm
+ *
+ * Returns:
+ * @return int          zero if there was a problem, nonzero otherwise
+ */
+int ica_configure( ICAContext *ctx, ICAParams const *params );
+
+/**
+ * Name: ica_run
+ *
+ * Description:
+ * Same as ica_warm(), but runs in the given context rather than the default
+ * one. W_init may be NULL to start from scratch. If the context's workspace
+ * doesn't have room for X (or, for the GPU implementations, if the size of X
+ * doesn't match the parameters the context was configured with), it is
+ * reconfigured for the new size first.
+ *
+ * Parameters:
+ * @param ctx         INPUT   the context to run in
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param S           OUTPUT  where the resulting S matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ *
+ * Returns:
+ * @return unsigned int   how many iterations/sweeps the algorithm took
+ */
+unsigned int ica_run( ICAContext *ctx, Matrix *W, Matrix *A, Matrix *S,
+                      NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init );
+
+/**
+ * Name: ica_runStats
+ *
+ * Description:
+ * Same as ica_run(), but the observation means and covariance matrix used for
+ * whitening are found from the given statistics of X (see ica_addStats())
+ * rather than from X itself, saving one pass over X. This is only done if the
+ * statistics describe as many variables and observations as X has (and the CPU
+ * implementation runs in the native precision); otherwise, or if stats is NULL,
+ * this is exactly the same as ica_run(). The statistics are assumed to be those
+ * of the observations in X.
+ *
+ * Parameters:
+ * @param ctx         INPUT   the context to run in
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param S           OUTPUT  where the resulting S matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param stats       INPUT   the statistics of X, or NULL
+ *
+ * Returns:
+ * @return unsigned int   how many iterations/sweeps the algorithm took
+ */
+unsigned int ica_runStats( ICAContext *ctx, Matrix *W, Matrix *A, Matrix *S,
+                           NUMTYPE *mu_S, Matrix const *X,
+                           Matrix const *W_init, ICAWhitenStats const *stats );
+
+/**
+ * Name: ica_createStats
+ *
+ * Description:
+ * Creates an empty set of whitening statistics for observations of num_var
+ * variables (see ICAWhitenStats).
+ *
+ * Parameters:
+ * @param num_var           how many variables the observations have
+ *
+ * Returns:
+ * @return ICAWhitenStats*  the new statistics, or NULL if there was a problem
+ */
+ICAWhitenStats *ica_createStats( unsigned int num_var );
+
+/**
+ * Name: ica_resetStats
+ *
+ * Description:
+ * Empties a set of whitening statistics, as if it had just been created.
+ *
+ * Parameters:
+ * @param stats       the statistics to empty
+ */
+void ica_resetStats( ICAWhitenStats *stats );
+
+/**
+ * Name: ica_addStats
+ *
+ * Description:
+ * Adds the observations in the columns of X to a set of whitening statistics.
+ * This costs O(N^2 * T) for T observations of N variables (see updateStats()).
+ *
+ * Parameters:
+ * @param stats       the statistics to add to
+ * @param X           the observations to add
+ *
+ * Returns:
+ * @return int        zero if X doesn't have num_var rows, nonzero otherwise
+ */
+int ica_addStats( ICAWhitenStats *stats, Matrix const *X );
+
+/**
+ * Name: ica_removeStats
+ *
+ * Description:
+ * Removes the observations in the columns of X, which must have been added
+ * before, from a set of whitening statistics. For a window sliding over a
+ * recording, the columns that leave the window are removed and the ones that
+ * enter it are added. Each removal rounds a little, so it's best to start the
+ * statistics over (see ica_resetStats()) now and then, e.g. every few hundred
+ * windows.
+ *
+ * Parameters:
+ * @param stats       the statistics to remove from
+ * @param X           the observations to remove
+ *
+ * Returns:
+ * @return int        zero if X doesn't have num_var rows, nonzero otherwise
+ */
+int ica_removeStats( ICAWhitenStats *stats, Matrix const *X );
+
+/**
+ * Name: ica_destroyStats
+ *
+ * Description:
+ * Frees a set of whitening statistics made by ica_createStats().
+ *
+ * Parameters:
+ * @param stats       the statistics to destroy (may be NULL)
+ */
+void ica_destroyStats( ICAWhitenStats *stats );
+
+/**
+ * Name: ica_status
+ *
+ * Description:
+ * Returns how the last run in a context ended: whether it converged, reached
+ * the iteration/sweep limit, or was stopped early by the `cancel' flag or the
+ * `time_limit' (see ica_init()). A run that was stopped early still fills in
+ * all of its outputs, using its best guess so far at the unmixing matrix. If
+ * FastICA was stopped while extracting components one at a time, only those it
+ * had started on are returned (W->rows, S->rows, and A->cols are set to match).
+ *
+ * The GPU implementations can't be stopped early, and always report
+ * ICA_STATUS_CONVERGED.
+ *
+ * Parameters:
+ * @param ctx         the context
+ *
+ * Returns:
+ * @return ICAStatus  how the last run ended (ICA_STATUS_FAILED if it couldn't
+ *                    be started)
+ */
+ICAStatus ica_status( ICAContext const *ctx );
+
+/**
+ * Name: ica_destroy
+ *
+ * Description:
+ * Frees a context made by ica_create() along with all of its workspace. When
+ * the last configured context goes away, the thread pool is shut down too.
+ *
+ * Parameters:
+ * @param ctx         the context to destroy (may be NULL)
+ */
+void ica_destroy( ICAContext *ctx );
+
+/**
+ * One independent ICA problem for ica_batch(). The inputs and outputs are the
+ * same as for ica_run(); `params' may be NULL to use the default parameters.
+ * The sizes given in `params' are ignored, as the size of X is what counts.
+ */
+typedef struct ICABatchItem {
+  Matrix const    *X;
+  ICAParams const *params;
+  Matrix const    *W_init;
+  Matrix          *W;
+  Matrix          *A;
+  Matrix          *S;
+  NUMTYPE         *mu_S;
+  unsigned int     num_iter;  // Set by ica_batch().
+  ICAStatus        status;    // Set by ica_batch() (see ica_status());
+                              // ICA_STATUS_FAILED if the item failed.
+} ICABatchItem;
+
+/**
+ * Name: ica_batch
+ *
+ * Description:
+ * Runs the ICA computation on each of a number of independent problems (e.g.
+ * one per epoch or per subject), spreading them over `num_workers' workers on
+ * the thread pool. Each worker keeps one context, with workspace sized for
+ * the largest item, and takes the next unclaimed item whenever it finishes
+ * one, so items of differing sizes reuse the same workspace rather than
+ * setting it up again each time.
+ *
+ * The first item's `num_threads' sets the size of the thread pool (if no other
+ * context is configured); the others' are ignored. Since the workers already
+ * keep the pool busy, running each item with a single thread is usually
+ * fastest. Only the CPU implementations are used.
+ *
+ * Parameters:
+ * @param items         the problems to solve, and where to store the results
+ * @param num_items     how many items there are
+ * @param num_workers   how many items to work on at once (0 for one per
+ *                      thread in the pool)
+ *
+ * Returns:
+ * @return int          zero if any of the items failed, nonzero otherwise
+ */
+int ica_batch( ICABatchItem *items, unsigned int num_items,
+               unsigned int num_workers );
+
+/**
+ * Name: ica_stream
+ *
+ * Description:
+ * Runs FastICA on observations that are read from a stream a chunk at a time
+ * (see ICAStream) rather than held in memory, so that the size of the data is
+ * limited only by the stream. The means and covariance matrix, every iteration
+ * of the contrast function, and the source signals are each found in one pass
+ * over the stream, and the workspace stays within the stream's memory budget.
+ *
+ * Only the symmetric FastICA update is used, so `implem', `num_components',
+ * `use_gpu', `precision', and `decimate' are ignored, as are `num_var' and
+ * `num_obs' (the stream's are used). The other parameters are the same as for
+ * ica_init(), including the observer, `cancel' flag, and `time_limit', which
+ * are checked between iterations. Each iteration reads the whole stream, so
+ * the stream should be fast to read (e.g. a memory mapped file).
+ *
+ * No context is needed, but the thread pool is shared with them: if no context
+ * is configured, the pool is set up with `num_threads' threads for the run.
+ *
+ * Parameters:
+ * @param params      INPUT   the parameters to use (NULL for the defaults)
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param stream      INPUT   where to read the observations (and write the
+ *                            source signals)
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param status      OUTPUT  how the run ended (see ica_status()), or NULL
+ *
+ * Returns:
+ * @return unsigned int   how many iterations the algorithm took (zero if the
+ *                        run failed)
+ */
+unsigned int ica_stream( ICAParams const *params, Matrix *W, Matrix *A,
+                         NUMTYPE *mu_S, ICAStream const *stream,
+                         Matrix const *W_init, ICAStatus *status );
+
+/**
+ * Name: ica_createOnline
+ *
+ * Description:
+ * Creates a running FastICA estimate (see ICAOnline). Each block of
+ * observations given to ica_updateOnline() is added to exponentially weighted
+ * means and covariance, which are whitened again, and the block's fixed-point
+ * update of the unmixing matrix is added to an exponentially weighted average
+ * of the updates before it, which becomes the new unmixing matrix once its
+ * rows are decorrelated. Each observation's
+ * weight is multiplied by `forget' for every later observation, so the
+ * estimate follows sources that change over about 1 / (1 - forget)
+ * observations. A block of T observations of N variables costs
+ * O(N^2 * T + N^3), so blocks of at least N observations keep up best.
+ *
+ * Only `num_var', `contrast', `pca_dims', and `num_threads' are used from
+ * the parameters. No context is needed, but the thread pool is shared with
+ * them, as for ica_stream(), until the estimate is destroyed.
+ *
+ * Parameters:
+ * @param params      INPUT   the parameters to use
+ * @param forget      INPUT   the weight an observation keeps for each newer
+ *                            one, in (0, 1] (0 for DEF_FORGET)
+ *
+ * Returns:
+ * @return ICAOnline*   the new estimate, or NULL if there was a problem
+ */
+ICAOnline *ica_createOnline( ICAParams const *params, NUMTYPE_NATIVE forget );
+
+/**
+ * Name: ica_updateOnline
+ *
+ * Description:
+ * Updates a running FastICA estimate with a block of new observations, the
+ * columns of X. Nothing is estimated until the blocks add up to more
+ * observations than there are variables.
+ *
+ * Parameters:
+ * @param online      the estimate to update
+ * @param X           the new observations
+ *
+ * Returns:
+ * @return int        zero if X doesn't have num_var rows, nonzero otherwise
+ */
+int ica_updateOnline( ICAOnline *online, Matrix const *X );
+
+/**
+ * Name: ica_onlineUnmixing
+ *
+ * Description:
+ * Returns the current unmixing matrix of a running FastICA estimate, along
+ * with its mixing matrix and the means of the source signals, as ica() would
+ * (W is k x num_var and A is num_var x k, where k is the number of principal
+ * components kept). Any of the outputs may be NULL. Calls on the same
+ * estimate must not overlap, so a monitor reading the estimate while another
+ * thread updates it must lock around both.
+ *
+ * Parameters:
+ * @param online      INPUT   the estimate
+ * @param W           OUTPUT  where the W matrix will be stored
+ * @param A           OUTPUT  where the A matrix will be stored
+ * @param mu_S        OUTPUT  where the mu_S vector will be stored
+ *
+ * Returns:
+ * @return unsigned int   how many sources there are, k, or zero if there
+ *                        have been too few observations to estimate them
+ */
+unsigned int ica_onlineUnmixing( ICAOnline const *online, Matrix *W,
+                                 Matrix *A, NUMTYPE *mu_S );
+
+/**
+ * Name: ica_resetOnline
+ *
+ * Description:
+ * Forgets every observation given to a running FastICA estimate, as if it had
+ * just been created (e.g. when the electrodes have been moved).
+ *
+ * Parameters:
+ * @param online      the estimate to reset
+ */
+void ica_resetOnline( ICAOnline *online );
+
+/**
+ * Name: ica_destroyOnline
+ *
+ * Description:
+ * Frees a running FastICA estimate made by ica_createOnline().
+ *
+ * Parameters:
+ * @param online      the estimate to destroy (may be NULL)
+ */
+void ica_destroyOnline( ICAOnline *online );
+
+/**
+ * Name: ica_calibrate
+ *
+ * Description:
+ * Times each implementation and contrast on this host, for use by ICA_AUTO.
+ * The columns of the table are, in order, CPU FastICA with the tanh, cube, and
+ * gauss contrasts, CPU JADE, and then the same four on the GPU. Observations
+ * of 2, 4, 8, ... variables up to `max_var' (and of `max_var' itself) are
+ * mixed from equal numbers of super- and sub-Gaussian sources, with 500
+ * observations per variable, and each choice is timed separating them
+ * `samples' times (once, if that takes over a second), keeping the fastest.
+ * A choice that fails or doesn't converge for a size is left out at that
+ * size.
+ *
+ * The `epsilon', `max_iter', `num_threads', `decorr', `precision', and
+ * `gpu_device' parameters are used for every run, so that the timings match
+ * the runs they predict. The GPU is only timed if `use_gpu' is set (and the
+ * library was built with ENABLE_GPU). The rest of the parameters are ignored.
+ * This takes about as long as separating each size a few times with every
+ * implementation, so it is best done once and saved (see
+ * ica_saveCalibration()).
+ *
+ * Parameters:
+ * @param params      INPUT   the parameters to time the runs with
+ * @param max_var     INPUT   the most variables to time (0 for
+ *                            DEF_CAL_MAX_VAR)
+ * @param samples     INPUT   how many times to time each run (0 for
+ *                            DEF_CAL_SAMPLES)
+ *
+ * Returns:
+ * @return ICACalibration*  the table, or NULL if there was a problem
+ */
+ICACalibration *ica_calibrate( ICAParams const *params, unsigned int max_var,
+                               unsigned int samples );
+
+/**
+ * Name: ica_saveCalibration
+ *
+ * Description:
+ * Writes a calibration table to a text file, along with the name of the host
+ * it was measured on.
+ *
+ * Parameters:
+ * @param cal         INPUT   the table to save
+ * @param file_name   INPUT   the file to write it to
+ *
+ * Returns:
+ * @return int        zero if there was a problem, nonzero otherwise
+ */
+int ica_saveCalibration( ICACalibration const *cal, char const *file_name );
+
+/**
+ * Name: ica_loadCalibration
+ *
+ * Description:
+ * Reads a calibration table saved by ica_saveCalibration(). Tables measured on
+ * another host are refused, since they would only mislead ICA_AUTO.
+ *
+ * Parameters:
+ * @param file_name   INPUT   the file to read the table from
+ *
+ * Returns:
+ * @return ICACalibration*  the table, or NULL if the file couldn't be read or
+ *                          was saved on another host
+ */
+ICACalibration *ica_loadCalibration( char const *file_name );
+
+/**
+ * Name: ica_setCalibration
+ *
+ * Description:
+ * Sets the calibration table ICA_AUTO chooses from, for every context. The
+ * table isn't copied, so it must not be destroyed until another one (or NULL)
+ * has been set. Contexts already configured keep their choice until they are
+ * next configured or given observations of another size.
+ *
+ * Parameters:
+ * @param cal         INPUT   the table to use, or NULL to stop using one
+ */
+void ica_setCalibration( ICACalibration const *cal );
+
+/**
+ * Name: ica_choose
+ *
+ * Description:
+ * Picks the implementation and contrast that ICA_AUTO would for `num_var' x
+ * `num_obs' observations. The time each choice takes is predicted from the
+ * table, interpolating log time per observation linearly in log `num_var'
+ * between the sizes measured (and extrapolating beyond them), and scaling by
+ * `num_obs'. If `time_limit' is zero, the fastest choice is made. Otherwise it
+ * is taken as the latency budget, and the most robust choice predicted to
+ * finish within it is made, in the order JADE, then FastICA with the tanh,
+ * gauss, and cube contrasts (the fastest if none will). GPU choices are only
+ * considered if `use_gpu' is set.
+ *
+ * Sets `implem', `contrast', and `use_gpu', leaving the rest of the
+ * parameters alone.
+ *
+ * Parameters:
+ * @param cal         INPUT   the table to choose from
+ * @param params      IN/OUT  the parameters to choose for
+ * @param seconds     OUTPUT  the predicted time of the choice (may be NULL)
+ *
+ * Returns:
+ * @return int        zero if the table predicts nothing for this size
+ *                    (`params' is then unchanged), nonzero otherwise
+ */
+int ica_choose( ICACalibration const *cal, ICAParams *params,
+                double *seconds );
+
+/**
+ * Name: ica_destroyCalibration
+ *
+ * Description:
+ * Frees a calibration table made by ica_calibrate() or ica_loadCalibration().
+ *
+ * Parameters:
+ * @param cal         the table to destroy (may be NULL)
+ */
+void ica_destroyCalibration( ICACalibration *cal );
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * The workspace of each CPU implementation, set up by its initialization
+ * function (see ica/setup.h) and owned by an ICA context.
+ */
+typedef struct FastICAState FastICAState;
+typedef struct JadeState    JadeState;
+typedef struct PicardState  PicardState;
+typedef struct SobiState    SobiState;
+
 /**
  * Name: fastica
  *
  * Description:
  * FastICA implementation of Independent Component Analysis. See description
- * for ica() for parameter and return value details.
+ * for ica_warm() for parameter and return value details.
  *
  * Parameters:
+ * @param st          INPUT   the workspace set up by fastica_init()
  * @param W           OUTPUT  where the resulting W matrix will be stored
  * @param A           OUTPUT  where the resulting A matrix will be stored
  * @param S           OUTPUT  where the resulting S matrix will be stored
  * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
  * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param stats       INPUT   the statistics of X, or NULL (see ica_runStats())
  *
  * Returns:
  * @return unsigned int   how many iterations the algorithm took
  */
-unsigned int fastica( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
-                      Matrix const *X );
+unsigned int fastica( FastICAState *st, Matrix *W, Matrix *A, Matrix *S,
+                      NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                      ICAWhitenStats const *stats );
 
 /**
  * Name: jade 
  *
  * Description:
  * JADE implementation of Independent Component Analysis. See description
- * for ica() for parameter and return value details.
+ * for ica_warm() for parameter and return value details.
  *
  * Parameters:
+ * @param st          INPUT   the workspace set up by jade_init()
  * @param W           OUTPUT  where the resulting W matrix will be stored
  * @param A           OUTPUT  where the resulting A matrix will be stored
  * @param S           OUTPUT  where the resulting S matrix will be stored
  * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
  * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param stats       INPUT   the statistics of X, or NULL (see ica_runStats())
  *
  * Returns:
  * @return unsigned int   how many Jacobi sweeps the algorithm took
  */
-unsigned int jade( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
-                   Matrix const *X );
+unsigned int jade( JadeState *st, Matrix *W, Matrix *A, Matrix *S,
+                   NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                   ICAWhitenStats const *stats );
+
+/**
+ * Name: picard
+ *
+ * Description:
+ * Picard-O implementation of Independent Component Analysis: maximum likelihood
+ * ICA over orthogonal unmixing matrices of the whitened observations, solved
+ * with the L-BFGS method, using a cheap approximation of the Hessian as its
+ * preconditioner. Like FastICA with g(y) = tanh(y), each component may be
+ * sub- or super-Gaussian. See description for ica_warm() for parameter and
+ * return value details.
+ *
+ * Each iteration needs one pass over the observations (more only when the line
+ * search has to shorten a step), so this function returns the number of passes
+ * made, which is directly comparable to the number of FastICA iterations.
+ *
+ * Parameters:
+ * @param st          INPUT   the workspace set up by picard_init()
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param S           OUTPUT  where the resulting S matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param stats       INPUT   the statistics of X, or NULL (see ica_runStats())
+ *
+ * Returns:
+ * @return unsigned int   how many passes over the observations were made
+ */
+unsigned int picard( PicardState *st, Matrix *W, Matrix *A, Matrix *S,
+                     NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                     ICAWhitenStats const *stats );
+
+/**
+ * Name: sobi
+ *
+ * Description:
+ * SOBI (second-order blind identification) implementation of Independent
+ * Component Analysis. The whitened observations' covariance matrices at
+ * several time lags are jointly diagonalized with the same Jacobi sweeps that
+ * JADE uses on its cumulant matrices. Only `num_lags' n x n matrices are
+ * needed, where JADE needs n(n+1)/2 of them, so this is much cheaper than JADE
+ * when there are many variables. See description for ica_warm() for parameter
+ * and return value details.
+ *
+ * Parameters:
+ * @param st          INPUT   the workspace set up by sobi_init()
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param S           OUTPUT  where the resulting S matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param X           INPUT   the observation matrix
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param stats       INPUT   the statistics of X, or NULL (see ica_runStats())
+ *
+ * Returns:
+ * @return unsigned int   how many Jacobi sweeps the algorithm took
+ */
+unsigned int sobi( SobiState *st, Matrix *W, Matrix *A, Matrix *S,
+                   NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                   ICAWhitenStats const *stats );
+
+/**
+ * Name: fastica_stream
+ *
+ * Description:
+ * The FastICA implementation behind ica_stream(), which it should only be
+ * called by. Unlike the other implementations, it allocates its workspace for
+ * each run, since the size of the workspace is set by the stream's budget. See
+ * ica_stream() for parameter and return value details.
+ *
+ * Parameters:
+ * @param params      INPUT   the parameters to use
+ * @param W           OUTPUT  where the resulting W matrix will be stored
+ * @param A           OUTPUT  where the resulting A matrix will be stored
+ * @param mu_S        OUTPUT  where the resulting mu_S vector will be stored
+ * @param stream      INPUT   where to read the observations
+ * @param W_init      INPUT   initial guess at W, or NULL to start from scratch
+ * @param status      OUTPUT  how the run ended
+ *
+ * Returns:
+ * @return unsigned int   how many iterations the algorithm took
+ */
+unsigned int fastica_stream( ICAParams const *params, Matrix *W, Matrix *A,
+                             NUMTYPE *mu_S, ICAStream const *stream,
+                             Matrix const *W_init, ICAStatus *status );
+
+/**
+ * The FastICA implementation behind ica_createOnline(), ica_updateOnline(),
+ * ica_onlineUnmixing(), ica_resetOnline(), and ica_destroyOnline(), which
+ * these should only be called by. See those functions for parameter and
+ * return value details.
+ */
+ICAOnline *fastica_createOnline( ICAParams const *params,
+                                 NUMTYPE_NATIVE forget );
+int fastica_updateOnline( ICAOnline *online, Matrix const *X );
+unsigned int fastica_onlineUnmixing( ICAOnline const *online, Matrix *W,
+                                     Matrix *A, NUMTYPE *mu_S );
+void fastica_resetOnline( ICAOnline *online );
+void fastica_destroyOnline( ICAOnline *online );
 
 #ifdef __cplusplus
 }
@@ -12,51 +12,190 @@ extern "C" {
  * Name: fastica_init
  *
  * Description:
- * Initializes the CPU implementation of fastica. This function should only be
- * called by the ica_init() function.
+ * Initializes the CPU implementation of fastica, allocating a new workspace
+ * for it. This function should only be called by the ica_init() function (or
+ * one of the other functions that configure an ICA context).
+ *
+ * The `params' struct must remain valid until fastica_shutdown() is called,
+ * since its `seed' and `observer' fields are read on every run (they may change
+ * without the library being reinitialized).
  *
  * Parameters:
+ * @param state         where to store the new workspace (NULL on failure)
  * @param params        configuration parameters for the ICA algorithm
  *
  * Returns:
  * @return int          zero if a problem occurs, nonzero otherwise
  */
-int fastica_init( ICAParams *params );
+int fastica_init( FastICAState **state, ICAParams *params );
 
 /**
  * Name: jade_init
  *
  * Description:
- * Initializes the CPU implementation of JADE. This function should only be
- * called by the ica_init() function.
+ * Initializes the CPU implementation of JADE, allocating a new workspace for
+ * it. This function should only be called by the ica_init() function (or one
+ * of the other functions that configure an ICA context).
+ *
+ * The `params' struct must remain valid until jade_shutdown() is called,
+ * since its `observer' field is read on every run.
+ *
+ * Parameters:
+ * @param state         where to store the new workspace (NULL on failure)
+ * @param params        configuration parameters for the ICA algorithm
+ *
+ * Returns:
+ * @return int          zero if a problem occurs, nonzero otherwise
+ */
+int jade_init( JadeState **state, ICAParams *params );
+
+/**
+ * Name: picard_init
+ *
+ * Description:
+ * Initializes the CPU implementation of Picard, allocating a new workspace for
+ * it. This function should only be called by the ica_init() function (or one
+ * of the other functions that configure an ICA context).
+ *
+ * The `params' struct must remain valid until picard_shutdown() is called,
+ * since its `observer' field is read on every run.
  *
  * Parameters:
+ * @param state         where to store the new workspace (NULL on failure)
  * @param params        configuration parameters for the ICA algorithm
  *
  * Returns:
  * @return int          zero if a problem occurs, nonzero otherwise
  */
-int jade_init( ICAParams *params );
+int picard_init( PicardState **state, ICAParams *params );
+
+/**
+ * Name: sobi_init
+ *
+ * Description:
+ * Initializes the CPU implementation of SOBI, allocating a new workspace for
+ * it. This function should only be called by the ica_init() function (or one
+ * of the other functions that configure an ICA context).
+ *
+ * The `params' struct must remain valid until sobi_shutdown() is called,
+ * since its `observer' field is read on every run.
+ *
+ * Parameters:
+ * @param state         where to store the new workspace (NULL on failure)
+ * @param params        configuration parameters for the ICA algorithm
+ *
+ * Returns:
+ * @return int          zero if a problem occurs, nonzero otherwise
+ */
+int sobi_init( SobiState **state, ICAParams *params );
 
 /**
  * Name: fastica_shutdown
  *
  * Description:
- * Cleans up and shuts down the CPU implementation of the fastica library,
- * freeing allocated memory, etc. This function should only be called by the
- * ica_shutdown() function.
+ * Frees a workspace set up by fastica_init(). This function should only be
+ * called by the ica_shutdown() function (or ica_destroy()).
+ *
+ * Parameters:
+ * @param st            the workspace to free (may be NULL)
  */
-void fastica_shutdown();
+void fastica_shutdown( FastICAState *st );
 
 /**
  * Name: jade_shutdown
  *
  * Description:
- * Cleans up and shuts down the CPU implementation of the fastica library,
- * freeing allocated memory, etc. This function should only be called by the
- * ica_shutdown() function.
+ * Frees a workspace set up by jade_init(). This function should only be called
+ * by the ica_shutdown() function (or ica_destroy()).
+ *
+ * Parameters:
+ * @param st            the workspace to free (may be NULL)
+ */
+void jade_shutdown( JadeState *st );
+
+/**
+ * Name: picard_shutdown
+ *
+ * Description:
+ * Frees a workspace set up by picard_init(). This function should only be
+ * called by the ica_shutdown() function (or ica_destroy()).
+ *
+ * Parameters:
+ * @param st            the workspace to free (may be NULL)
+ */
+void picard_shutdown( PicardState *st );
+
+/**
+ * Name: sobi_shutdown
+ *
+ * Description:
+ * Frees a workspace set up by sobi_init(). This function should only be called
+ * by the ica_shutdown() function (or ica_destroy()).
+ *
+ * Parameters:
+ * @param st            the workspace to free (may be NULL)
+ */
+void sobi_shutdown( SobiState *st );
+
+/**
+ * Name: fastica_status
+ *
+ * Description:
+ * Returns how the last run of fastica() with the given workspace ended (see
+ * ica_status()). This function should only be called by the ica_run() function.
+ *
+ * Parameters:
+ * @param st            the workspace
+ *
+ * Returns:
+ * @return ICAStatus    how the last run ended
+ */
+ICAStatus fastica_status( FastICAState const *st );
+
+/**
+ * Name: jade_status
+ *
+ * Description:
+ * Returns how the last run of jade() with the given workspace ended (see
+ * ica_status()). This function should only be called by the ica_run() function.
+ *
+ * Parameters:
+ * @param st            the workspace
+ *
+ * Returns:
+ * @return ICAStatus    how the last run ended
+ */
+ICAStatus jade_status( JadeState const *st );
+
+/**
+ * Name: picard_status
+ *
+ * Description:
+ * Returns how the last run of picard() with the given workspace ended (see
+ * ica_status()). This function should only be called by the ica_run() function.
+ *
+ * Parameters:
+ * @param st            the workspace
+ *
+ * Returns:
+ * @return ICAStatus    how the last run ended
+ */
+ICAStatus picard_status( PicardState const *st );
+
+/**
+ * Name: sobi_status
+ *
+ * Description:
+ * Returns how the last run of sobi() with the given workspace ended (see
+ * ica_status()). This function should only be called by the ica_run() function.
+ *
+ * Parameters:
+ * @param st            the workspace
+ *
+ * Returns:
+ * @return ICAStatus    how the last run ended
  */
-void jade_shutdown();
+ICAStatus sobi_status( SobiState const *st );
 
 #ifdef __cplusplus
 }
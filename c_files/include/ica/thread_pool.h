@@ -0,0 +1,102 @@
+#ifndef ICA_THREAD_POOL_H
+#define ICA_THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This file declares a small, persistent pool of worker threads that is shared
+ * by the whole library. Rather than creating and joining threads every time a
+ * parallel computation is performed (which, for FastICA, would be several times
+ * per iteration), work is handed to threads that are started once and then
+ * sleep until there is something for them to do.
+ *
+ * Work is submitted as a number of independent tasks. Each task is a call to a
+ * PoolTask function, given the same data pointer and a different task index.
+ * The thread that submits the work also executes tasks, so a pool of N threads
+ * only starts N - 1 worker threads.
+ */
+
+// The general form of a task run by the thread pool. The first parameter is the
+// data pointer given to tpool_run(), the second is the index of this task (in
+// the range [0, num_tasks)), and the third is the total number of tasks.
+typedef void (*PoolTask)( void*, unsigned int, unsigned int );
+
+/**
+ * Name: tpool_init
+ *
+ * Description:
+ * Starts up the thread pool so that it uses the given number of threads
+ * (including the thread that submits work). If `num_threads' is zero, one
+ * thread is used for every online processor.
+ *
+ * If the pool is already running with the requested number of threads, this
+ * function does nothing. Otherwise, the pool is restarted with the new number
+ * of threads. This function must not be called while work is being run on the
+ * pool.
+ *
+ * Parameters:
+ * @param num_threads   how many threads to use (0 for one per processor)
+ *
+ * Returns:
+ * @return int          zero if a problem occurs, nonzero otherwise
+ */
+int tpool_init( unsigned int num_threads );
+
+/**
+ * Name: tpool_shutdown
+ *
+ * Description:
+ * Stops and joins all worker threads in the pool. After this is called, work
+ * submitted to the pool is run serially by the submitting thread until the
+ * pool is initialized again.
+ */
+void tpool_shutdown();
+
+/**
+ * Name: tpool_numThreads
+ *
+ * Description:
+ * Returns the number of threads that will run work submitted to the pool,
+ * including the thread submitting the work. This is always at least one.
+ *
+ * Returns:
+ * @return unsigned int   the number of threads in the pool
+ */
+unsigned int tpool_numThreads();
+
+/**
+ * Name: tpool_numProcessors
+ *
+ * Description:
+ * Returns the number of online processors on this machine (at least one).
+ *
+ * Returns:
+ * @return unsigned int   the number of online processors
+ */
+unsigned int tpool_numProcessors();
+
+/**
+ * Name: tpool_run
+ *
+ * Description:
+ * Runs `num_tasks' tasks on the thread pool, calling task( data, i, num_tasks )
+ * once for each i in [0, num_tasks), and returns once every task has finished.
+ * If `num_tasks' is zero, one task is run for every thread in the pool.
+ *
+ * Tasks may be run in any order and on any thread, including the calling
+ * thread, so each task must only touch data that no other task modifies.
+ *
+ * Parameters:
+ * @param task        the function to run for each task
+ * @param data        data passed to every task
+ * @param num_tasks   how many tasks to run (0 for one per pool thread)
+ */
+void tpool_run( PoolTask task, void *data, unsigned int num_tasks );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
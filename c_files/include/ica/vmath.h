@@ -0,0 +1,169 @@
+#ifndef ICA_VMATH_H
+#define ICA_VMATH_H
+
+#include "numtype.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This file declares vectorized versions of the element-wise math functions
+ * used by the FastICA contrast functions. Each function operates on an array
+ * of values, and the implementation used is picked at runtime based on what
+ * the processor supports:
+ *
+ *   VMATH_AVX512  - 16 floats at a time, using AVX-512F instructions.
+ *   VMATH_AVX2    - 8 floats at a time, using AVX2 and FMA instructions.
+ *   VMATH_SCALAR  - one value at a time, using the C library's tanh()/exp().
+ *
+ * The vector implementations use the Cephes single precision polynomials and
+ * are only available when NUMTYPE is float (USE_SINGLE is defined) on x86
+ * processors. Otherwise, the scalar implementation is always used.
+ *
+ * The maximum error of the vector implementations, relative to the C library
+ * evaluated in double precision, is:
+ *
+ *   vmath_tanh:   2.0e-7 relative (for all inputs)
+ *   vmath_exp:    2.0e-7 relative (for inputs in [VMATH_EXP_MIN, 88])
+ *
+ * which is within two units in the last place of a float. For comparison, the
+ * scalar implementation (rounding a double precision result) is within 6e-8.
+ *
+ * Inputs to vmath_exp() below VMATH_EXP_MIN produce zero rather than a
+ * denormal number. See vmath_verify() to check these bounds on a machine.
+ */
+
+// Inputs to vmath_exp() below this value produce zero.
+#define VMATH_EXP_MIN   -87.33
+
+// The implementations that may be selected.
+typedef enum VMathISA {
+  VMATH_AUTO = 0,   // Pick the best implementation the processor supports.
+  VMATH_SCALAR,
+  VMATH_AVX2,
+  VMATH_AVX512
+} VMathISA;
+
+/**
+ * Name: vmath_init
+ *
+ * Description:
+ * Selects which implementation the vmath_* functions use. If `isa' is
+ * VMATH_AUTO, the fastest implementation supported by the processor is used.
+ * If the requested implementation is not supported, the scalar implementation
+ * is used instead.
+ *
+ * Until this function is called, the scalar implementation is used and
+ * vmath_isa() returns VMATH_AUTO.
+ *
+ * Parameters:
+ * @param isa       which implementation to use
+ *
+ * Returns:
+ * @return VMathISA   the implementation that was selected
+ */
+VMathISA vmath_init( VMathISA isa );
+
+/**
+ * Name: vmath_isa
+ *
+ * Description:
+ * Returns the implementation selected by the last call to vmath_init(), or
+ * VMATH_AUTO if vmath_init() has never been called.
+ *
+ * Returns:
+ * @return VMathISA   the selected implementation
+ */
+VMathISA vmath_isa();
+
+/**
+ * Name: vmath_supported
+ *
+ * Description:
+ * Returns whether or not the given implementation can be used on this machine
+ * with this build of the library.
+ *
+ * Parameters:
+ * @param isa     the implementation to check
+ *
+ * Returns:
+ * @return int    nonzero if the implementation is usable, zero otherwise
+ */
+int vmath_supported( VMathISA isa );
+
+/**
+ * Name: vmath_isaName
+ *
+ * Description:
+ * Returns a printable name for an implementation (e.g. "avx2").
+ *
+ * Parameters:
+ * @param isa             the implementation
+ *
+ * Returns:
+ * @return char const*    the implementation's name
+ */
+char const *vmath_isaName( VMathISA isa );
+
+/**
+ * Name: vmath_tanh
+ *
+ * Description:
+ * Computes y[i] = tanh( x[i] ) for i in [0, n). The `y' and `x' arrays may be
+ * the same array.
+ *
+ * Parameters:
+ * @param y     where to store the results
+ * @param x     the inputs
+ * @param n     the number of elements
+ */
+void vmath_tanh( NUMTYPE *y, NUMTYPE const *x, int n );
+
+/**
+ * Name: vmath_exp
+ *
+ * Description:
+ * Computes y[i] = exp( x[i] ) for i in [0, n). The `y' and `x' arrays may be
+ * the same array.
+ *
+ * Parameters:
+ * @param y     where to store the results
+ * @param x     the inputs
+ * @param n     the number of elements
+ */
+void vmath_exp( NUMTYPE *y, NUMTYPE const *x, int n );
+
+/**
+ * Name: vmath_verify
+ *
+ * Description:
+ * Compares an implementation against the C library (evaluated in double
+ * precision) over the ranges of values the FastICA contrast functions see for
+ * projections of whitened data no larger than `max_abs' in magnitude:
+ *
+ *   tanh( y )         for y in [-max_abs, max_abs]
+ *   exp( -y^2 / 2 )   for y in [-max_abs, max_abs]
+ *
+ * and returns the maximum relative error seen for each function. Exponent
+ * arguments below VMATH_EXP_MIN are skipped.
+ *
+ * The currently selected implementation is left unchanged.
+ *
+ * Parameters:
+ * @param isa         the implementation to check
+ * @param max_abs     the largest magnitude of projection to check
+ * @param tanh_err    where to store the max relative error of vmath_tanh()
+ * @param exp_err     where to store the max relative error of vmath_exp()
+ *
+ * Returns:
+ * @return int        zero if the implementation isn't supported, else nonzero
+ */
+int vmath_verify( VMathISA isa, double max_abs, double *tanh_err,
+                  double *exp_err );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
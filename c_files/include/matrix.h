@@ -99,6 +99,25 @@ typedef enum MajorFormat {
 #define CUBLAS_GEMM_NT( C, A, B )           /* defined later in the file */
 #define GEMM_NT( C, A, B )                  /* defined later in the file */
 
+/**
+ * Name: GEMM_NT_ADD
+ *
+ * Same as GEMM_NT, but adds the product to the existing contents of C:
+ *    C = C + A * B';
+ *
+ * PRE:
+ * It is assumed that A, B, and C are all of the correct dimensions and that
+ * they have been fully initialized (including the elements of C).
+ *
+ * The C parameter must not be equal to either A or B.
+ *
+ * Parameters:
+ * @param C   where to add the product
+ * @param A   the left matrix in the product
+ * @param B   the right matrix in the product
+ */
+#define GEMM_NT_ADD( C, A, B )              /* defined later in the file */
+
 /**
  * Name: CUBLAS_GEMM_TN
  * Name: GEMM_TN
@@ -141,6 +160,65 @@ typedef enum MajorFormat {
  */
 #define GEMV( y, A, x )                     /* defined later in the file */
 
+/**
+ * Name: SYRK
+ * Name: SYRK_T
+ *
+ * Description:
+ * Multiplies a matrix by its own transpose, computing:
+ *    C = A * A';     (SYRK)
+ *    C = A' * A;     (SYRK_T)
+ * Since the product is symmetric, only its upper triangle is computed (the
+ * elements below the diagonal of C are left alone), for half of the flops of
+ * the matching GEMM_NT/GEMM_TN. The upper triangle is what SYEV and SYMM read.
+ *
+ * The parameters of this macro should be of type struct Matrix.
+ *
+ * PRE:
+ * It is assumed that A and C are of the correct dimensions and that they have
+ * been fully initialized.
+ *
+ * The C parameter must not be equal to A.
+ *
+ * Parameters:
+ * @param C   where to store the upper triangle of the product
+ * @param A   the matrix to multiply by its transpose
+ */
+#define SYRK( C, A )                        /* defined later in the file */
+#define SYRK_T( C, A )                      /* defined later in the file */
+
+/**
+ * Name: SYRK_ADD
+ *
+ * Same as SYRK, but adds the product to the existing upper triangle of C:
+ *    C = C + A * A';
+ *
+ * Parameters:
+ * @param C   where to add the upper triangle of the product
+ * @param A   the matrix to multiply by its transpose
+ */
+#define SYRK_ADD( C, A )                    /* defined later in the file */
+
+/**
+ * Name: SYMM
+ *
+ * Same as GEMM, but A is symmetric and only its upper triangle is read (e.g.
+ * the result of SYRK):
+ *    C = A * B;
+ *
+ * PRE:
+ * It is assumed that A, B, and C are all of the correct dimensions and that
+ * the upper triangle of A, and all of B, have been initialized.
+ *
+ * The C parameter must not be equal to either A or B.
+ *
+ * Parameters:
+ * @param C   where to store the final product
+ * @param A   the symmetric left matrix in the product
+ * @param B   the right matrix in the product
+ */
+#define SYMM( C, A, B )                     /* defined later in the file */
+
 /**
  * Name: CUBLAS_COVARIANCE
  * Name: COVARIANCE
@@ -148,7 +226,8 @@ typedef enum MajorFormat {
  * Description:
  * Calculate the covariance matrix for a zero-mean observation matrix, where
  * each row of the observation matrix is a variable and each column is an
- * observation of that variable.
+ * observation of that variable. COVARIANCE only computes the upper triangle
+ * (see SYRK), which is all SYEV needs.
  *
  * The parameters of this macro should be of type struct Matrix.
  *
@@ -193,14 +272,15 @@ typedef enum MajorFormat {
  *
  * Description:
  * Finds the eigenvalue decomposition of the symmetric matrix E, storing the
- * resulting eigenvalues in d and the orthonormal eigenvectors in E.
+ * resulting eigenvalues in d (in ascending order) and the orthonormal
+ * eigenvectors in E. Only the upper triangle of E is read. See mat_eigSym().
  *
  * The E parameter should be of type struct Matrix (N.B. not a pointer to a
  * Matrix) and the d parameter should be of type NUMTYPE*.
  *
  * PRE:
  * Assumptions:
- *   + E is square and symmetric.
+ *   + E is square, and its upper triangle holds a symmetric matrix.
  *   + d is already allocated and has at least as many slots as E has rows.
  *
  * POST:
@@ -290,6 +370,30 @@ int mat_similar( Matrix const *mat1, Matrix const *mat2, NUMTYPE epsilon );
 int mat_printToFile( char const *filename, Matrix const *matrix,
                      MajorFormat major );
 
+/**
+ * Name: mat_eigSym
+ *
+ * Description:
+ * Does the work of SYEV, with the LAPACK driver chosen at compile time: the
+ * divide-and-conquer xSYEVD by default, xSYEVR (relatively robust
+ * representations) if USE_SYEVR is defined, or the QR iteration of xSYEV if
+ * USE_SYEV is defined.
+ *
+ * Each thread keeps the workspace of the largest matrix it has decomposed, so
+ * LAPACK is only asked how much workspace it needs the first time a thread sees
+ * a larger matrix, rather than on every call. The workspace is freed when the
+ * thread exits.
+ *
+ * Parameters:
+ * @param E       the matrix to decompose, and where to store the eigenvectors
+ * @param d       where to store the eigenvalues
+ *
+ * Returns:
+ * @return int    0 if the workspace couldn't be allocated or LAPACK failed,
+ *                nonzero otherwise
+ */
+int mat_eigSym( Matrix *E, NUMTYPE *d );
+
 /*******************************************************************************
  * Implementation details for using the BLAS and LAPACK routines. The BLAS
  * routines take lots of parameters that result in a lot of boiler plate code.
@@ -319,8 +423,13 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
 
 #undef GEMM
 #undef GEMM_NT
+#undef GEMM_NT_ADD
 #undef GEMM_TN
 #undef GEMV
+#undef SYRK
+#undef SYRK_T
+#undef SYRK_ADD
+#undef SYMM
 
 #undef COVARIANCE
 #undef COVARIANCE_T
@@ -331,13 +440,21 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
 #ifdef USE_SINGLE
   #define xGEMM sgemm_
   #define xGEMV sgemv_
-  #define xSYEV ssyev_
+  #define xSYRK ssyrk_
+  #define xSYMM ssymm_
+  #define xSYEV  ssyev_
+  #define xSYEVD ssyevd_
+  #define xSYEVR ssyevr_
   #define cublasXgemm   cublasSgemm
   #define cublasXgemv   cublasSgemv
 #else
   #define xGEMM dgemm_
   #define xGEMV dgemv_
-  #define xSYEV dsyev_
+  #define xSYRK dsyrk_
+  #define xSYMM dsymm_
+  #define xSYEV  dsyev_
+  #define xSYEVD dsyevd_
+  #define xSYEVR dsyevr_
   #define cublasXgemm   cublasDgemm
   #define cublasXgemv   cublasDgemv
 #endif
@@ -412,6 +529,16 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                                   &_beta,\
                                   (C).elem, &((C).ld) )
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define GEMM_NT_ADD( C, A, B ) xGEMM( &_not_transpose, &_transpose,\
+                                      &((A).rows), &((B).rows), &((A).cols),\
+                                      &_alpha,\
+                                      (A).elem, &((A).ld),\
+                                      (B).elem, &((B).ld),\
+                                      &_beta_add,\
+                                      (C).elem, &((C).ld) )
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 #define GEMM_TN( C, A, B ) xGEMM( &_transpose, &_not_transpose,\
@@ -431,47 +558,58 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                                x, &_one,\
                                &_beta, y, &_one )
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define SYRK( C, A ) xSYRK( &_uplo, &_not_transpose,\
+                            &((A).rows), &((A).cols),\
+                            &_alpha,\
+                            (A).elem, &((A).ld),\
+                            &_beta,\
+                            (C).elem, &((C).ld) )
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define SYRK_T( C, A ) xSYRK( &_uplo, &_transpose,\
+                              &((A).cols), &((A).rows),\
+                              &_alpha,\
+                              (A).elem, &((A).ld),\
+                              &_beta,\
+                              (C).elem, &((C).ld) )
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define SYRK_ADD( C, A ) xSYRK( &_uplo, &_not_transpose,\
+                                &((A).rows), &((A).cols),\
+                                &_alpha,\
+                                (A).elem, &((A).ld),\
+                                &_beta_add,\
+                                (C).elem, &((C).ld) )
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define SYMM( C, A, B ) xSYMM( &_left, &_uplo,\
+                               &((B).rows), &((B).cols),\
+                               &_alpha,\
+                               (A).elem, &((A).ld),\
+                               (B).elem, &((B).ld),\
+                               &_beta,\
+                               (C).elem, &((C).ld) )
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 #define COVARIANCE( C, Z ) _alpha = 1.0 / (NUMTYPE) ((Z).cols - 1);\
-                           xGEMM( &_not_transpose, &_transpose,\
-                                  &((Z).rows), &((Z).rows), &((Z).cols),\
-                                  &_alpha,\
-                                  (Z).elem, &((Z).ld),\
-                                  (Z).elem, &((Z).ld),\
-                                  &_beta,\
-                                  (C).elem, &((C).ld) );\
+                           SYRK( C, Z );\
                            _alpha = 1.0;
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 #define COVARIANCE_T( C, Z ) _alpha = 1.0 / (NUMTYPE) ((Z).rows - 1);\
-                             xGEMM( &_transpose, &_not_transpose,\
-                                    &((Z).cols), &((Z).cols), &((Z).rows),\
-                                    &_alpha,\
-                                    (Z).elem, &((Z).ld),\
-                                    (Z).elem, &((Z).ld),\
-                                    &_beta,\
-                                    (C).elem, &((C).ld) );\
+                             SYRK_T( C, Z );\
                              _alpha = 1.0;
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-#define SYEV( E, d ) if (_work == NULL) {\
-                       _work = (NUMTYPE*) malloc(sizeof(NUMTYPE));\
-                       _lwork = 1;\
-                     }\
-                     xSYEV( &_jobz,&_uplo,&((E).rows),(E).elem,&((E).ld),\
-                            (d), _work, &_n1, &_info );\
-                     if ((int) _work[0] > _lwork) {\
-                       _lwork = (int) _work[0];\
-                       if (_work) {\
-                         free( _work );\
-                       }\
-                       _work = (NUMTYPE*) malloc( sizeof(NUMTYPE) * _lwork );\
-                     }\
-                     xSYEV( &_jobz,&_uplo,&((E).rows),(E).elem,&((E).ld),\
-                            (d), _work, &_lwork, &_info )
+#define SYEV( E, d ) mat_eigSym( &(E), (d) )
 
 // These are the fortran functions that we will need to link with at compile
 // time.
@@ -495,6 +633,25 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                float const *beta,
                float *y, int const *incy );
 
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void ssyrk_( char const *uplo, char const *trans,
+               int const *n, int const *k,
+               float const *alpha,
+               float const *A, int const *ldA,
+               float const *beta,
+               float *C, int const *ldC );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void ssymm_( char const *side, char const *uplo,
+               int const *m, int const *n,
+               float const *alpha,
+               float const *A, int const *ldA,
+               float const *B, int const *ldB,
+               float const *beta,
+               float *C, int const *ldC );
+
   //////////////////////////////////////////////////////////////////////////////
   //////////////////////////////////////////////////////////////////////////////
   void ssyev_( char const *jobz, char const *uplo, int const *n,
@@ -502,6 +659,27 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                float *w,
                float *work, int const *lwork,
                int *info );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void ssyevd_( char const *jobz, char const *uplo, int const *n,
+                float *A, int const *ldA,
+                float *w,
+                float *work, int const *lwork,
+                int *iwork, int const *liwork,
+                int *info );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void ssyevr_( char const *jobz, char const *range, char const *uplo,
+                int const *n, float *A, int const *ldA,
+                float const *vl, float const *vu,
+                int const *il, int const *iu,
+                float const *abstol, int *m,
+                float *w, float *Z, int const *ldZ, int *isuppz,
+                float *work, int const *lwork,
+                int *iwork, int const *liwork,
+                int *info );
 #else
   //////////////////////////////////////////////////////////////////////////////
   //////////////////////////////////////////////////////////////////////////////
@@ -522,6 +700,25 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                double const *beta,
                double *y, int const *incy );
 
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void dsyrk_( char const *uplo, char const *trans,
+               int const *n, int const *k,
+               double const *alpha,
+               double const *A, int const *ldA,
+               double const *beta,
+               double *C, int const *ldC );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void dsymm_( char const *side, char const *uplo,
+               int const *m, int const *n,
+               double const *alpha,
+               double const *A, int const *ldA,
+               double const *B, int const *ldB,
+               double const *beta,
+               double *C, int const *ldC );
+
   //////////////////////////////////////////////////////////////////////////////
   //////////////////////////////////////////////////////////////////////////////
   void dsyev_( char const *jobz, char const *uplo, int const *n,
@@ -529,21 +726,47 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
                double *w,
                double *work, int const *lwork,
                int *info );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void dsyevd_( char const *jobz, char const *uplo, int const *n,
+                double *A, int const *ldA,
+                double *w,
+                double *work, int const *lwork,
+                int *iwork, int const *liwork,
+                int *info );
+
+  //////////////////////////////////////////////////////////////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  void dsyevr_( char const *jobz, char const *range, char const *uplo,
+                int const *n, double *A, int const *ldA,
+                double const *vl, double const *vu,
+                int const *il, int const *iu,
+                double const *abstol, int *m,
+                double *w, double *Z, int const *ldZ, int *isuppz,
+                double *work, int const *lwork,
+                int *iwork, int const *liwork,
+                int *info );
 #endif
 
+// The placeholder variables that the macros modify (COVARIANCE() scales by
+// _alpha, and SYEV() sets _info) are kept per thread, so that the macros may be
+// used from several threads at once.
+#define MATRIX_TLS __thread
+
 // These are the placeholder variables we need to use the BLAS routines.
 extern char _not_transpose;
 extern char _transpose;
-extern NUMTYPE _alpha;
+extern MATRIX_TLS NUMTYPE _alpha;
 extern NUMTYPE _beta;
+extern NUMTYPE _beta_add;
 
 extern char _jobz;
 extern char _uplo;
+extern char _left;
 extern int _one;
 extern int _n1;
-extern int _lwork;
-extern int _info;
-extern NUMTYPE *_work;
+extern MATRIX_TLS int _info;
 
 #ifdef __cplusplus
 }
@@ -15,6 +15,39 @@
  * point numbers as the number type. The trigonometric functions cannot handle
  * doubles.
  */
+#ifdef USE_SINGLE
+  #define NUMTYPE_NATIVE float
+  #define NUMTYPE_ALT    double
+#else
+  #define NUMTYPE_NATIVE double
+  #define NUMTYPE_ALT    float
+#endif
+
+/**
+ * The ICA implementations, and the matrix routines they use, are also built a
+ * second time in the alternate precision, by compiling the same sources with
+ * ALT_PRECISION defined (see the Makefile), so that one program can run the
+ * ICA computation in either precision (see the `precision' parameter described
+ * in ica/ica.h).
+ *
+ * In the alternate build, USE_SINGLE is flipped, so NUMTYPE (and everything
+ * else that depends on USE_SINGLE) becomes the other of 'float' and 'double',
+ * and every function and global variable is renamed with an "_alt" suffix (see
+ * alt_names.h) so that the two builds can be linked together. NUMTYPE_NATIVE
+ * and NUMTYPE_ALT are the same in both builds: NUMTYPE_NATIVE is the precision
+ * chosen by USE_SINGLE, used wherever the two builds share a data structure,
+ * and NUMTYPE_ALT is the other one.
+ */
+#ifdef ALT_PRECISION
+  #ifdef USE_SINGLE
+    #undef USE_SINGLE
+  #else
+    #define USE_SINGLE
+  #endif
+
+  #include "alt_names.h"
+#endif
+
 #ifdef USE_SINGLE
   #define NUMTYPE float
 #else
@@ -396,3 +396,34 @@ void movingAverage( NUMTYPE *output, const NUMTYPE *input,
     *(output++) = sum;
   }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int blinkPattern( NUMTYPE *pattern, const Matrix *mat_X, const int *blinks,
+                  int num_blinks )
+{
+  int i, j;
+  NUMTYPE mean;
+
+  if (num_blinks <= 0) {
+    return 0;
+  }
+
+  for (j = 0; j < mat_X->rows; j++) {
+    // Find the mean of the row.
+    mean = 0.0;
+    for (i = 0; i < mat_X->cols; i++) {
+      mean += mat_X->elem[ i * mat_X->ld + j ];
+    }
+    mean /= (NUMTYPE) mat_X->cols;
+
+    // Average the row's (zero-mean) value at each of the blinks.
+    pattern[j] = 0.0;
+    for (i = 0; i < num_blinks; i++) {
+      pattern[j] += mat_X->elem[ blinks[i] * mat_X->ld + j ] - mean;
+    }
+    pattern[j] /= (NUMTYPE) num_blinks;
+  }
+
+  return 1;
+}
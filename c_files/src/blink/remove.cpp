@@ -71,7 +71,7 @@ void blinkRemoveFromEDF( const char *input_edf, const char *output_edf,
   }
 
   // Find and remove the blinks in the EEG.
-  blinkRemove( &R, &X, channels, 4, NULL, 0, ica_params, &b_params );
+  blinkRemove( &R, &X, channels, 4, NULL, 0, ica_params, &b_params, NULL );
 
   //////////////////////////////////////////////////////////////////////////////
   // Save the new EEG data to an EDF file.
@@ -100,13 +100,15 @@ void blinkRemoveFromEDF( const char *input_edf, const char *output_edf,
 int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
                  const NUMTYPE *channels, int num_channels,
                  const int *keep, int num_keep,
-                 ICAParams *ica_params, const BlinkParams *b_params )
+                 ICAParams *ica_params, const BlinkParams *b_params,
+                 Matrix *mat_W )
 {
-  int i, j, k, restore, num_blinks, blink_source;
+  int i, j, k, restore, num_blinks, blink_source, deflate;
   int *blinks, *blinks_in_source;
 
   Matrix Wa, Aa, Sa;
-  NUMTYPE *mu_Sa, *mu_X;
+  NUMTYPE *mu_Sa, *mu_X, *pattern, *blink_row, diff;
+  NUMTYPE_NATIVE const *seed;
 
   pthread_attr_t attr;
   pthread_t ica_thread;
@@ -126,18 +128,44 @@ int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
   Sa.rows = Sa.ld  = mat_X->rows;
   Sa.cols = Sa.lag = mat_X->cols;
 
-  Wa.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Wa.ld * Wa.lag );
+  // If we're keeping the unmixing matrix between calls, have ICA work on it
+  // directly.
+  if (mat_W) {
+    Wa.elem = mat_W->elem;
+  } else {
+    Wa.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Wa.ld * Wa.lag );
+  }
   Aa.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Aa.ld * Aa.lag );
   Sa.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Sa.ld * Sa.lag );
 
   mu_Sa = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Sa.rows );
   mu_X  = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Sa.rows );
 
+  pattern   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Sa.rows );
+  blink_row = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Sa.cols );
+
+  // If we've been asked for only some of the components, then ICA will extract
+  // them one at a time, and we can point it straight at the blink source by
+  // seeding it with the spatial pattern of the blinks. That means finding the
+  // blinks before starting ICA, rather than while it runs. The caller's own
+  // seed is put back once ICA is done.
+  seed = ica_params->seed;
+  deflate = (ica_params->num_components > 0 &&
+             ica_params->num_components < mat_X->rows);
+  if (deflate) {
+    blinks = blinkDetect( &num_blinks, channels, mat_X->cols, 4, b_params );
+    if (blinkPattern( pattern, mat_X, blinks, num_blinks )) {
+      ica_params->seed = pattern;
+    }
+  }
+
   // Initialize pthread stuff.
   pthread_attr_init( &attr );
   ica_thr_data.X = mat_X;   ica_thr_data.W = &Wa; ica_thr_data.mu_S = mu_Sa;
   ica_thr_data.S = &Sa; ica_thr_data.A = &Aa;
   ica_thr_data.ica_params = ica_params;
+  ica_thr_data.W_init = (mat_W && mat_W->rows > 0) ? mat_W : NULL;
+  ica_thr_data.ctx = NULL;
 
   //////////////////////////////////////////////////////////////////////////////
   // Setup is complete. Begin processing.
@@ -148,10 +176,18 @@ int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
   pthread_attr_destroy( &attr );
 
   // Find the blinks in the EEG.
-  blinks = blinkDetect( &num_blinks, channels, mat_X->cols, 4, b_params );
+  if (!deflate) {
+    blinks = blinkDetect( &num_blinks, channels, mat_X->cols, 4, b_params );
+  }
 
   // Wait for ICA to complete so we can find the blink source signal.
   pthread_join( ica_thread, NULL );
+  ica_params->seed = seed;
+
+  if (mat_W) {
+    mat_W->rows = Wa.rows; mat_W->cols = Wa.cols;
+    mat_W->ld   = Wa.ld;   mat_W->lag  = Wa.lag;
+  }
 
   // Find the blink source.
   blink_source = blinkSource( &Sa, blinks, num_blinks, b_params );
@@ -162,29 +198,58 @@ int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
 
   //////////////////////////////////////////////////////////////////////////////
   // Flatten the blink source for 0.4 seconds centered around the locations of
-  // blinks.
+  // blinks, remembering what the blink source looked like beforehand.
   //////////////////////////////////////////////////////////////////////////////
+  for (i = 0; i < Sa.cols; i++) {
+    blink_row[i] = Sa.elem[ i * Sa.ld + blink_source ];
+  }
+
   blinkFlatten( &Sa, blinks_in_source, num_blinks, blink_source, b_params );
 
   //////////////////////////////////////////////////////////////////////////////
   // Reconstruct the EEG with the modified blink source.
   //////////////////////////////////////////////////////////////////////////////
-  GEMM( (*mat_R), Aa, Sa );
-  GEMV( mu_X, Aa, mu_Sa );
-
-  // Add the mean back in, and restore any rows we were told to 'keep'.
-  for (i = 0; i < mat_R->cols; i++) {
-    for (j = 0; j < mat_R->rows; j++) {
-      // Check to see if we should restore the row.
-      restore = 0;
-      for (k = 0; k < num_keep; k++) {
-        if (j == keep[k]) { restore = 1; break; }
+  if (Sa.rows < mat_X->rows) {
+    // Only some of the components were extracted, so A * S can't reconstruct
+    // the EEG. Instead, subtract out the part of the blink component that was
+    // flattened away:
+    //    R = X - a * (s - s_flat)
+    // where a is the blink source's column of A and s its row of S.
+    for (i = 0; i < mat_R->cols; i++) {
+      diff = blink_row[i] - Sa.elem[ i * Sa.ld + blink_source ];
+
+      for (j = 0; j < mat_R->rows; j++) {
+        // Check to see if we should restore the row.
+        restore = 0;
+        for (k = 0; k < num_keep; k++) {
+          if (j == keep[k]) { restore = 1; break; }
+        }
+
+        mat_R->elem[ i * mat_R->ld + j ] = mat_X->elem[ i * mat_X->ld + j ];
+        if (!restore) {
+          mat_R->elem[ i * mat_R->ld + j ] -=
+                                    Aa.elem[ blink_source * Aa.ld + j ] * diff;
+        }
       }
-
-      if (restore) {
-        mat_R->elem[ i * mat_R->ld + j ]  = mat_X->elem[ i * mat_X->ld + j ];
-      } else {
-        mat_R->elem[ i * mat_R->ld + j ] += mu_X[j];
+    }
+  } else {
+    GEMM( (*mat_R), Aa, Sa );
+    GEMV( mu_X, Aa, mu_Sa );
+
+    // Add the mean back in, and restore any rows we were told to 'keep'.
+    for (i = 0; i < mat_R->cols; i++) {
+      for (j = 0; j < mat_R->rows; j++) {
+        // Check to see if we should restore the row.
+        restore = 0;
+        for (k = 0; k < num_keep; k++) {
+          if (j == keep[k]) { restore = 1; break; }
+        }
+
+        if (restore) {
+          mat_R->elem[ i * mat_R->ld + j ]  = mat_X->elem[ i * mat_X->ld + j ];
+        } else {
+          mat_R->elem[ i * mat_R->ld + j ] += mu_X[j];
+        }
       }
     }
   }
@@ -192,8 +257,9 @@ int blinkRemove( Matrix *mat_R, const Matrix *mat_X,
   //////////////////////////////////////////////////////////////////////////////
   // Clean up and return.
   //////////////////////////////////////////////////////////////////////////////
-  free( Wa.elem ); free( Aa.elem ); free( Sa.elem );
-  free( mu_Sa ); free( mu_X );
+  if (!mat_W) { free( Wa.elem ); }
+  free( Aa.elem ); free( Sa.elem );
+  free( mu_Sa ); free( mu_X ); free( pattern ); free( blink_row );
   free( blinks ); //free( blinks_in_source );
 
   return 0;
@@ -29,14 +29,28 @@ void usage( const char *name )
 "        Which contrast function to use (default 'tanh'). One of:\n"
 "          tanh, cube, gauss\n"
 "\n"
+"    -cal, --calibration FILE\n"
+"        Load the calibration table used by '-i auto' from this file, or if\n"
+"        it can't be loaded (or was measured on another host), measure one\n"
+"        and save it there.\n"
+"\n"
+"    -dc, --decimate FACTOR\n"
+"        Learn the unmixing matrix from the EEG data low-pass filtered and\n"
+"        decimated by this factor, then apply it at the full sampling rate\n"
+"        (default 1, no decimation). Blinks are slow, so a factor that keeps\n"
+"        the new sampling rate above about 60 Hz loses little.\n"
+"\n"
 "    -e, --epsilon NUM\n"
 "        Convergence criteria epsilon to use (default 0.0001).\n"
 "\n"
 "    -i, --implementation TYPE\n"
 "        Which implementation to use (default 'fastica'). One of:\n"
-"          fastica, jade\n"
-"        If jade is specified, the contrast, epsilon and iteration options\n"
-"        are unused.\n"
+"          fastica, jade, picard, sobi, auto\n"
+"        If jade or sobi is specified, the contrast, epsilon and iteration\n"
+"        options are unused. If picard is specified, the contrast option is\n"
+"        unused. With auto, FastICA (and its contrast) or JADE is chosen for\n"
+"        the number of channels from the calibration table (see -cal), within\n"
+"        the time limit if one is given (see -tl).\n"
 "\n"
 "    -in, --in-file IN_FILE\n"
 "        The name of the EDF file from which to read EEG data.\n"
@@ -47,6 +61,10 @@ void usage( const char *name )
 "    -o, --out-file OUT_FILE\n"
 "        The name of the file to which to save the extracted source signal.\n"
 "\n"
+"    -tl, --time_limit SECONDS\n"
+"        Stop each CPU run of ICA after this many seconds, keeping the best\n"
+"        result so far (default 0, no limit).\n"
+"\n"
 #ifdef ENABLE_GPU
 "    -g, --gpu\n"
 "        Use the GPU implementation of ICA.\n"
@@ -70,6 +88,9 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
   cmd_args->max_iter   = 400;
   cmd_args->implem     = ICA_FASTICA;
   cmd_args->use_gpu    = 0;
+  cmd_args->decimate   = DEF_DECIMATE;
+  cmd_args->calibration = NULL;
+  cmd_args->time_limit = DEF_TIME_LIMIT;
 
   // Define a macro to make parameter comparison cleaner in the code.
   #define PARAM_EQUALS( sn, ln ) (strcmp( (sn), (*argv)[i] ) == 0 ||\
@@ -90,6 +111,10 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
           return 0;
         }
 
+        i += 2;
+      } else if (PARAM_EQUALS( "-cal", "--calibration" )) {
+        cmd_args->calibration = (*argv)[i+1];
+
         i += 2;
       } else if (PARAM_EQUALS( "-in", "--in-file")) {
         cmd_args->in_file = (*argv)[i+1];
@@ -99,6 +124,15 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
           return 0;
         }
         fclose(file);
+        i += 2;
+      } else if (PARAM_EQUALS("-dc", "--decimate")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Decimation factor, %s, invalid. Must be >= 0.\n",
+                  (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->decimate = atoi( (*argv)[i+1] );
+
         i += 2;
       } else if (PARAM_EQUALS("-e", "--epsilon")) {
         cmd_args->epsilon = strtod( (*argv)[i+1], NULL );
@@ -113,9 +147,15 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
       } else if (PARAM_EQUALS("-i", "--implementation")) {
         if (strcmp( "jade", (*argv)[i+1] ) == 0) {
           cmd_args->implem = ICA_JADE;
+        } else if (strcmp( "picard", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_PICARD;
+        } else if (strcmp( "sobi", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_SOBI;
+        } else if (strcmp( "auto", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_AUTO;
         } else if (strcmp( "fastica", (*argv)[i+1] ) != 0) {
-          fprintf(stderr, "Implementation value, %s, invalid. "
-                          "Must be one of 'jade' or 'fastica'.\n",
+          fprintf(stderr, "Implementation value, %s, invalid. Must be one "
+                          "of 'jade', 'picard', 'sobi', 'auto', or 'fastica'.\n",
                           (*argv)[i+1]);
           return 0;
         }
@@ -145,6 +185,16 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
           return 0;
         }
         fclose(file);
+        i += 2;
+      } else if (PARAM_EQUALS( "-tl", "--time_limit" )) {
+        cmd_args->time_limit = strtod( (*argv)[i+1], NULL );
+
+        if (cmd_args->time_limit < 0) {
+          fprintf(stderr, "Time limit, %g, invalid. Must be >= 0.\n",
+                  cmd_args->time_limit);
+          return 0;
+        }
+
         i += 2;
       } else {
         usage( (*argv)[0] );
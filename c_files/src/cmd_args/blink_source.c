@@ -39,9 +39,10 @@ void usage( const char *name )
 "\n"
 "    -i, --implementation TYPE\n"
 "        Which implementation to use (default 'fastica'). One of:\n"
-"          fastica, jade\n"
-"        If jade is specified, the contrast, epsilon and iteration options\n"
-"        are unused.\n"
+"          fastica, jade, picard, sobi\n"
+"        If jade or sobi is specified, the contrast, epsilon and iteration\n"
+"        options are unused. If picard is specified, the contrast option is\n"
+"        unused.\n"
 "\n"
 "    -mi, --max_iterations NUM\n"
 "        The maximum number of iterations to perform (default 400).\n"
@@ -115,9 +116,13 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
       } else if (PARAM_EQUALS("-i", "--implementation")) {
         if (strcmp( "jade", (*argv)[i+1] ) == 0) {
           cmd_args->implem = ICA_JADE;
+        } else if (strcmp( "picard", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_PICARD;
+        } else if (strcmp( "sobi", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_SOBI;
         } else if (strcmp( "fastica", (*argv)[i+1] ) != 0) {
           fprintf(stderr, "Implementation value, %s, invalid. "
-                          "Must be one of 'jade' or 'fastica'.\n",
+                          "Must be one of 'jade', 'picard', 'sobi', or 'fastica'.\n",
                           (*argv)[i+1]);
           return 0;
         }
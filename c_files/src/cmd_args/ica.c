@@ -31,16 +31,101 @@ void usage( const char *name )
 "        Which contrast function to use (default 'tanh'). One of:\n"
 "          tanh, cube, gauss\n"
 "\n"
+"    -d, --decorrelation TYPE\n"
+"        How symmetric FastICA orthogonalizes the unmixing matrix (default\n"
+"        'eig'). One of:\n"
+"          eig, iter\n"
+"\n"
 "    -e, --epsilon NUM\n"
 "        Convergence criteria epsilon to use (default 0.0001).\n"
 "\n"
 "    -i, --implementation TYPE\n"
 "        Which implementation to use (default 'fastica'). One of:\n"
-"          fastica, jade\n"
+"          fastica, jade, picard, sobi, auto\n"
+"        With 'auto', FastICA (and its contrast) or JADE is chosen for each\n"
+"        input from the calibration table (see -cal), within the time limit\n"
+"        if one is given (see -tl).\n"
+"\n"
+"    -cal, --calibration FILE\n"
+"        Load the calibration table used by '-i auto' from this file, or if\n"
+"        it can't be loaded (or was measured on another host), measure one\n"
+"        and save it there.\n"
+"\n"
+"    -l, --lags NUM\n"
+"        The number of time lags SOBI uses (default 100).\n"
 "\n"
 "    -mi, --max_iterations NUM\n"
 "        The maximum number of iterations to perform (default 400).\n"
 "\n"
+"    -n, --components NUM\n"
+"        The number of independent components to extract with deflationary\n"
+"        FastICA (default 0, extract all of them with symmetric FastICA).\n"
+"\n"
+"    -pd, --pca_dims NUM\n"
+"        The most principal components to keep when whitening, and so the\n"
+"        most sources to separate (default 0, keep all of them).\n"
+"\n"
+"    -pv, --pca_variance FRAC\n"
+"        Keep the fewest principal components that explain at least this\n"
+"        fraction of the variance (default 0, keep all of them).\n"
+"\n"
+"    -pr, --precision TYPE\n"
+"        Which precision the CPU implementation computes in (default\n"
+"        'native', the precision the program was compiled with). One of:\n"
+"          native, single, double, mixed\n"
+"        The 'mixed' precision iterates in single precision, then finishes\n"
+"        up in double precision. JADE and SOBI run it in double precision.\n"
+"\n"
+"    -tl, --time_limit SECONDS\n"
+"        Stop each CPU run after this many seconds, keeping the best result\n"
+"        so far (default 0, no limit).\n"
+"\n"
+"    -mb, --mem_budget MB\n"
+"        Run FastICA with ica_stream(), which reads the observations a chunk\n"
+"        at a time, keeping its workspace within this many megabytes\n"
+"        (default 0, run on the whole observation matrix at once).\n"
+"\n"
+"    -ob, --online_block COLS\n"
+"        Feed the observations to a running FastICA estimate (see\n"
+"        ica_createOnline()) this many at a time, printing the number of\n"
+"        blocks as the iteration count (default 0, run on all of them).\n"
+"\n"
+"    -fg, --forget FACTOR\n"
+"        The running estimate's forgetting factor, in (0, 1] (default\n"
+"        0.999).\n"
+"\n"
+"    -dc, --decimate FACTOR\n"
+"        Learn the unmixing matrix from the observations low-pass filtered\n"
+"        and decimated by this factor, then apply it to all of them\n"
+"        (default 1, no decimation).\n"
+"\n"
+"    -je, --jade_eigenmats\n"
+"        Have JADE jointly diagonalize only the n most significant\n"
+"        eigenmatrices of the cumulant tensor. With '-i jade', each CPU run\n"
+"        is repeated without the reduction, and the speedup and the Amari\n"
+"        distance between the two unmixing matrices are reported.\n"
+"\n"
+"    -tr, --trace\n"
+"        Print the convergence metric after every CPU iteration/sweep, and\n"
+"        the time spent in each phase of every CPU run.\n"
+"\n"
+"    -t, --threads NUM\n"
+"        The number of CPU threads to use (default 0, one per processor).\n"
+"\n"
+"    -vm, --vmath ISA\n"
+"        Which vectorized tanh()/exp() routines to use (default 'auto'). One\n"
+"        of:\n"
+"          auto, scalar, avx2, avx512\n"
+"\n"
+"    -w, --warm_start\n"
+"        After each CPU run, run ICA again starting from the unmixing matrix\n"
+"        that was found, and report the runtime and iterations/sweeps.\n"
+"\n"
+"    -vv, --verify_vmath\n"
+"        After each CPU run, compare every supported tanh()/exp()\n"
+"        implementation against the C library over the range of values\n"
+"        reached by the computed source signals, and print the max errors.\n"
+"\n"
 #ifdef ENABLE_GPU
 "    -g, --gpu\n"
 "        Run only the GPU implementation of ICA.\n"
@@ -74,6 +159,24 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
   cmd_args->gpu_only   = 0;
   cmd_args->compare    = 0;
   cmd_args->print      = 0;
+  cmd_args->num_threads = DEF_NUM_THREADS;
+  cmd_args->num_components = DEF_NUM_COMPONENTS;
+  cmd_args->pca_dims    = DEF_PCA_DIMS;
+  cmd_args->pca_variance = DEF_PCA_VARIANCE;
+  cmd_args->decorr      = DEF_DECORR;
+  cmd_args->num_lags    = DEF_NUM_LAGS;
+  cmd_args->precision   = DEF_PRECISION;
+  cmd_args->vmath       = VMATH_AUTO;
+  cmd_args->verify_vmath = 0;
+  cmd_args->warm_start  = 0;
+  cmd_args->trace       = 0;
+  cmd_args->time_limit  = DEF_TIME_LIMIT;
+  cmd_args->mem_budget  = 0.0;
+  cmd_args->decimate    = DEF_DECIMATE;
+  cmd_args->jade_eigenmats = DEF_JADE_EIGENMATS;
+  cmd_args->online_block = 0;
+  cmd_args->forget      = DEF_FORGET;
+  cmd_args->calibration = NULL;
 
   // Define a macro to make parameter comparison cleaner in the code.
   #define PARAM_EQUALS( sn, ln ) (strcmp( (sn), (*argv)[i] ) == 0 ||\
@@ -105,6 +208,18 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
           return 0;
         }
 
+        i += 2;
+      } else if (PARAM_EQUALS("-d", "--decorrelation")) {
+        if (strcmp( "eig", (*argv)[i+1] ) == 0) {
+          cmd_args->decorr = DECORR_EIG;
+        } else if (strcmp( "iter", (*argv)[i+1] ) == 0) {
+          cmd_args->decorr = DECORR_ITER;
+        } else {
+          fprintf(stderr, "Unknown decorrelation method, '%s'.\n",
+                          (*argv)[i+1]);
+          return 0;
+        }
+
         i += 2;
       } else if (PARAM_EQUALS("-e", "--epsilon")) {
         cmd_args->epsilon = strtod( (*argv)[i+1], NULL );
@@ -119,14 +234,161 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
       } else if (PARAM_EQUALS("-i", "--implementation")) {
         if (strcmp( "jade", (*argv)[i+1] ) == 0) {
           cmd_args->implem = ICA_JADE;
+        } else if (strcmp( "picard", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_PICARD;
+        } else if (strcmp( "sobi", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_SOBI;
+        } else if (strcmp( "auto", (*argv)[i+1] ) == 0) {
+          cmd_args->implem = ICA_AUTO;
         } else if (strcmp( "fastica", (*argv)[i+1] ) != 0) {
-          fprintf(stderr, "Implementation value, %s, invalid. "
-                          "Must be one of 'jade' or 'fastica'.\n",
+          fprintf(stderr, "Implementation value, %s, invalid. Must be one "
+                          "of 'jade', 'picard', 'sobi', 'auto', or 'fastica'.\n",
+                          (*argv)[i+1]);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-cal", "--calibration")) {
+        cmd_args->calibration = (*argv)[i+1];
+
+        i += 2;
+      } else if (PARAM_EQUALS("-t", "--threads")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Number of threads, %s, invalid. Must be >= 0.\n",
+                          (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->num_threads = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-n", "--components")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Number of components, %s, invalid. Must be >= 0.\n",
+                          (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->num_components = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-l", "--lags")) {
+        if (atoi( (*argv)[i+1] ) <= 0) {
+          fprintf(stderr, "Number of lags, %s, invalid. Must be > 0.\n",
+                          (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->num_lags = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-pd", "--pca_dims")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Number of PCA dimensions, %s, invalid. "
+                          "Must be >= 0.\n", (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->pca_dims = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-pv", "--pca_variance")) {
+        cmd_args->pca_variance = strtod( (*argv)[i+1], NULL );
+
+        if (cmd_args->pca_variance < 0 || cmd_args->pca_variance > 1) {
+          fprintf(stderr, "PCA variance fraction, %g, invalid. "
+                          "Must be in [0, 1].\n", cmd_args->pca_variance);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-pr", "--precision")) {
+        if (strcmp( "native", (*argv)[i+1] ) == 0) {
+          cmd_args->precision = ICA_PRECISION_NATIVE;
+        } else if (strcmp( "single", (*argv)[i+1] ) == 0) {
+          cmd_args->precision = ICA_PRECISION_SINGLE;
+        } else if (strcmp( "double", (*argv)[i+1] ) == 0) {
+          cmd_args->precision = ICA_PRECISION_DOUBLE;
+        } else if (strcmp( "mixed", (*argv)[i+1] ) == 0) {
+          cmd_args->precision = ICA_PRECISION_MIXED;
+        } else {
+          fprintf(stderr, "Unknown precision, '%s'.\n", (*argv)[i+1]);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-vm", "--vmath")) {
+        if (strcmp( "auto", (*argv)[i+1] ) == 0) {
+          cmd_args->vmath = VMATH_AUTO;
+        } else if (strcmp( "scalar", (*argv)[i+1] ) == 0) {
+          cmd_args->vmath = VMATH_SCALAR;
+        } else if (strcmp( "avx2", (*argv)[i+1] ) == 0) {
+          cmd_args->vmath = VMATH_AVX2;
+        } else if (strcmp( "avx512", (*argv)[i+1] ) == 0) {
+          cmd_args->vmath = VMATH_AVX512;
+        } else {
+          fprintf(stderr, "Unknown vmath implementation, '%s'.\n",
                           (*argv)[i+1]);
           return 0;
         }
 
         i += 2;
+      } else if (PARAM_EQUALS("-w", "--warm_start")) {
+        cmd_args->warm_start = 1;
+        i += 1;
+      } else if (PARAM_EQUALS("-je", "--jade_eigenmats")) {
+        cmd_args->jade_eigenmats = 1;
+        i += 1;
+      } else if (PARAM_EQUALS("-tl", "--time_limit")) {
+        cmd_args->time_limit = strtod( (*argv)[i+1], NULL );
+
+        if (cmd_args->time_limit < 0) {
+          fprintf(stderr, "Time limit, %g, invalid. Must be at least 0.\n",
+                          cmd_args->time_limit);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-mb", "--mem_budget")) {
+        cmd_args->mem_budget = strtod( (*argv)[i+1], NULL );
+
+        if (cmd_args->mem_budget < 0) {
+          fprintf(stderr, "Memory budget, %g, invalid. Must be at least 0.\n",
+                          cmd_args->mem_budget);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-ob", "--online_block")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Online block size, %s, invalid. "
+                          "Must be >= 0.\n", (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->online_block = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-fg", "--forget")) {
+        cmd_args->forget = strtod( (*argv)[i+1], NULL );
+
+        if (cmd_args->forget <= 0 || cmd_args->forget > 1) {
+          fprintf(stderr, "Forgetting factor, %g, invalid. "
+                          "Must be in (0, 1].\n", cmd_args->forget);
+          return 0;
+        }
+
+        i += 2;
+      } else if (PARAM_EQUALS("-dc", "--decimate")) {
+        if (atoi( (*argv)[i+1] ) < 0) {
+          fprintf(stderr, "Decimation factor, %s, invalid. "
+                          "Must be >= 0.\n", (*argv)[i+1]);
+          return 0;
+        }
+        cmd_args->decimate = atoi( (*argv)[i+1] );
+
+        i += 2;
+      } else if (PARAM_EQUALS("-tr", "--trace")) {
+        cmd_args->trace = 1;
+        i += 1;
+      } else if (PARAM_EQUALS("-vv", "--verify_vmath")) {
+        cmd_args->verify_vmath = 1;
+        i += 1;
 #ifdef ENABLE_GPU
       } else if (PARAM_EQUALS("-g", "--gpu")) {
         cmd_args->gpu_only = 1;
@@ -1,6 +1,7 @@
 #include "cmd_args/runtime.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -29,6 +30,13 @@ void usage( const char *name )
 "     Specify the number of samples to obtain for calculating the average and\n"
 "     standard deviation.\n"
 "\n"
+"  -c, --calibrate FILE\n"
+"     Instead, measure a calibration table for choosing an implementation\n"
+"     per problem size with ICA_AUTO (see ica_calibrate()), on mixtures of\n"
+"     non-Gaussian sources with up to the largest matrix size's number of\n"
+"     variables, timing each run the given number of samples times, and save\n"
+"     it to FILE (see ica_loadCalibration()).\n"
+"\n"
 , name );
 }
 
@@ -41,18 +49,22 @@ unsigned int parseArgs( int *argc, char ***argv, CmdLineArgs *cmd_args )
   // Setup default values.
   cmd_args->samples = 20;
   cmd_args->demo    = 0;
+  cmd_args->calibration = NULL;
 
   // Define a macro to make parameter comparison cleaner in the code.
   #define PARAM_EQUALS( sn, ln ) (strcmp( (sn), (*argv)[i] ) == 0 ||\
                                   strcmp( (ln), (*argv)[i] ) == 0)
 
-  for (i = 1; i < *argc; i++) {
+  for (i = 1; i < *argc;) {
     if (PARAM_EQUALS("-h", "--help")) {
       usage( (*argv)[0] );
       return 0;
     } else if (PARAM_EQUALS( "-d", "--demo" )) {
       cmd_args->demo = 1;
       i++;
+    } else if (PARAM_EQUALS( "-c", "--calibrate" )) {
+      cmd_args->calibration = (*argv)[i+1];
+      i += 2;
     } else if (PARAM_EQUALS( "-s", "--samples" )) {
       cmd_args->samples = atoi( (*argv)[i+1] );
       if (cmd_args->samples <= 0) {
@@ -21,6 +21,20 @@ EdeModel *ede_model_new()
   model->ica_params.num_obs = 0;
   model->ica_params.use_gpu = 0;
   model->ica_params.gpu_device = DEF_GPU_DEVICE;
+  model->ica_params.num_threads = DEF_NUM_THREADS;
+  model->ica_params.num_components = DEF_NUM_COMPONENTS;
+  model->ica_params.seed = NULL;
+  model->ica_params.pca_dims = DEF_PCA_DIMS;
+  model->ica_params.pca_variance = DEF_PCA_VARIANCE;
+  model->ica_params.decorr = DEF_DECORR;
+  model->ica_params.num_lags = DEF_NUM_LAGS;
+  model->ica_params.precision = DEF_PRECISION;
+  model->ica_params.observer = NULL;
+  model->ica_params.observer_data = NULL;
+  model->ica_params.cancel = NULL;
+  model->ica_params.time_limit = DEF_TIME_LIMIT;
+  model->ica_params.decimate = DEF_DECIMATE;
+  model->ica_params.jade_eigenmats = DEF_JADE_EIGENMATS;
 
   // Initialize the blink parameters to their default values.
   model->b_params.f_s   = 0.0;
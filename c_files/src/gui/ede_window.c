@@ -332,7 +332,7 @@ xltek_getNextSamples( model->erd_file, myself->samples );
   blinkRemove( &(mat_R), &(model->mat_X),
                channels,        4,
                myself->eog_ids, 2,
-               &(model->ica_params), &(model->b_params) );
+               &(model->ica_params), &(model->b_params), NULL );
   
   // Save the processed EEG data.
   for (col = 0; col < model->proc_samples; col++) {
@@ -457,8 +457,9 @@ void *ede_processEeg( void *data )
   GtkEdeWindow *myself = (GtkEdeWindow*) data;
   EdeModel *model = myself->model;
 
-  // Local copies of model parameters.
-  Matrix      mat_X, mat_R;
+  // Local copies of model parameters. The unmixing matrix found for one window
+  // of observations is kept for the next, since the windows overlap heavily.
+  Matrix      mat_X, mat_R, mat_W;
   ICAParams   ica_params;
   BlinkParams b_params;
 
@@ -478,6 +479,10 @@ void *ede_processEeg( void *data )
 
   channels = (NUMTYPE*) malloc( sizeof(NUMTYPE) * 4 * mat_X.cols );
 
+  mat_W.ld   = mat_W.lag = mat_X.rows;
+  mat_W.rows = mat_W.cols = 0;
+  mat_W.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * mat_W.ld * mat_W.lag );
+
   // Keep on processing until we're told to cancel.
   while (!(myself->ica_cancel)) {
 
@@ -499,6 +504,10 @@ void *ede_processEeg( void *data )
     pthread_mutex_unlock( &(model->mat_lock) );
     pthread_mutex_unlock( &(model->eeg_lock) );
 
+    // Let a new file being opened stop ICA part way through, rather than
+    // waiting for it to finish.
+    ica_params.cancel = &(myself->ica_cancel);
+
     ////////////////////////////////////////////////////////////////////////////
     // Calculate the channels (stored in row-major order) for blink detection.
     ////////////////////////////////////////////////////////////////////////////
@@ -513,7 +522,13 @@ void *ede_processEeg( void *data )
 
     // Call the magic function.
     blinkRemove( &(mat_R), &(mat_X), channels, 4, myself->eog_ids, 2,
-                 &ica_params, &b_params );
+                 &ica_params, &b_params, &mat_W );
+
+    // If ICA was cancelled, the results are only half-baked, and the model is
+    // about to be replaced anyway.
+    if (myself->ica_cancel) {
+      break;
+    }
 
     // Save the processed EEG data and shift the observation matrix.
     pthread_mutex_lock( &(model->eeg_lock) );
@@ -555,6 +570,8 @@ void *ede_processEeg( void *data )
     pthread_mutex_unlock( &(model->eeg_lock) );
   }
 
+  free( mat_W.elem );
+
   // Unlock the thread's mutex to signal that the thread is exiting.
   pthread_mutex_unlock( &(myself->ica_lock) );
 
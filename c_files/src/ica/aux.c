@@ -3,6 +3,15 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Convergence criteria for iterDecorrelate(): how far (on average, per row) the
+// squared singular values may be from one, and the most iterations to perform.
+#define ITER_DECORR_EPSILON   1e-6
+#define ITER_DECORR_MAX_ITER  100
+
+// The most Jacobi sweeps jointDiagonalize() will perform.
+#define JOINT_DIAG_MAX_SWEEPS 100
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -61,33 +70,32 @@ void remmeanTranspose( NUMTYPE *means, Matrix *Z, Matrix const *X )
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void whiten( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
-             Matrix const *Z, int transpose )
+unsigned int whiten( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
+                     Matrix const *Z, int transpose, NUMTYPE *eig_vals,
+                     unsigned int max_dims, NUMTYPE variance )
 {
-  computeWhiten( whiten, dewhiten, Z, transpose );
+  unsigned int num_dims;
+
+  num_dims = computeWhiten( whiten, dewhiten, Z, transpose, eig_vals,
+                            max_dims, variance );
 
   // Whiten the zero-mean data using the whitening matrix.
+  white_Z->rows = white_Z->ld = num_dims;
   if (transpose) {
     GEMM_NT( *white_Z, *whiten, *Z );
   } else {
     GEMM( *white_Z, *whiten, *Z );
   }
+
+  return num_dims;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void computeWhiten( Matrix *whiten, Matrix *dewhiten, Matrix const *Z,
-                    int transpose )
+unsigned int computeWhiten( Matrix *whiten, Matrix *dewhiten, Matrix const *Z,
+                            int transpose, NUMTYPE *eig_vals,
+                            unsigned int max_dims, NUMTYPE variance )
 {
-  unsigned int row, col, i;
-  NUMTYPE eig_inv_sqr, eig_sqr, *eig_vals;
-
-  if (transpose) {
-    eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows );
-  } else {
-    eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->cols );
-  }
-
   // To make observations white, we find the eigenvalue decomposition of the
   // zero-mean observations' covariance matrix. This lets us compute whitening
   // and dewhitening matrices. The whitening matrix will convert our zero-mean
@@ -101,23 +109,736 @@ void computeWhiten( Matrix *whiten, Matrix *dewhiten, Matrix const *Z,
   // where D is the diagonal matrix of eigenvalues and E' is the transpose of
   // the eigenvector matrix, both coming from the covariance matrix of the zero-
   // mean observations.
+  dewhiten->cols = dewhiten->rows;
+
   if (transpose) {
     COVARIANCE_T( *dewhiten, *Z );
   } else {
     COVARIANCE( *dewhiten, *Z );
   }
+
+  return covarianceWhiten( whiten, dewhiten, eig_vals, max_dims, variance );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int covarianceWhiten( Matrix *whiten, Matrix *dewhiten,
+                               NUMTYPE *eig_vals, unsigned int max_dims,
+                               NUMTYPE variance )
+{
+  unsigned int row, col, i, num_var, num_dims, first;
+  NUMTYPE eig_inv_sqr, eig_sqr, total, kept;
+
+  // The covariance matrix is in dewhiten, and is replaced by its eigenvectors.
+  num_var = dewhiten->rows;
+  dewhiten->cols = num_var;
   SYEV( *dewhiten, eig_vals );
 
-  for (col = 0; col < whiten->cols; col++) {
-    eig_inv_sqr = 1.0 / sqrt( eig_vals[col] );
-    eig_sqr     = sqrt( eig_vals[col] );
+  //////////////////////////////////////////////////////////////////////////////
+  // Decide how many principal components to keep. The eigenvalues come back in
+  // ascending order, so the ones we keep are the last `num_dims' of them.
+  //////////////////////////////////////////////////////////////////////////////
+  num_dims = num_var;
+  if (max_dims > 0 && max_dims < num_dims) {
+    num_dims = max_dims;
+  }
+
+  if (variance > 0.0 && variance < 1.0) {
+    total = 0.0;
+    for (i = 0; i < num_var; i++) {
+      if (eig_vals[i] > 0.0) { total += eig_vals[i]; }
+    }
+
+    kept = 0.0;
+    for (i = 1; i <= num_var && kept < variance * total; i++) {
+      kept += eig_vals[num_var - i];
+    }
+
+    if (i > 1 && i - 1 < num_dims) {
+      num_dims = i - 1;
+    }
+  }
+  first = num_var - num_dims;
+
+  for (col = 0; col < num_dims; col++) {
+    eig_vals[col] = eig_vals[first + col];
+    eig_inv_sqr   = 1.0 / sqrt( eig_vals[col] );
+    eig_sqr       = sqrt( eig_vals[col] );
+
+    for (row = 0; row < num_var; row++) {
+      i = (first + col) * dewhiten->ld + row;
+      whiten->elem[row*num_dims + col]   = eig_inv_sqr * dewhiten->elem[i];
+      dewhiten->elem[col*dewhiten->ld + row] = eig_sqr * dewhiten->elem[i];
+    }
+  }
+
+  whiten->rows   = whiten->ld = num_dims;
+  whiten->cols   = num_var;
+  dewhiten->cols = num_dims;
+
+  return num_dims;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void meanCovariance( NUMTYPE *means, Matrix *C, Matrix const *X,
+                     NUMTYPE *block, NUMTYPE *sums )
+{
+  unsigned int row, col, count;
+  NUMTYPE scale;
+
+  C->rows = C->cols = X->rows;
+  for (col = 0; col < X->rows; col++) {
+    memset( C->elem + col*C->ld, 0, sizeof(NUMTYPE) * X->rows );
+  }
+
+  count = 0;
+  updateStats( means, C, &count, X, 0, block, sums );
+
+  // Turn the scatter matrix into the covariance matrix.
+  scale = 1.0 / (NUMTYPE) (count - 1);
+  for (col = 0; col < X->rows; col++) {
+    for (row = 0; row < X->rows; row++) {
+      C->elem[col*C->ld + row] *= scale;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void updateStats( NUMTYPE *means, Matrix *M2, unsigned int *count,
+                  Matrix const *X, int remove, NUMTYPE *block, NUMTYPE *sums )
+{
+  unsigned int row, col, start, width, max_width, num_var, total;
+  NUMTYPE scale_mean, scale_m2, delta;
+  Matrix B, Y;
+
+  // The observations are handled a block of columns at a time. Each block is
+  // centered on its own mean while it is in the cache, and its scatter matrix
+  // is added to (or subtracted from) M2. The block's mean and scatter are then
+  // merged with those of the other observations (Chan et al.'s pairwise
+  // update). When adding the block to `count' observations:
+  //    delta = mean_B - mean
+  //    M2    = M2 + M2_B + delta * delta' * count * width / (count + width)
+  //    mean  = mean + delta * width / (count + width)
+  // and when removing it, the same update is undone:
+  //    M2    = M2 - M2_B - delta * delta' * count * width / (count - width)
+  //    mean  = mean - delta * width / (count - width)
+  // The block's mean is found by first subtracting the current mean (the first
+  // observation, to begin with), so that delta is summed directly from small
+  // values, even if the variables have large offsets.
+  num_var   = X->rows;
+  max_width = (num_var < WHITEN_BLOCK) ? WHITEN_BLOCK / num_var : 1;
+  if (*count == 0 && !remove) {
+    memcpy( means, X->elem, sizeof(NUMTYPE) * num_var );
+  }
+
+  for (start = 0; start < X->cols; start += width) {
+    width = X->cols - start;
+    if (width > max_width) { width = max_width; }
+
+    // Removing every observation leaves nothing, exactly.
+    if (remove && *count <= width) {
+      memset( means, 0, sizeof(NUMTYPE) * num_var );
+      for (col = 0; col < num_var; col++) {
+        memset( M2->elem + col*M2->ld, 0, sizeof(NUMTYPE) * num_var );
+      }
+      *count = 0;
+      return;
+    }
+
+    B.elem = X->elem + start*X->ld;
+    B.ld   = X->ld;
+
+    Y.elem = block;
+    Y.rows = Y.ld = num_var;
+    Y.cols = width;
+
+    // Find delta, and center the block on its mean.
+    memset( sums, 0, sizeof(NUMTYPE) * num_var );
+    for (col = 0; col < width; col++) {
+      for (row = 0; row < num_var; row++) {
+        Y.elem[col*Y.ld + row] = B.elem[col*B.ld + row] - means[row];
+        sums[row] += Y.elem[col*Y.ld + row];
+      }
+    }
+
+    for (row = 0; row < num_var; row++) {
+      sums[row] /= width;
+    }
+
+    for (col = 0; col < width; col++) {
+      for (row = 0; row < num_var; row++) {
+        Y.elem[col*Y.ld + row] -= sums[row];
+      }
+    }
+
+    // Only the upper triangle of M2 is kept, which is all SYEV reads.
+    if (remove) {
+      _alpha = -1.0;
+      SYRK_ADD( *M2, Y );
+      _alpha = 1.0;
+
+      total      = *count - width;
+      scale_mean = -(NUMTYPE) width / total;
+      scale_m2   = -(NUMTYPE) *count * width / total;
+    } else {
+      SYRK_ADD( *M2, Y );
+
+      total      = *count + width;
+      scale_mean = (NUMTYPE) width / total;
+      scale_m2   = (NUMTYPE) *count * width / total;
+    }
+
+    // Merge the block's mean and scatter with the others'.
+    for (row = 0; row < num_var; row++) {
+      means[row] += sums[row] * scale_mean;
+    }
+
+    if (*count > 0) {
+      for (col = 0; col < num_var; col++) {
+        delta = scale_m2 * sums[col];
+        for (row = 0; row <= col; row++) {
+          M2->elem[col*M2->ld + row] += delta * sums[row];
+        }
+      }
+    }
+
+    *count = total;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int statsCovariance( NUMTYPE *means, Matrix *C, ICAWhitenStats const *stats,
+                     Matrix const *X )
+{
+  unsigned int row, col;
+  NUMTYPE scale;
+
+  if (stats == NULL || stats->num_var != X->rows ||
+      stats->count != X->cols || stats->count < 2) {
+    return 0;
+  }
+
+  memcpy( means, stats->means, sizeof(NUMTYPE) * stats->num_var );
+
+  C->rows = C->cols = stats->num_var;
+  scale = 1.0 / (NUMTYPE) (stats->count - 1);
+  for (col = 0; col < stats->num_var; col++) {
+    for (row = 0; row < stats->num_var; row++) {
+      C->elem[col*C->ld + row] =
+        scale * stats->scatter.elem[col*stats->scatter.ld + row];
+    }
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int whitenMean( Matrix *white_Z, Matrix *whiten, Matrix *dewhiten,
+                         Matrix const *X, NUMTYPE const *means, NUMTYPE *block,
+                         NUMTYPE *eig_vals, unsigned int max_dims,
+                         NUMTYPE variance )
+{
+  unsigned int row, col, start, width, max_width, num_dims;
+  Matrix B, Y, W;
+
+  num_dims  = covarianceWhiten( whiten, dewhiten, eig_vals, max_dims, variance );
+  max_width = (X->rows < WHITEN_BLOCK) ? WHITEN_BLOCK / X->rows : 1;
+
+  // Whiten the observations a block at a time, removing the means from each
+  // block while it is in the cache.
+  white_Z->rows = white_Z->ld = num_dims;
+  for (start = 0; start < X->cols; start += width) {
+    width = X->cols - start;
+    if (width > max_width) { width = max_width; }
+
+    B.elem = X->elem + start*X->ld;
+    B.ld   = X->ld;
+
+    Y.elem = block;
+    Y.rows = Y.ld = X->rows;
+    Y.cols = width;
+    for (col = 0; col < width; col++) {
+      for (row = 0; row < X->rows; row++) {
+        Y.elem[col*Y.ld + row] = B.elem[col*B.ld + row] - means[row];
+      }
+    }
+
+    W.elem = white_Z->elem + start*white_Z->ld;
+    W.rows = W.ld = num_dims;
+    W.cols = width;
+    GEMM( W, *whiten, Y );
+  }
+
+  return num_dims;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void decimate( Matrix *Y, Matrix const *X, unsigned int factor,
+               NUMTYPE *taps )
+{
+  int half, num_taps, row, col, k, src;
+  double x, sum;
+  NUMTYPE tap;
+  NUMTYPE *y;
+  NUMTYPE const *x_col;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Design the filter: sinc(x / factor) / factor, cut off at the new Nyquist
+  // frequency, under a Hamming window, scaled to a gain of one at DC so that
+  // the observation means don't change.
+  //////////////////////////////////////////////////////////////////////////////
+  half     = DECIMATE_ZEROS * factor;
+  num_taps = DECIMATE_TAPS( factor );
+
+  sum = 0.0;
+  for (k = 0; k < num_taps; k++) {
+    x = (double) (k - half) / factor;
+    taps[k] = (k == half) ? 1.0 : sin( M_PI * x ) / (M_PI * x);
+    taps[k] *= 0.54 + 0.46 * cos( M_PI * (k - half) / half );
+    sum += taps[k];
+  }
+  for (k = 0; k < num_taps; k++) {
+    taps[k] /= sum;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Filter around every factor-th observation, adding each tap's column of X
+  // into the decimated column in turn.
+  //////////////////////////////////////////////////////////////////////////////
+  Y->rows = Y->ld  = X->rows;
+  Y->cols = Y->lag = (X->cols + factor - 1) / factor;
+
+  for (col = 0; col < Y->cols; col++) {
+    y = Y->elem + col*Y->ld;
+    memset( y, 0, sizeof(NUMTYPE) * Y->rows );
+
+    for (k = 0; k < num_taps; k++) {
+      src = col*factor + k - half;
+      if (src < 0) { src = 0; }
+      if (src >= X->cols) { src = X->cols - 1; }
+
+      tap   = taps[k];
+      x_col = X->elem + src*X->ld;
+      for (row = 0; row < X->rows; row++) {
+        y[row] += tap * x_col[row];
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void unmixObservations( Matrix *S, NUMTYPE *mu_S, Matrix const *W,
+                        Matrix const *X, NUMTYPE *means )
+{
+  int row, col;
+
+  memset( means, 0, sizeof(NUMTYPE) * X->rows );
+  for (col = 0; col < X->cols; col++) {
+    for (row = 0; row < X->rows; row++) {
+      means[row] += X->elem[col*X->ld + row];
+    }
+  }
+  for (row = 0; row < X->rows; row++) {
+    means[row] /= X->cols;
+  }
+
+  S->rows = W->rows;
+  S->cols = X->cols;
+  GEMV( mu_S, *W, means );
+  GEMM( *S, *W, *X );
+
+  for (col = 0; col < S->cols; col++) {
+    for (row = 0; row < S->rows; row++) {
+      S->elem[col*S->ld + row] -= mu_S[row];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void symDecorrelate( Matrix *B, Matrix const *M, Matrix *T1, Matrix *T2,
+                     NUMTYPE *eig_vals )
+{
+  unsigned int row, col;
+
+  // Find the eigenvalue decomposition of M * M' = E * D * E', storing the
+  // eigenvectors in B until we're done with them. SYEV only reads the upper
+  // triangle, so that's all of M * M' we form.
+  SYRK( *B, *M );
+  SYEV( *B, eig_vals );
+
+  for (row = 0; row < B->rows; row++) {
+    // We need to take the square root of the absolute value here, because it
+    // is possible, thanks to floating point error, than an eigenvalue has
+    // become negative. If we don't use the absolute value, we will get NaN
+    // infecting our data.
+    eig_vals[row] = 1.0 / sqrt( fabs( eig_vals[row] ) );
+  }
+
+  // T1 = D^(-1/2) * E'
+  for (col = 0; col < B->cols; col++) {
+    for (row = 0; row < B->rows; row++) {
+      T1->elem[col * T1->ld + row] = eig_vals[row] *
+                                     B->elem[row * B->ld + col];
+    }
+  }
+
+  GEMM( *T2, *B, *T1 );     // T2 = E * D^(-1/2) * E'
+  GEMM( *B, *T2, *M );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int iterDecorrelate( Matrix *B, Matrix const *M, Matrix *T1, Matrix *T2 )
+{
+  unsigned int row, col;
+  int num_iter;
+  NUMTYPE norm, sum, trace;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Scale M so that its largest singular value is at most one. The 1-norm of
+  // M * M' bounds its largest eigenvalue (the square of M's largest singular
+  // value) from above. Only the upper triangle of M * M' is formed, so the
+  // rest of each column is read from the matching row.
+  //////////////////////////////////////////////////////////////////////////////
+  SYRK( *T1, *M );
+
+  norm = 0.0;
+  for (col = 0; col < M->rows; col++) {
+    sum = 0.0;
+    for (row = 0; row <= col; row++) {
+      sum += fabs( T1->elem[col * T1->ld + row] );
+    }
+    for (; row < M->rows; row++) {
+      sum += fabs( T1->elem[row * T1->ld + col] );
+    }
+    if (sum > norm) { norm = sum; }
+  }
+  norm = (norm > 0.0) ? 1.0 / sqrt( norm ) : 1.0;
+
+  for (col = 0; col < M->cols; col++) {
+    for (row = 0; row < M->rows; row++) {
+      B->elem[col * B->ld + row] = norm * M->elem[col * M->ld + row];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Iterate B = 1.5 * B - 0.5 * B * B' * B, until B * B' is the identity.
+  //////////////////////////////////////////////////////////////////////////////
+  for (num_iter = 0; num_iter < ITER_DECORR_MAX_ITER; num_iter++) {
+    SYRK( *T1, *B );
+
+    // The singular values only ever grow towards one, so the trace of B * B'
+    // (the sum of their squares) tells us how close the farthest one is.
+    trace = 0.0;
+    for (row = 0; row < B->rows; row++) {
+      trace += T1->elem[row * T1->ld + row];
+    }
+    if ((NUMTYPE) B->rows - trace <= ITER_DECORR_EPSILON * B->rows) {
+      break;
+    }
 
-    for (row = 0; row < whiten->rows; row++) {
-      i = col * dewhiten->ld + row;
-      whiten->elem[row*whiten->ld + col] = eig_inv_sqr * dewhiten->elem[i];
-      dewhiten->elem[i]                  = eig_sqr     * dewhiten->elem[i];
+    SYMM( *T2, *T1, *B );
+    for (col = 0; col < B->cols; col++) {
+      for (row = 0; row < B->rows; row++) {
+        B->elem[col * B->ld + row] = 1.5 * B->elem[col * B->ld + row] -
+                                     0.5 * T2->elem[col * T2->ld + row];
+      }
     }
   }
 
-  free( eig_vals );
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void warmRotate( Matrix *Z, Matrix *whiten, Matrix *dewhiten,
+                 Matrix const *W_init, Matrix *R, Matrix *warm, Matrix *temp,
+                 Matrix *T1, Matrix *T2, NUMTYPE *eig_vals )
+{
+  NUMTYPE *tmp;
+
+  GEMM( *warm, *W_init, *dewhiten );
+  symDecorrelate( R, warm, T1, T2, eig_vals );
+
+  GEMM( *warm, *R, *whiten );
+  tmp = whiten->elem; whiten->elem = warm->elem; warm->elem = tmp;
+
+  warm->ld = dewhiten->ld;
+  GEMM_NT( *warm, *dewhiten, *R );
+  tmp = dewhiten->elem; dewhiten->elem = warm->elem; warm->elem = tmp;
+
+  GEMM( *temp, *R, *Z );
+  tmp = Z->elem; Z->elem = temp->elem; temp->elem = tmp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int jointDiagonalize( NUMTYPE *mats, unsigned int num_mats,
+                               Matrix *V, NUMTYPE threshold,
+                               ICAMonitor *mon )
+{
+  // Indexing variables.
+  unsigned int i, row, col, sweeps, modified, stopped;
+  unsigned int p_i, q_i, pp_i, qq_i, pq_i, p, q, cm;
+  unsigned int n = V->rows, num_elem = V->rows * V->rows;
+
+  // Variables used in the calculation of the Jacobi rotation.
+  NUMTYPE on_diag, off_diag, GG_x, GG_z, GG_y, theta, cosine, sine, tmp1, tmp2;
+  NUMTYPE cos_sqr, sin_sqr, max_theta;
+
+  sweeps   = 0;
+  modified = 1;
+  stopped  = 0;
+  while (sweeps < JOINT_DIAG_MAX_SWEEPS && modified && !stopped) {
+    modified  = 0;
+    max_theta = 0.0;
+    sweeps++;
+
+    // Attempt to zero out all off diagonal elements. The matrices are all
+    // symmetric, so we only need to work on either the upper or lower
+    // triangle of the matrices. We arbitrarily choose the upper. If we're told
+    // to stop part way through, V is still a rotation, just not the best one.
+    for (p = 0; p < n - 1 && !stopped; p++) {
+      for (q = p + 1; q < n; q++) {
+        if (mon && monitorStop( mon )) {
+          stopped = 1;
+          break;
+        }
+
+        // The core of this double loop attempts to minimize the p,q'th element
+        // in each matrix. It takes a lot of algebra to explain why
+        // this calculation is valid--too much to put into these comments.
+
+        // Find the sum of the difference between diagonal elements and the sum
+        // of the off diagonal elements (the matrices are symmetric, so we just
+        // multiply the upper off diagonal by two).
+        GG_x = 0.0f;
+        GG_y = 0.0f;
+        GG_z = 0.0f;
+        for (cm = 0; cm < num_mats; cm++) {
+          pp_i = cm * num_elem + p * n + p; // row p, column p
+          qq_i = cm * num_elem + q * n + q; // row q, column q
+          pq_i = cm * num_elem + q * n + p; // row p, column q
+
+          on_diag  = mats[pp_i] - mats[qq_i];
+          off_diag = mats[pq_i] * 2.0;
+          GG_x += on_diag  * on_diag;
+          GG_y += on_diag  * off_diag;
+          GG_z += off_diag * off_diag;
+        }
+
+        on_diag  = GG_x - GG_z;
+        off_diag = GG_y * 2.0;
+
+        // Find the angle of rotation to be performed. It is possible to find
+        // this angle using only multiply/divides, but experiments showed that
+        // timing was roughly the same, so we use atan2() because it's cleaner
+        // code.
+        theta = 0.5 * atan2( off_diag, on_diag +
+                             sqrt(on_diag * on_diag + off_diag * off_diag));
+
+        if (fabs( theta ) > max_theta) { max_theta = fabs( theta ); }
+
+        // Only perform a rotation if it is 'statistically relavent'.
+        if (fabs( theta ) > threshold) {
+          modified = 1;
+          cosine   = cos( theta );
+          sine     = sin( theta );
+
+          //////////////////////////////////////////////////////////////////////
+          // We only need to update the upper triangle of the matrices.
+          //////////////////////////////////////////////////////////////////////
+
+          // For each matrix...
+          for (i = 0; i < num_mats; i++) {
+            // Update the p,q'th, p,p'th, and q,q'th elements.
+            pp_i = p * n + p + num_elem * i; // row p, column p
+            qq_i = q * n + q + num_elem * i; // row q, column q
+            pq_i = q * n + p + num_elem * i; // row p, column q
+
+            cos_sqr = cosine * cosine;
+            sin_sqr =   sine *   sine;
+
+            tmp1 = mats[pp_i];
+            tmp2 =  2.0 * cosine * sine * mats[pq_i];
+
+            mats[pq_i] = (cos_sqr - sin_sqr) * mats[pq_i] +
+                           cosine * sine * (mats[qq_i] - mats[pp_i]);
+            mats[pp_i] = cos_sqr * tmp1 + sin_sqr * mats[qq_i] + tmp2;
+            mats[qq_i] = sin_sqr * tmp1 + cos_sqr * mats[qq_i] - tmp2;
+
+            // Update the elements in columns p and q that are above the p'th
+            // row.
+            for (row = 0; row < p; row++) {
+              p_i = p * n + row + num_elem * i;
+              q_i = q * n + row + num_elem * i;   // Update (example):
+                                                        // * * x * * x *
+              tmp1 = cosine * mats[p_i];              // * * x * * x *
+              tmp2 =  -sine * mats[p_i];              // * * + * * + *
+                                                        // * * * * * * *
+              mats[p_i] = tmp1 +   sine * mats[q_i];// * * * * * * *
+              mats[q_i] = tmp2 + cosine * mats[q_i];// * * * * * + *
+            }                                           // * * * * * * *
+
+            // Update the elements in the p'th row from just to the right of the
+            // diagonal to the q'th column, and update the elements in the q'th
+            // column from just above the diagonal up to the p'th row.
+            for (col = p + 1; col < q; col++) {
+              p_i = col * n +  p  + num_elem * i;
+              q_i = q   * n + col + num_elem * i; // Update (example):
+                                                        // * * + * * + *
+              tmp1 = cosine * mats[p_i];              // * * + * * + *
+              tmp2 =  -sine * mats[p_i];              // * * + x x + *
+                                                        // * * * * * x *
+              mats[p_i] = tmp1 +   sine * mats[q_i];// * * * * * x *
+              mats[q_i] = tmp2 + cosine * mats[q_i];// * * * * * + *
+            }                                           // * * * * * * *
+
+            // In each matrix, update the elements in rows p and q that
+            // are to the right of the q'th column.
+            for (col = q + 1; col < n; col++) {
+              p_i = col * n + p + num_elem * i;
+              q_i = col * n + q + num_elem * i;   // Update (example):
+                                                        // * * + * * + *
+              tmp1 = cosine * mats[p_i];              // * * + * * + *
+              tmp2 =  -sine * mats[p_i];              // * * + + + + x
+                                                        // * * * * * + *
+              mats[p_i] = tmp1 +   sine * mats[q_i];// * * * * * + *
+              mats[q_i] = tmp2 + cosine * mats[q_i];// * * * * * + x
+            }                                           // * * * * * * *
+          }
+
+          //////////////////////////////////////////////////////////////////////
+          // Update the rotation matrix.
+          //////////////////////////////////////////////////////////////////////
+
+          for (row = 0; row < n; row++) {
+            p_i = p * V->ld + row; // row 'row', column p of V matrix
+            q_i = q * V->ld + row; // row 'row', column q of V matrix
+
+            tmp1            = cosine * V->elem[p_i] + sine * V->elem[q_i];
+            V->elem[q_i] = cosine * V->elem[q_i] - sine * V->elem[p_i];
+            V->elem[p_i] = tmp1;
+          }
+        }
+      }
+    }
+
+    if (mon) {
+      monitorPhase( mon, ICA_PHASE_ORTHO );
+      monitorReport( mon, sweeps, max_theta );
+    }
+  }
+
+  if (mon && modified) {
+    monitorMaxIter( mon );
+  }
+
+
+  return sweeps;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned long long monitorClock()
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void monitorStart( ICAMonitor *mon, ICAParams const *params )
+{
+  mon->observer = params->observer;
+  mon->data     = params->observer_data;
+
+  memset( &mon->progress, 0, sizeof(ICAProgress) );
+  mon->progress.implem = params->implem;
+
+  mon->cancel   = params->cancel;
+  mon->deadline = 0;
+  mon->status   = ICA_STATUS_CONVERGED;
+
+  if (mon->observer || params->time_limit > 0.0) {
+    mon->mark = monitorClock();
+  }
+  if (params->time_limit > 0.0) {
+    mon->deadline = mon->mark +
+                    (unsigned long long) (params->time_limit * 1e9);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void monitorPhase( ICAMonitor *mon, ICAPhase phase )
+{
+  unsigned long long now;
+
+  if (mon->observer) {
+    now = monitorClock();
+    mon->progress.ns[phase] += now - mon->mark;
+    mon->mark = now;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void monitorReport( ICAMonitor *mon, unsigned int iter, double metric )
+{
+  if (mon->observer) {
+    mon->progress.iter   = iter;
+    mon->progress.metric = metric;
+    mon->observer( &mon->progress, mon->data );
+    mon->mark = monitorClock();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void monitorFinish( ICAMonitor *mon, unsigned int iter )
+{
+  if (mon->observer) {
+    mon->progress.iter = iter;
+    mon->progress.done = 1;
+    mon->observer( &mon->progress, mon->data );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int monitorStop( ICAMonitor *mon )
+{
+  if (mon->status == ICA_STATUS_CANCELLED ||
+      mon->status == ICA_STATUS_DEADLINE) {
+    return 1;
+  }
+
+  if (mon->cancel && *mon->cancel) {
+    mon->status = ICA_STATUS_CANCELLED;
+  } else if (mon->deadline && monitorClock() >= mon->deadline) {
+    mon->status = ICA_STATUS_DEADLINE;
+  } else {
+    return 0;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void monitorMaxIter( ICAMonitor *mon )
+{
+  if (mon->status == ICA_STATUS_CONVERGED) {
+    mon->status = ICA_STATUS_MAX_ITER;
+  }
 }
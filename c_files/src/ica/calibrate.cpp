@@ -0,0 +1,548 @@
+#include "ica/ica.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// How many observations per variable the calibration runs separate.
+#define CAL_OBS_PER_VAR 500
+
+// Runs that take longer than this many seconds are only timed once, since
+// noise matters less to them than to the short ones.
+#define CAL_LONG_RUN    1.0
+
+// The longest host name a calibration table keeps.
+#define CAL_HOST_LEN    256
+
+/**
+ * A calibration table: the time each choice of implementation and contrast
+ * took to separate observations of each size measured.
+ */
+struct ICACalibration {
+  char host[CAL_HOST_LEN];      // The host the table was measured on.
+  unsigned int num_sizes;       // How many sizes were measured.
+  unsigned int *num_var;        // The variables of each size, in ascending order.
+  unsigned int *num_obs;        // The observations of each size.
+  double *seconds;              // The time of each choice for each size
+                                // (ICA_CAL_CHOICES per size), or a negative
+                                // value if it was left out at that size.
+};
+
+/**
+ * One of the implementations and contrasts that a calibration table times.
+ */
+typedef struct CalChoice {
+  ICA_TYPE     implem;
+  ContrastType contrast;
+  int          use_gpu;
+} CalChoice;
+
+/**
+ * The choices, in the order of the table's columns.
+ */
+static CalChoice const _choices[ICA_CAL_CHOICES] = {
+  {ICA_FASTICA, NONLIN_TANH,  0},
+  {ICA_FASTICA, NONLIN_CUBE,  0},
+  {ICA_FASTICA, NONLIN_GAUSS, 0},
+  {ICA_JADE,    NONLIN_TANH,  0},
+
+  {ICA_FASTICA, NONLIN_TANH,  1},
+  {ICA_FASTICA, NONLIN_CUBE,  1},
+  {ICA_FASTICA, NONLIN_GAUSS, 1},
+  {ICA_JADE,    NONLIN_TANH,  1}
+};
+
+/**
+ * The CPU choices from most to least robust, for spending a latency budget.
+ * JADE has no contrast to get wrong and no iterations that might not converge,
+ * and of the contrasts, cube is the most sensitive to outliers. Each GPU
+ * choice is ICA_CAL_CHOICES / 2 columns after its CPU choice.
+ */
+static unsigned int const _robustness[ICA_CAL_CHOICES / 2] = { 3, 0, 2, 1 };
+
+static ICACalibration *cal_alloc( unsigned int num_sizes );
+static void cal_mix( Matrix *X, Matrix *S, Matrix *A, unsigned int *seed );
+static double cal_time( ICAParams const *params, Matrix *W, Matrix *A,
+                        Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                        unsigned int samples );
+static double cal_predict( ICACalibration const *cal, unsigned int choice,
+                           unsigned int num_var, unsigned int num_obs );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICACalibration *ica_calibrate( ICAParams const *params, unsigned int max_var,
+                               unsigned int samples )
+{
+  ICACalibration *cal;
+  ICAParams run;
+  Matrix X, S, W, A;
+  NUMTYPE *mu_S;
+  unsigned int num_sizes, size, n, c, seed = 1;
+
+  if (max_var == 0) {
+    max_var = DEF_CAL_MAX_VAR;
+  }
+  if (samples == 0) {
+    samples = DEF_CAL_SAMPLES;
+  }
+  if (max_var < 2) {
+    return NULL;
+  }
+
+  // Sizes of 2, 4, 8, ... variables, and then `max_var'.
+  num_sizes = 1;
+  for (n = 2; n < max_var; n *= 2) {
+    num_sizes++;
+  }
+
+  cal = cal_alloc( num_sizes );
+  if (cal == NULL) {
+    return NULL;
+  }
+  if (gethostname( cal->host, CAL_HOST_LEN ) != 0) {
+    strcpy( cal->host, "unknown" );
+  }
+  cal->host[CAL_HOST_LEN - 1] = '\0';
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate room for the largest size. The sources are mixed by A, and
+  // separated into S.
+  //////////////////////////////////////////////////////////////////////////////
+  X.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * max_var * max_var *
+                              CAL_OBS_PER_VAR );
+  S.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * max_var * max_var *
+                              CAL_OBS_PER_VAR );
+  W.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * max_var * max_var );
+  A.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * max_var * max_var );
+  mu_S   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * max_var );
+
+  if (!X.elem || !S.elem || !W.elem || !A.elem || !mu_S) {
+    free( X.elem ); free( S.elem ); free( W.elem ); free( A.elem );
+    free( mu_S );
+    ica_destroyCalibration( cal );
+    return NULL;
+  }
+
+  // Only the settings that change how long each run takes are kept.
+  memcpy( &run, params, sizeof(ICAParams) );
+  run.num_components = DEF_NUM_COMPONENTS;
+  run.seed           = NULL;
+  run.pca_dims       = DEF_PCA_DIMS;
+  run.pca_variance   = DEF_PCA_VARIANCE;
+  run.num_lags       = DEF_NUM_LAGS;
+  run.observer       = NULL;
+  run.observer_data  = NULL;
+  run.cancel         = NULL;
+  run.time_limit     = DEF_TIME_LIMIT;
+  run.decimate       = DEF_DECIMATE;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Time every choice on each size.
+  //////////////////////////////////////////////////////////////////////////////
+  for (size = 0, n = 2; size < num_sizes; size++, n *= 2) {
+    if (size == num_sizes - 1) {
+      n = max_var;
+    }
+
+    cal->num_var[size] = n;
+    cal->num_obs[size] = n * CAL_OBS_PER_VAR;
+
+    X.rows = X.ld = S.rows = S.ld = n;
+    X.cols = X.lag = S.cols = S.lag = n * CAL_OBS_PER_VAR;
+    W.rows = W.cols = W.ld = W.lag = n;
+    A.rows = A.cols = A.ld = A.lag = n;
+
+    cal_mix( &X, &S, &A, &seed );
+
+    for (c = 0; c < ICA_CAL_CHOICES; c++) {
+      cal->seconds[size * ICA_CAL_CHOICES + c] = -1.0;
+
+#ifndef ENABLE_GPU
+      if (_choices[c].use_gpu) {
+        continue;
+      }
+#endif
+      if (_choices[c].use_gpu && !params->use_gpu) {
+        continue;
+      }
+
+      run.implem   = _choices[c].implem;
+      run.contrast = _choices[c].contrast;
+      run.use_gpu  = _choices[c].use_gpu;
+      run.num_var  = X.rows;
+      run.num_obs  = X.cols;
+
+      cal->seconds[size * ICA_CAL_CHOICES + c] =
+        cal_time( &run, &W, &A, &S, mu_S, &X, samples );
+    }
+  }
+
+  free( X.elem ); free( S.elem ); free( W.elem ); free( A.elem );
+  free( mu_S );
+
+  return cal;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_saveCalibration( ICACalibration const *cal, char const *file_name )
+{
+  FILE *file = fopen( file_name, "w" );
+  unsigned int size, c;
+
+  if (file == NULL) {
+    return 0;
+  }
+
+  // A header naming the host, then one line per size: the size, followed by
+  // the time of each choice.
+  fprintf( file, "ica_calibration 1\n" );
+  fprintf( file, "host %s\n", cal->host );
+  fprintf( file, "sizes %u\n", cal->num_sizes );
+
+  for (size = 0; size < cal->num_sizes; size++) {
+    fprintf( file, "%u %u", cal->num_var[size], cal->num_obs[size] );
+    for (c = 0; c < ICA_CAL_CHOICES; c++) {
+      fprintf( file, " %.9g", cal->seconds[size * ICA_CAL_CHOICES + c] );
+    }
+    fprintf( file, "\n" );
+  }
+
+  return fclose( file ) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICACalibration *ica_loadCalibration( char const *file_name )
+{
+  FILE *file = fopen( file_name, "r" );
+  ICACalibration *cal = NULL;
+  char host[CAL_HOST_LEN], this_host[CAL_HOST_LEN];
+  unsigned int version, num_sizes, size, c;
+  int ok;
+
+  if (file == NULL) {
+    return NULL;
+  }
+
+  // The host name is read up to the end of its line, so that it can't
+  // overflow `host'.
+  ok = fscanf( file, "ica_calibration %u\n", &version ) == 1 && version == 1 &&
+       fscanf( file, "host %255[^\n]\n", host ) == 1 &&
+       fscanf( file, "sizes %u", &num_sizes ) == 1 && num_sizes > 0;
+
+  if (ok) {
+    if (gethostname( this_host, CAL_HOST_LEN ) != 0) {
+      strcpy( this_host, "unknown" );
+    }
+    this_host[CAL_HOST_LEN - 1] = '\0';
+
+    ok = (strcmp( host, this_host ) == 0);
+  }
+
+  if (ok) {
+    cal = cal_alloc( num_sizes );
+    ok  = (cal != NULL);
+  }
+
+  for (size = 0; ok && size < num_sizes; size++) {
+    ok = fscanf( file, "%u %u", &(cal->num_var[size]),
+                 &(cal->num_obs[size]) ) == 2 &&
+         cal->num_var[size] > 0 && cal->num_obs[size] > 0 &&
+         (size == 0 || cal->num_var[size] > cal->num_var[size - 1]);
+
+    for (c = 0; ok && c < ICA_CAL_CHOICES; c++) {
+      ok = fscanf( file, "%lf", &(cal->seconds[size * ICA_CAL_CHOICES + c]) )
+           == 1;
+    }
+  }
+
+  fclose( file );
+
+  if (!ok) {
+    ica_destroyCalibration( cal );
+    return NULL;
+  }
+
+  strcpy( cal->host, host );
+  return cal;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_choose( ICACalibration const *cal, ICAParams *params,
+                double *seconds )
+{
+  double predicted[ICA_CAL_CHOICES];
+  unsigned int c, gpu_c, best = ICA_CAL_CHOICES;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Predict how long each choice would take, leaving out the GPU unless it is
+  // allowed.
+  //////////////////////////////////////////////////////////////////////////////
+  for (c = 0; c < ICA_CAL_CHOICES; c++) {
+    predicted[c] = -1.0;
+    if (!_choices[c].use_gpu || params->use_gpu) {
+      predicted[c] = cal_predict( cal, c, params->num_var, params->num_obs );
+    }
+  }
+
+  // The most robust choice predicted to finish within the budget, on whichever
+  // of the CPU or GPU is faster.
+  if (params->time_limit > 0.0) {
+    for (c = 0; c < ICA_CAL_CHOICES / 2 && best == ICA_CAL_CHOICES; c++) {
+      gpu_c = _robustness[c] + ICA_CAL_CHOICES / 2;
+
+      if (predicted[_robustness[c]] >= 0.0 &&
+          predicted[_robustness[c]] <= params->time_limit) {
+        best = _robustness[c];
+      }
+      if (predicted[gpu_c] >= 0.0 && predicted[gpu_c] <= params->time_limit &&
+          (best == ICA_CAL_CHOICES || predicted[gpu_c] < predicted[best])) {
+        best = gpu_c;
+      }
+    }
+  }
+
+  // Otherwise, the fastest.
+  if (best == ICA_CAL_CHOICES) {
+    for (c = 0; c < ICA_CAL_CHOICES; c++) {
+      if (predicted[c] >= 0.0 &&
+          (best == ICA_CAL_CHOICES || predicted[c] < predicted[best])) {
+        best = c;
+      }
+    }
+  }
+
+  if (best == ICA_CAL_CHOICES) {
+    return 0;
+  }
+
+  params->implem   = _choices[best].implem;
+  params->contrast = _choices[best].contrast;
+  params->use_gpu  = _choices[best].use_gpu;
+
+  if (seconds) {
+    *seconds = predicted[best];
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_destroyCalibration( ICACalibration *cal )
+{
+  if (cal == NULL) {
+    return;
+  }
+
+  free( cal->num_var );
+  free( cal->num_obs );
+  free( cal->seconds );
+  free( cal );
+}
+
+/**
+ * Name: cal_alloc
+ *
+ * Description:
+ * Allocates a calibration table with room for the given number of sizes.
+ *
+ * Parameters:
+ * @param num_sizes     how many sizes the table has
+ *
+ * Returns:
+ * @return ICACalibration*  the table, or NULL if there was a problem
+ */
+static ICACalibration *cal_alloc( unsigned int num_sizes )
+{
+  ICACalibration *cal = (ICACalibration*) calloc( 1, sizeof(ICACalibration) );
+
+  if (cal == NULL) {
+    return NULL;
+  }
+
+  cal->num_sizes = num_sizes;
+  cal->num_var   = (unsigned int*) malloc( sizeof(unsigned int) * num_sizes );
+  cal->num_obs   = (unsigned int*) malloc( sizeof(unsigned int) * num_sizes );
+  cal->seconds   = (double*) malloc( sizeof(double) * num_sizes *
+                                     ICA_CAL_CHOICES );
+
+  if (!cal->num_var || !cal->num_obs || !cal->seconds) {
+    ica_destroyCalibration( cal );
+    return NULL;
+  }
+
+  return cal;
+}
+
+/**
+ * Name: cal_mix
+ *
+ * Description:
+ * Fills X with a random mixture of as many sources as it has rows, half of
+ * them Laplacian (super-Gaussian, like the artifacts in EEG) and half uniform
+ * (sub-Gaussian), with unit variance. The runs being timed then converge the
+ * way they would on real recordings, rather than running to the iteration
+ * limit as they would on Gaussian noise.
+ *
+ * Parameters:
+ * @param X             where to store the observations
+ * @param S             scratch space for the sources (the size of X)
+ * @param A             scratch space for the mixing matrix
+ * @param seed          the state of the random number generator
+ */
+static void cal_mix( Matrix *X, Matrix *S, Matrix *A, unsigned int *seed )
+{
+  int row, col;
+  double u, v;
+
+  for (col = 0; col < S->cols; col++) {
+    for (row = 0; row < S->rows; row++) {
+      u = (rand_r( seed ) + 1.0) / (RAND_MAX + 2.0);
+      if (row % 2 == 0) {
+        // The difference of two exponentials is Laplacian, with a variance
+        // of 2.
+        v = (rand_r( seed ) + 1.0) / (RAND_MAX + 2.0);
+        S->elem[col * S->ld + row] = log( u / v ) * M_SQRT1_2;
+      } else {
+        S->elem[col * S->ld + row] = sqrt( 3.0 ) * (2.0 * u - 1.0);
+      }
+    }
+  }
+
+  // A well-conditioned mixing matrix: the identity plus some mixing.
+  for (col = 0; col < A->cols; col++) {
+    for (row = 0; row < A->rows; row++) {
+      A->elem[col * A->ld + row] = (row == col) +
+        0.5 * (2.0 * rand_r( seed ) / RAND_MAX - 1.0);
+    }
+  }
+
+  GEMM( *X, *A, *S );
+}
+
+/**
+ * Name: cal_time
+ *
+ * Description:
+ * Times a choice of implementation separating the given observations, in a
+ * context of its own.
+ *
+ * Parameters:
+ * @param params        the parameters of the runs
+ * @param W             where to store the unmixing matrix
+ * @param A             where to store the mixing matrix
+ * @param S             where to store the source signals
+ * @param mu_S          where to store the source means
+ * @param X             the observations
+ * @param samples       how many times to run (once, if a run is long)
+ *
+ * Returns:
+ * @return double       the fastest run, in seconds, or -1 if a run failed or
+ *                      didn't converge
+ */
+static double cal_time( ICAParams const *params, Matrix *W, Matrix *A,
+                        Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                        unsigned int samples )
+{
+  ICAContext *ctx = ica_create( params );
+  struct timespec start, stop;
+  double elapsed, best = -1.0;
+  unsigned int i;
+
+  if (ctx == NULL) {
+    return -1.0;
+  }
+
+  for (i = 0; i < samples; i++) {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    ica_run( ctx, W, A, S, mu_S, X, NULL );
+    clock_gettime( CLOCK_MONOTONIC, &stop );
+
+    if (ica_status( ctx ) != ICA_STATUS_CONVERGED) {
+      best = -1.0;
+      break;
+    }
+
+    elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec -
+                                                     start.tv_nsec);
+    if (best < 0.0 || elapsed < best) {
+      best = elapsed;
+    }
+    if (elapsed > CAL_LONG_RUN) {
+      break;
+    }
+  }
+
+  ica_destroy( ctx );
+  return best;
+}
+
+/**
+ * Name: cal_predict
+ *
+ * Description:
+ * Predicts how long a choice takes to separate observations of the given size.
+ * The cost of every implementation grows linearly with the number of
+ * observations (the JADE rotations and the FastICA decorrelation don't, but
+ * they are the smaller part at the sizes ICA is used for), and polynomially
+ * with the number of variables, so the time per observation is interpolated
+ * linearly on a log-log scale between the two nearest sizes measured.
+ *
+ * Parameters:
+ * @param cal           the calibration table
+ * @param choice        which column of the table to predict from
+ * @param num_var       the number of variables
+ * @param num_obs       the number of observations
+ *
+ * Returns:
+ * @return double       the predicted time, in seconds, or -1 if the choice
+ *                      was left out at every size
+ */
+static double cal_predict( ICACalibration const *cal, unsigned int choice,
+                           unsigned int num_var, unsigned int num_obs )
+{
+  double x[2], y[2], t;
+  unsigned int size, found = 0;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the two measured sizes to interpolate (or extrapolate) between: the
+  // nearest below and above `num_var' if there are both, or else the nearest
+  // two on the side there is.
+  //////////////////////////////////////////////////////////////////////////////
+  for (size = 0; size < cal->num_sizes; size++) {
+    t = cal->seconds[size * ICA_CAL_CHOICES + choice];
+    if (t <= 0.0) {
+      continue;
+    }
+
+    // Keep the last two sizes seen until one at or above num_var has been
+    // added to them.
+    if (found == 2) {
+      if (x[1] >= log( (double) num_var )) {
+        break;
+      }
+      x[0] = x[1]; y[0] = y[1];
+      found = 1;
+    }
+
+    x[found] = log( (double) cal->num_var[size] );
+    y[found] = log( t / cal->num_obs[size] );
+    found++;
+  }
+
+  if (found == 0) {
+    return -1.0;
+  }
+  if (found == 1 || x[1] == x[0]) {
+    return exp( y[0] ) * num_obs;
+  }
+
+  t = y[0] + (y[1] - y[0]) * (log( (double) num_var ) - x[0]) / (x[1] - x[0]);
+  return exp( t ) * num_obs;
+}
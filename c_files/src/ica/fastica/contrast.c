@@ -1,377 +1,406 @@
 #include "ica/fastica/contrast.h"
+#include "ica/thread_pool.h"
+#include "ica/vmath.h"
 
 #include <math.h>
+#include <string.h>
 #include <stdlib.h>
-#include <pthread.h>
-
-#ifdef MULTITHREAD_CONTRAST
-  typedef struct TanhThreadData {
-    NUMTYPE *array;
-    int length;
-  } TanhThreadData;
-
-  typedef struct CubeThreadData {
-    NUMTYPE *wz_sqr;
-    NUMTYPE *wz_cube;
-    int length;
-  } CubeThreadData;
-
-  typedef struct GaussThreadData {
-    NUMTYPE *wz;
-    NUMTYPE *wz_sqr;
-    NUMTYPE *wz_expo;
-    int length;
-  } GaussThreadData;
-
-  void *thr_tanh( void *data );
-  void *thr_tanh_sqr( void *data );
-  void *thr_cube( void *data );
-  void *thr_gauss( void *data );
-#endif
+
+// Tiles are always a multiple of this many columns wide.
+#define TILE_ALIGN    16
+
+/**
+ * Data shared by all of the thread pool tasks run by tiledContrast(). Each task
+ * works on its own contiguous range of tiles and accumulates its results into
+ * its own slice of the workspace's partial result arrays.
+ */
+typedef struct TileThreadData {
+  Matrix const *W;            // The current guess at the unmixing matrix.
+  Matrix const *Z;            // The whitened observations.
+  NonlinFunc    nonlin;       // The nonlinearity to apply.
+  void         *nonlin_data;  // Data passed to the nonlinearity.
+  unsigned int  num_stats;    // Number of statistics per row.
+  int           num_tiles;    // Total number of tiles.
+  ContrastWork *work;         // Where the per-task buffers live.
+} TileThreadData;
+
+static void thr_tiles( void *data, unsigned int task, unsigned int num_tasks );
+static int tileCols( int num_var );
+static size_t workLayout( int num_var, int num_obs, unsigned int num_stats,
+                          size_t max_bytes, int *tile_cols,
+                          unsigned int *num_tasks );
+
+static void nonlin_tanh( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                         void *data );
+static void nonlin_cube( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                         void *data );
+static void nonlin_gauss( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                          void *data );
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void negent_tanh( Matrix *W_next, Matrix *W, Matrix *Z )
+void negent_tanh( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work )
 {
-  int row, col, i;
-  Matrix hyp_tan;
-
-  // Initialize our variables.
-  hyp_tan.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  hyp_tan.rows = hyp_tan.ld = Z->rows;
-  hyp_tan.cols = hyp_tan.lag = Z->cols;
-
-  // Find the tanh() of W * Z.
-  GEMM( hyp_tan, *W, *Z );
-
-#ifdef MULTITHREAD_CONTRAST
-  // Threading variables.
-  pthread_attr_t attr;
-  TanhThreadData tdata[NUM_THREADS - 1];
-  pthread_t      thread_ids[NUM_THREADS - 1];
-  int            block_length;
+  // Find tanh(W * Z) * Z' and the row sums of the derivative of tanh(), which
+  // is 1 - tanh^2(), and then put everything together.
+  tiledContrast( W_next, work->sums, 1, W, Z, nonlin_tanh, NULL, work );
+  contrast_applyRule( W_next, W, work->sums, Z->cols );
+}
 
-  pthread_attr_init( &attr );
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void negent_cube( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work )
+{
+  // Find (W * Z)^3 * Z' and the row sums of 3 * (W * Z)^2.
+  tiledContrast( W_next, work->sums, 1, W, Z, nonlin_cube, NULL, work );
+  contrast_applyRule( W_next, W, work->sums, Z->cols );
+}
 
-  block_length = (hyp_tan.rows * hyp_tan.cols) / NUM_THREADS;
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void negent_gauss( Matrix *W_next, Matrix *W, Matrix *Z, ContrastWork *work )
+{
+  // Find (W * Z) * exp(-(W * Z)^2 / 2) * Z' and the row sums of
+  // (1 - (W * Z)^2) * exp(-(W * Z)^2 / 2).
+  tiledContrast( W_next, work->sums, 1, W, Z, nonlin_gauss, NULL, work );
+  contrast_applyRule( W_next, W, work->sums, Z->cols );
+}
 
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    tdata[i].array  = hyp_tan.elem + i * block_length;
-    tdata[i].length = block_length;
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+NonlinFunc contrast_nonlin( ContrastType type )
+{
+  switch (type) {
+    case NONLIN_CUBE:
+      return nonlin_cube;
+    case NONLIN_GAUSS:
+      return nonlin_gauss;
+    case NONLIN_TANH:
+    default:
+      return nonlin_tanh;
   }
+}
 
-  // Multithread the calculation of the tanh().
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_create( &thread_ids[i], &attr, thr_tanh, (void*) &tdata[i] );
-  }
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void contrast_applyRule( Matrix *W_next, Matrix const *W,
+                         NUMTYPE const *dg_sum, int num_obs )
+{
+  int row, col, i;
 
-  for (i = (NUM_THREADS-1)*block_length; i < hyp_tan.cols * hyp_tan.rows; i++) {
-    hyp_tan.elem[i] = tanh( hyp_tan.elem[i] );
+  // W_next holds E{z * g(w' * z)} (unscaled), and dg_sum holds E{g`(w' * z)}
+  // (also unscaled), so put everything together.
+  for (col = 0; col < W_next->cols; col++) {
+    for (row = 0; row < W_next->rows; row++) {
+      i = col * W_next->rows + row;
+      W_next->elem[i] = (W_next->elem[i] - dg_sum[row] * W->elem[i]) / num_obs;
+    }
   }
+}
 
-  // Wait for threads to complete.
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_join( thread_ids[i], NULL );
-  }
-#else
-  for (i = 0; i < hyp_tan.cols * hyp_tan.rows; i++) {
-    hyp_tan.elem[i] = tanh( hyp_tan.elem[i] );
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int tileCols( int num_var )
+{
+  int tile_cols;
+
+  // Figure out how wide a tile can be while the tile of Z and the tile of W * Z
+  // both stay in cache.
+  tile_cols = TILE_BYTES / (sizeof(NUMTYPE) * 2 * num_var);
+  tile_cols = (tile_cols / TILE_ALIGN) * TILE_ALIGN;
+  if (tile_cols < TILE_ALIGN) {
+    tile_cols = TILE_ALIGN;
   }
-#endif
 
-  GEMM_NT( *W_next, hyp_tan, *Z );
+  return tile_cols;
+}
 
-  // Convert the tanh() values into values of the derivative of tanh(). The
-  // derivative of tanh() is 1 - tanh^2().
-#ifdef MULTITHREAD_CONTRAST
-  // We can reuse the threading variables exactly as they were created before.
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_create( &thread_ids[i], &attr, thr_tanh_sqr, (void*) &tdata[i] );
-  }
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static size_t workLayout( int num_var, int num_obs, unsigned int num_stats,
+                          size_t max_bytes, int *tile_cols,
+                          unsigned int *num_tasks )
+{
+  int num_tiles;
+  size_t shared, per_task, per_col;
 
-  for (i = (NUM_THREADS-1)*block_length; i < hyp_tan.cols * hyp_tan.rows; i++) {
-    hyp_tan.elem[i] = 1.0 - hyp_tan.elem[i] * hyp_tan.elem[i];
-  }
+  //////////////////////////////////////////////////////////////////////////////
+  // Figure out how wide a tile can be while the tile of Z and the tile of W * Z
+  // both stay in cache, and how many tasks the tiles can be split between.
+  //////////////////////////////////////////////////////////////////////////////
+  *tile_cols = tileCols( num_var );
+  num_tiles  = (num_obs + *tile_cols - 1) / *tile_cols;
 
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_join( thread_ids[i], NULL );
+  *num_tasks = tpool_numThreads();
+  if (*num_tasks > num_tiles) {
+    *num_tasks = (num_tiles > 0 ? num_tiles : 1);
   }
 
-  pthread_attr_destroy( &attr );
-#else
-  for (i = 0; i < hyp_tan.cols * hyp_tan.rows; i++) {
-    hyp_tan.elem[i] = 1.0 - hyp_tan.elem[i] * hyp_tan.elem[i];
-  }
-#endif
+  // Each task has a tile and a scratch tile, its own partial g(W * Z) * Z'
+  // product and statistics, and the summed statistics are shared.
+  shared   = sizeof(NUMTYPE) * num_stats * num_var;
+  per_task = sizeof(NUMTYPE) * (num_var * num_var + num_stats * num_var);
+  per_col  = sizeof(NUMTYPE) * 2 * num_var;
 
-  // Sum the rows of this new matrix (in preparation of finding their average).
-  for (col = 1; col < hyp_tan.cols; col++) {
-    for (row = 0; row < hyp_tan.rows; row++) {
-      hyp_tan.elem[row] += hyp_tan.elem[col*hyp_tan.rows + row];
+  //////////////////////////////////////////////////////////////////////////////
+  // If that doesn't fit in `max_bytes', narrow the tiles, and if even the
+  // narrowest tiles don't fit, use fewer tasks.
+  //////////////////////////////////////////////////////////////////////////////
+  if (max_bytes > 0 &&
+      shared + *num_tasks * (per_task + *tile_cols * per_col) > max_bytes) {
+    if (max_bytes < shared + per_task + TILE_ALIGN * per_col) {
+      return 0;
     }
-  }
 
-  // Put everything together.
-  for (col = 0; col < W_next->cols; col++) {
-    for (row = 0; row < W_next->rows; row++) {
-      i = col * W_next->rows + row;
-      W_next->elem[i] = (W_next->elem[i] -
-                         hyp_tan.elem[row] * W->elem[i]) / Z->cols;
+    if (max_bytes - shared < *num_tasks * (per_task + TILE_ALIGN * per_col)) {
+      *tile_cols = TILE_ALIGN;
+      *num_tasks = (max_bytes - shared) / (per_task + TILE_ALIGN * per_col);
+    } else {
+      *tile_cols = ((max_bytes - shared) / *num_tasks - per_task) / per_col;
+      *tile_cols = (*tile_cols / TILE_ALIGN) * TILE_ALIGN;
     }
   }
 
-  // Free the space we allocated.
-  free( hyp_tan.elem );
+  return shared + *num_tasks * (per_task + *tile_cols * per_col);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void negent_cube( Matrix *W_next, Matrix *W, Matrix *Z )
+size_t contrast_workSize( int num_var, int num_obs, unsigned int num_stats,
+                          size_t max_bytes )
 {
-  int row, col, i;
+  int tile_cols;
+  unsigned int num_tasks;
 
-  Matrix WZ_cubed;
-  Matrix WZ_squared;
+  return workLayout( num_var, num_obs, num_stats, max_bytes, &tile_cols,
+                     &num_tasks );
+}
 
-  // Initialize our matrices.
-  WZ_cubed.elem   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  WZ_squared.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  WZ_squared.rows = WZ_cubed.rows = WZ_squared.ld = WZ_cubed.ld = Z->rows;
-  WZ_squared.cols = WZ_cubed.cols = Z->cols;
-  WZ_squared.lag  = WZ_cubed.lag  = Z->cols;
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int contrast_initWork( ContrastWork *work, int num_var, int num_obs,
+                       unsigned int num_stats, size_t max_bytes )
+{
+  memset( work, 0, sizeof(ContrastWork) );
+  if (!workLayout( num_var, num_obs, num_stats, max_bytes, &work->tile_cols,
+                   &work->num_tasks )) {
+    return 0;
+  }
 
-  GEMM( WZ_cubed, *W, *Z );
+  work->num_stats = num_stats;
+  work->num_var   = num_var;
+  work->num_obs   = num_obs;
 
-  // Compute the square and cube of each element in W * Z. We do not use the
-  // pow() function here because it NUMTYPEs the runtime of the ica() algorithm.
-#ifndef MULTITHREAD_CONTRAST
-  for (i = 0; i < WZ_cubed.rows * WZ_cubed.cols; i++) {
-    WZ_squared.elem[i] = 3.0 * (WZ_cubed.elem[i] * WZ_cubed.elem[i]);
-    WZ_cubed.elem[i] = WZ_cubed.elem[i] * WZ_cubed.elem[i] * WZ_cubed.elem[i];
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate memory.
+  //////////////////////////////////////////////////////////////////////////////
+  work->tiles = (NUMTYPE*) malloc( sizeof(NUMTYPE) * work->num_tasks *
+                                   num_var * work->tile_cols );
+  work->scratch = (NUMTYPE*) malloc( sizeof(NUMTYPE) * work->num_tasks *
+                                     num_var * work->tile_cols );
+  work->GZ    = (NUMTYPE*) malloc( sizeof(NUMTYPE) * work->num_tasks *
+                                   num_var * num_var );
+  work->stats = (NUMTYPE*) malloc( sizeof(NUMTYPE) * work->num_tasks *
+                                   num_stats * num_var );
+  work->sums  = (NUMTYPE*) malloc( sizeof(NUMTYPE) * num_stats * num_var );
+
+  if (!work->tiles || !work->scratch || !work->GZ || !work->stats || !work->sums) {
+    contrast_freeWork( work );
+    return 0;
   }
-#else
-  // Threading variables.
-  pthread_attr_t attr;
-  CubeThreadData cdata[NUM_THREADS - 1];
-  pthread_t      thread_ids[NUM_THREADS - 1];
-  int            block_length;
 
-  pthread_attr_init( &attr );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void contrast_freeWork( ContrastWork *work )
+{
+  free( work->tiles ); work->tiles = NULL;
+  free( work->scratch ); work->scratch = NULL;
+  free( work->GZ );    work->GZ    = NULL;
+  free( work->stats ); work->stats = NULL;
+  free( work->sums );  work->sums  = NULL;
+
+  work->num_tasks = work->num_stats = 0;
+  work->tile_cols = work->num_var = work->num_obs = 0;
+}
 
-  block_length = (WZ_cubed.rows * WZ_cubed.cols) / NUM_THREADS;
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void tiledContrast( Matrix *GZ, NUMTYPE *stats, unsigned int num_stats,
+                    Matrix const *W, Matrix const *Z, NonlinFunc nonlin,
+                    void *data, ContrastWork *work )
+{
+  unsigned int task, num_tasks, i;
+  int gz_size, stats_size, row, col;
+  TileThreadData tdata;
 
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    cdata[i].wz_sqr  = WZ_squared.elem + i * block_length;
-    cdata[i].wz_cube = WZ_cubed.elem   + i * block_length;
-    cdata[i].length  = block_length;
-  }
+  //////////////////////////////////////////////////////////////////////////////
+  // Split the tiles between as many tasks as the workspace has room for.
+  //////////////////////////////////////////////////////////////////////////////
+  tdata.num_tiles = (Z->cols + work->tile_cols - 1) / work->tile_cols;
 
-  // Multithread the calculation of the tanh().
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_create( &thread_ids[i], &attr, thr_cube, (void*) &cdata[i] );
+  num_tasks = tpool_numThreads();
+  if (num_tasks > work->num_tasks) {
+    num_tasks = work->num_tasks;
   }
-
-  for (i=(NUM_THREADS-1)*block_length; i < WZ_cubed.rows * WZ_cubed.cols; i++) {
-    WZ_squared.elem[i] = 3.0 * (WZ_cubed.elem[i] * WZ_cubed.elem[i]);
-    WZ_cubed.elem[i] = WZ_cubed.elem[i] * WZ_cubed.elem[i] * WZ_cubed.elem[i];
+  if (num_tasks > tdata.num_tiles) {
+    num_tasks = tdata.num_tiles;
   }
 
-  // Wait for threads to complete.
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_join( thread_ids[i], NULL );
-  }
+  gz_size    = W->rows * Z->rows;
+  stats_size = num_stats * W->rows;
 
-  pthread_attr_destroy( &attr );
-#endif
+  tdata.W           = W;
+  tdata.Z           = Z;
+  tdata.nonlin      = nonlin;
+  tdata.nonlin_data = data;
+  tdata.num_stats   = num_stats;
+  tdata.work        = work;
 
-  GEMM_NT( *W_next, WZ_cubed, *Z );
+  //////////////////////////////////////////////////////////////////////////////
+  // Process the tiles, and then sum each task's partial results.
+  //////////////////////////////////////////////////////////////////////////////
+  tpool_run( thr_tiles, &tdata, num_tasks );
 
-  // Find the sum of the squared element rows (in preparation of finding their
-  // mean).
-  for (col = 1; col < WZ_squared.cols; col++) {
-    for (row = 0; row < WZ_squared.rows; row++) {
-      WZ_squared.elem[row] += WZ_squared.elem[col * WZ_squared.rows + row];
+  for (col = 0; col < Z->rows; col++) {
+    for (row = 0; row < W->rows; row++) {
+      GZ->elem[col * GZ->ld + row] = work->GZ[col * W->rows + row];
     }
   }
+  memcpy( stats, work->stats, sizeof(NUMTYPE) * stats_size );
+
+  for (task = 1; task < num_tasks; task++) {
+    for (col = 0; col < Z->rows; col++) {
+      for (row = 0; row < W->rows; row++) {
+        GZ->elem[col * GZ->ld + row] +=
+                               work->GZ[task * gz_size + col * W->rows + row];
+      }
+    }
 
-  // Put everything together.
-  for (col = 0; col < W_next->cols; col++) {
-    for (row = 0; row < W_next->rows; row++) {
-      i = col * W_next->rows + row;
-      W_next->elem[i] = (W_next->elem[i] -
-                         WZ_squared.elem[row] * W->elem[i]) / Z->cols;
+    for (i = 0; i < stats_size; i++) {
+      stats[i] += work->stats[task * stats_size + i];
     }
   }
-
-  // Free the memory that we allocated.
-  free( WZ_cubed.elem );
-  free( WZ_squared.elem );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void negent_gauss( Matrix *W_next, Matrix *W, Matrix *Z )
+static void thr_tiles( void *data, unsigned int task, unsigned int num_tasks )
 {
-  int row, col, i;
-  Matrix WZ, WZ_sqr, WZ_expo;
-
-  // Initialize our matrices.
-  WZ_expo.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  WZ_sqr.elem  = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  WZ.elem      = (NUMTYPE*) malloc( sizeof(NUMTYPE) * Z->rows * Z->cols );
-  WZ_expo.rows = WZ_sqr.rows = WZ.rows = Z->rows;
-  WZ_expo.ld   = WZ_sqr.ld   = WZ.ld   = Z->ld;
-  WZ_expo.cols = WZ_sqr.cols = WZ.cols = Z->cols;
-  WZ_expo.lag  = WZ_sqr.lag  = WZ.lag  = Z->cols;
-
-  GEMM( WZ, *W, *Z );
-
-#ifndef MULTITHREAD_CONTRAST
-  // Compute the square and exp( -square / 2 ) of each element in W*Z and then
-  // compute the element-wise product of WZ and WZ_expo and the element-wise
-  // product of (1 - (W*Z)^2) and WZ_expo.
-  for (i = 0; i < WZ.rows * WZ.cols; i++) {
-    WZ_sqr.elem[i]  = WZ.elem[i] * WZ.elem[i];
-    WZ_expo.elem[i] = exp( -WZ_sqr.elem[i] / 2.0 );
-    WZ.elem[i]      = WZ.elem[i] * WZ_expo.elem[i];
-    WZ_expo.elem[i] = (1.0 - WZ_sqr.elem[i]) * WZ_expo.elem[i];
-  }
-#else
-  // Do the same thing as the above couple blocks, but use threads for all those
-  // independent calculations.
-  pthread_attr_t  attr;
-  GaussThreadData gdata[NUM_THREADS - 1];
-  pthread_t       thread_ids[NUM_THREADS - 1];
-  int             block_length;
-
-  pthread_attr_init( &attr );
-
-  block_length = (WZ.rows * WZ.cols) / NUM_THREADS;
-
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    gdata[i].wz      = WZ.elem      + i * block_length;
-    gdata[i].wz_sqr  = WZ_sqr.elem  + i * block_length;
-    gdata[i].wz_expo = WZ_expo.elem + i * block_length;
-    gdata[i].length  = block_length;
-  }
+  TileThreadData *d = (TileThreadData*) data;
+  ContrastWork *work = d->work;
+  Matrix Y, Z_tile, GZ;
+  NUMTYPE *stats, *scratch;
+  int tile, first, last;
+
+  // Find the range of tiles this task is responsible for.
+  first = (d->num_tiles * task) / num_tasks;
+  last  = (d->num_tiles * (task + 1)) / num_tasks;
+
+  // Setup this task's slices of the workspace.
+  GZ.rows = GZ.ld = d->W->rows;
+  GZ.cols = GZ.lag = d->Z->rows;
+  GZ.elem = work->GZ + task * GZ.rows * GZ.cols;
+
+  stats = work->stats + task * d->num_stats * d->W->rows;
+  memset( stats, 0, sizeof(NUMTYPE) * d->num_stats * d->W->rows );
+
+  Y.rows = Y.ld = d->W->rows;
+  Y.elem  = work->tiles   + task * d->W->rows * work->tile_cols;
+  scratch = work->scratch + task * d->W->rows * work->tile_cols;
+
+  Z_tile.rows = d->Z->rows;
+  Z_tile.ld   = d->Z->ld;
+
+  for (tile = first; tile < last; tile++) {
+    // Point Z_tile at the columns of Z in this tile (the last tile may be
+    // narrower than the rest).
+    Z_tile.elem = d->Z->elem + tile * work->tile_cols * d->Z->ld;
+    Z_tile.cols = Z_tile.lag = work->tile_cols;
+    if ((tile + 1) * work->tile_cols > d->Z->cols) {
+      Z_tile.cols = Z_tile.lag = d->Z->cols - tile * work->tile_cols;
+    }
+    Y.cols = Y.lag = Z_tile.cols;
 
-  // Multithread the calculation of the tanh().
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_create( &thread_ids[i], &attr, thr_gauss, (void*) &gdata[i] );
-  }
+    // Y = g(W * Z_tile), accumulating the nonlinearity's statistics, and then
+    // GZ += Y * Z_tile' while the tile of Z is still in cache.
+    GEMM( Y, *(d->W), Z_tile );
+    d->nonlin( &Y, stats, scratch, d->nonlin_data );
 
-  for (i = (NUM_THREADS-1)*block_length; i < WZ.rows * WZ.cols; i++) {
-    WZ_sqr.elem[i]  = WZ.elem[i] * WZ.elem[i];
-    WZ_expo.elem[i] = exp( -WZ_sqr.elem[i] / 2.0 );
-    WZ.elem[i]      = WZ.elem[i] * WZ_expo.elem[i];
-    WZ_expo.elem[i] = (1.0 - WZ_sqr.elem[i]) * WZ_expo.elem[i];
+    if (tile == first) {
+      GEMM_NT( GZ, Y, Z_tile );
+    } else {
+      GEMM_NT_ADD( GZ, Y, Z_tile );
+    }
   }
 
-  // Wait for threads to complete.
-  for (i = 0; i < NUM_THREADS - 1; i++) {
-    pthread_join( thread_ids[i], NULL );
+  // A task with no tiles still needs to contribute a zero partial product.
+  if (first == last) {
+    memset( GZ.elem, 0, sizeof(NUMTYPE) * GZ.rows * GZ.cols );
   }
+}
 
-  pthread_attr_destroy( &attr );
-#endif
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void nonlin_tanh( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                         void *data )
+{
+  int row, col, i;
 
-  GEMM_NT( *W_next, WZ, *Z );
+  // Compute the tanh() of each element, and sum the derivative of tanh(), which
+  // is 1 - tanh^2(), along each row.
+  vmath_tanh( Y->elem, Y->elem, Y->rows * Y->cols );
 
-  // Sum the rows of the WZ_expo matrix in preparation for finding their mean.
-  for (col = 1; col < WZ_expo.cols; col++) {
-    for (row = 0; row < WZ_expo.rows; row++) {
-      WZ_expo.elem[row] += WZ_expo.elem[col*WZ_expo.rows + row];
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      i = col * Y->ld + row;
+      stats[row] += 1.0 - Y->elem[i] * Y->elem[i];
     }
   }
-
-  // Put everything together.
-  for (col = 0; col < W_next->cols; col++) {
-    for (row = 0; row < W_next->rows; row++) {
-      i = col * W_next->rows + row;
-      W_next->elem[i] = (W_next->elem[i] -
-                         WZ_expo.elem[row] * W->elem[i]) / WZ.cols;
-    }
-  }
-
-  // Free allocated memory.
-  free( WZ_expo.elem );
-  free( WZ_sqr.elem );
-  free( WZ.elem );
 }
 
-#ifdef MULTITHREAD_CONTRAST
-  //////////////////////////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////////////////////////
-  void *thr_tanh( void *data )
-  {
-    // Extract the thread data from the given void*.
-    TanhThreadData *d  = (TanhThreadData*) data;
-    NUMTYPE *array      = d->array;
-    int i, length      = d->length;
-
-    // Compute the tanh() of each element.
-    for (i = 0; i < length; i++) {
-      array[i] = tanh( array[i] );
-    }
-
-    return NULL;
-  }
-
-  //////////////////////////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////////////////////////
-  void *thr_tanh_sqr( void *data )
-  {
-    // Extract the thread data from the given void*.
-    TanhThreadData *d  = (TanhThreadData*) data;
-    NUMTYPE *array      = d->array;
-    int i, length      = d->length;
-
-    // Compute the tanh() of each element.
-    for (i = 0; i < length; i++) {
-      array[i] = 1.0f - array[i] * array[i];
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void nonlin_cube( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                         void *data )
+{
+  int row, col, i;
+  NUMTYPE sqr;
+
+  // Compute the square and cube of each element. We do not use the pow()
+  // function here because it doubles the runtime of the ica() algorithm.
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      i = col * Y->ld + row;
+      sqr = Y->elem[i] * Y->elem[i];
+      stats[row] += 3.0 * sqr;
+      Y->elem[i] = sqr * Y->elem[i];
     }
-
-    return NULL;
   }
+}
 
-  //////////////////////////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////////////////////////
-  void *thr_cube( void *data )
-  {
-    // Extract thread data from the given void*.
-    CubeThreadData *d = (CubeThreadData*) data;
-    NUMTYPE *wz_sqr    = d->wz_sqr;
-    NUMTYPE *wz_cube   = d->wz_cube;
-    int i, length     = d->length;
-
-    // Do the same thing as the unthreaded version.
-    for (i = 0; i < length; i++) {
-      wz_sqr[i]  = 3.0 * (wz_cube[i] * wz_cube[i]);
-      wz_cube[i] = wz_cube[i] * wz_cube[i] * wz_cube[i];
-    }
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void nonlin_gauss( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                          void *data )
+{
+  int row, col, i, n = Y->rows * Y->cols;
 
-    return NULL;
+  // Compute exp( -y^2 / 2 ) for each element, y, and then replace y with
+  // y * exp( -y^2 / 2 ) while summing (1 - y^2) * exp( -y^2 / 2 ) along each
+  // row.
+  for (i = 0; i < n; i++) {
+    scratch[i] = -Y->elem[i] * Y->elem[i] / 2.0;
   }
+  vmath_exp( scratch, scratch, n );
 
-  //////////////////////////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////////////////////////
-  void *thr_gauss( void *data )
-  {
-    GaussThreadData *d = (GaussThreadData*) data;
-    NUMTYPE *wz_expo    = d->wz_expo;
-    NUMTYPE *wz_sqr     = d->wz_sqr;
-    NUMTYPE *wz         = d->wz;
-    int i, length      = d->length;
-
-    // Do the same things as the unthreaded version.
-    for (i = 0; i < length; i++) {
-      wz_sqr[i]  = wz[i] * wz[i];
-      wz_expo[i] = exp( -wz_sqr[i] / 2.0 );
-
-      wz[i]      = wz[i] * wz_expo[i];
-      wz_expo[i] = (1.0 - wz_sqr[i]) * wz_expo[i];
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      i = col * Y->ld + row;
+      stats[row] += (1.0 - Y->elem[i] * Y->elem[i]) * scratch[i];
+      Y->elem[i] = Y->elem[i] * scratch[i];
     }
-
-    return NULL;
   }
-#endif
+}
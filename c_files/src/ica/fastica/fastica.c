@@ -8,59 +8,107 @@
 #include <stdlib.h>
 
 /**
- * Global variables setup in our initialization function. Setup of these
- * variables is an overhead that we shouldn't have to incur for every run of
- * the fastica() computation, since the values for these variables is dependent
- * on the ICA configuration parameters and nothing else.
+ * Everything setup in our initialization function. Setup of this state is an
+ * overhead that we shouldn't have to incur for every run of the fastica()
+ * computation, since its values are dependent on the ICA configuration
+ * parameters and nothing else.
  */
-static Matrix   _white_Z, _tW[6];       // Workspace matrices.
-static NUMTYPE *_eig_vals = NULL;       // Where we store computed eigen values.
-static ContFunc _contrast = NULL;       // The contrast function we apply.
-static NUMTYPE  _epsilon = 0.0;         // Convergence epsilon.
-static int _max_iter = 0;               // Max number of iterations to perform.
+struct FastICAState {
+  Matrix   white_Z, tW[6];      // Workspace matrices.
+  NUMTYPE *eig_vals;            // Where we store computed eigen values.
+  ContFunc contrast;            // The contrast function we apply.
+  ContrastWork cwork;           // Scratch space for the contrast.
+  NUMTYPE  epsilon;             // Convergence epsilon.
+  int max_iter;                 // Max number of iterations to perform.
+  int num_comp;                 // Components to deflate (0 for all).
+  unsigned int pca_dims;        // Most principal components to keep.
+  NUMTYPE pca_variance;         // Fraction of the variance to keep.
+  DecorrType decorr;            // How to orthogonalize W.
+  ICAMonitor mon;               // Reports our progress to the observer.
+
+  // The parameters given to fastica_init(), for the optional deflation seed and
+  // observer, which may change without reinitializing. Like the rest of the
+  // parameters, the seed is always in the native precision (see numtype.h).
+  ICAParams const *params;
+};
+
+static int symmetric( FastICAState *st, Matrix *A, Matrix const *W_init );
+static int deflation( FastICAState *st, Matrix *B, Matrix const *W_init,
+                      int *num_found );
+static NUMTYPE gramSchmidt( NUMTYPE *w, Matrix const *B, int num_rows );
+static void decorrelate( FastICAState *st, Matrix *B, Matrix const *M,
+                         Matrix *T1, Matrix *T2 );
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-int fastica_init( ICAParams *params )
+int fastica_init( FastICAState **state, ICAParams *params )
 {
   int i;
+  FastICAState *st;
+
+  *state = st = (FastICAState*) calloc( 1, sizeof(FastICAState) );
+  if (st == NULL) {
+    return 0;
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Initialize configuration parameters.
   //////////////////////////////////////////////////////////////////////////////
-  _epsilon  = params->epsilon;
-  _max_iter = params->max_iter;
+  st->epsilon  = params->epsilon;
+  st->max_iter = params->max_iter;
+  st->params   = params;
+
+  st->pca_dims     = params->pca_dims;
+  st->pca_variance = params->pca_variance;
+  st->decorr       = params->decorr;
+
+  // Only use deflation if we've been asked for fewer components than there are
+  // variables.
+  st->num_comp = 0;
+  if (params->num_components < params->num_var) {
+    st->num_comp = params->num_components;
+  }
 
   switch (params->contrast) {
     case NONLIN_CUBE:
-      _contrast = negent_cube;
+      st->contrast = negent_cube;
       break;
     case NONLIN_GAUSS:
-      _contrast = negent_gauss;
+      st->contrast = negent_gauss;
       break;
     case NONLIN_TANH:
     default:
-      _contrast = negent_tanh;
+      st->contrast = negent_tanh;
       break;
   }
 
   //////////////////////////////////////////////////////////////////////////////
   // Allocate memory.
   //////////////////////////////////////////////////////////////////////////////
-  _eig_vals     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
-  _white_Z.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var *
+  st->eig_vals     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->white_Z.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var *
                                      params->num_obs );
-  _white_Z.cols = _white_Z.lag = params->num_obs;
-  _white_Z.rows = _white_Z.ld  = params->num_var;
+  st->white_Z.cols = st->white_Z.lag = params->num_obs;
+  st->white_Z.rows = st->white_Z.ld  = params->num_var;
+
+  // The tW matrices are all temporary matrices used as scratch space in our
+  // calculations, and tW[0] is used as another name for the W parameter.
+  // NOTE: the setup of tW[0] must be down within the fastica() function.
+  //    tW[0] = *W;
+  for (i = 1; i < sizeof(st->tW) / sizeof(Matrix); i++) {
+    st->tW[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                        params->num_var * params->num_var );
+    st->tW[i].rows = st->tW[i].cols = params->num_var;
+    st->tW[i].ld   = st->tW[i].lag  = params->num_var;
+  }
 
-  // The _tW matrices are all temporary matrices used as scratch space in our
-  // calculations, and _tW[0] is used as another name for the W parameter.
-  // NOTE: the setup of _tW[0] must be down within the fastica() function.
-  //    _tW[0] = *W;
-  for (i = 1; i < sizeof(_tW) / sizeof(Matrix); i++) {
-    _tW[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
-                                     params->num_var * params->num_var );
-    _tW[i].rows = _tW[i].cols = _tW[i].ld = _tW[i].lag = params->num_var;
+  // The contrast functions get all of their scratch space from here, so that no
+  // memory needs to be allocated while iterating.
+  if (!contrast_initWork( &st->cwork, params->num_var, params->num_obs,
+                          1, 0 )) {
+    fastica_shutdown( st );
+    *state = NULL;
+    return 0;
   }
 
   // All done. Return that things went OK.
@@ -69,114 +117,207 @@ int fastica_init( ICAParams *params )
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void fastica_shutdown()
+void fastica_shutdown( FastICAState *st )
 {
   int i;
 
+  if (st == NULL) {
+    return;
+  }
+
   //////////////////////////////////////////////////////////////////////////////
-  // Free allocated memory and set everything to NULL/0.
+  // Free all allocated memory, including the state itself.
   //////////////////////////////////////////////////////////////////////////////
-  free( _eig_vals );
-  _eig_vals = NULL;
+  free( st->eig_vals );
+  free( st->white_Z.elem );
 
-  free( _white_Z.elem );
-  _white_Z.elem = NULL;
-  _white_Z.cols = _white_Z.lag = _white_Z.rows = _white_Z.ld = 0;
-
-  for (i = 1; i < sizeof(_tW) / sizeof(Matrix); i++) {
-    free( _tW[i].elem );
-    _tW[i].elem = NULL;
-    _tW[i].rows = _tW[i].cols = _tW[i].ld = _tW[i].lag = 0;
+  for (i = 1; i < sizeof(st->tW) / sizeof(Matrix); i++) {
+    free( st->tW[i].elem );
   }
 
-  _contrast = NULL;
-  _epsilon = 0.0;
-  _max_iter = 0;
+  contrast_freeWork( &st->cwork );
+
+  free( st );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-unsigned int fastica( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
-                      Matrix const *X )
+ICAStatus fastica_status( FastICAState const *st )
 {
-  int num_iter, prev_i, new_i, row, col, i;
-  NUMTYPE min;
+  return st->mon.status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int fastica( FastICAState *st, Matrix *W, Matrix *A, Matrix *S,
+                      NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                      ICAWhitenStats const *stats )
+{
+  int num_iter, num_found, i;
+  unsigned int num_dims;
+  Matrix init;
+
+  // The initial guess may be the W parameter itself, so remember its size
+  // before we change it.
+  if (W_init) {
+    init = *W_init;
+    W_init = &init;
+  }
+
+  // The outputs may have been shrunk by a previous run that only extracted
+  // some of the components, so start out with them at full size.
+  W->rows = S->rows = A->cols = X->rows;
 
   // Setup the renaming of the `W' parameter.
-  _tW[0] = *W;
+  st->tW[0] = *W;
+
+  // The workspace may have room for more variables and observations than we've
+  // been given, so size it for these ones.
+  st->white_Z.cols = st->white_Z.lag = X->cols;
+  st->tW[3].rows = st->tW[3].ld = X->rows;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Make the observations zero-mean, temporarily recommissioning the mu_S
-  // array to store the observation means, so that we can calculate the source
-  // signal means later, and using the S matrix parameter to temporarily hold
-  // the zero-mean observations.
+  // Find the observation means and covariance (from the statistics we were
+  // given, if they're for X, and otherwise in one pass over X), temporarily
+  // recommissioning the mu_S array to store the observation means, so that we
+  // can calculate the source signal means later, and using the S matrix
+  // parameter as scratch space for the blocks of centered observations.
   //////////////////////////////////////////////////////////////////////////////
 
-  remmean( mu_S, S, X );
+  monitorStart( &st->mon, st->params );
+
+  if (!statsCovariance( mu_S, &st->tW[3], stats, X )) {
+    meanCovariance( mu_S, &st->tW[3], X, S->elem, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_REMMEAN );
 
   //////////////////////////////////////////////////////////////////////////////
-  // Make the zero-mean observations white.
+  // Make the zero-mean observations white, keeping only the principal
+  // components we've been asked to keep.
   //////////////////////////////////////////////////////////////////////////////
 
-  whiten( &_white_Z, &_tW[2], &_tW[3], S, 0 );
-  // _tW[2] <--   whitening matrix
-  // _tW[3] <-- dewhitening matrix
+  num_dims = whitenMean( &st->white_Z, &st->tW[2], &st->tW[3], X, mu_S,
+                         S->elem, st->eig_vals, st->pca_dims,
+                         st->pca_variance );
+  // tW[2] <--   whitening matrix (num_dims x num_var)
+  // tW[3] <-- dewhitening matrix (num_var x num_dims)
+  monitorPhase( &st->mon, ICA_PHASE_WHITEN );
+
+  // From here on, we're working with num_dims whitened variables, so the
+  // unmixing matrix for them is num_dims x num_dims, as are its workspaces.
+  for (i = 0; i < sizeof(st->tW) / sizeof(Matrix); i++) {
+    if (i != 2 && i != 3) {
+      st->tW[i].rows = st->tW[i].cols = st->tW[i].ld = st->tW[i].lag = num_dims;
+    }
+  }
+  W->rows = S->rows = A->cols = num_dims;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Initialize our guess at the unmixing matrix to the identity matrix.
+  // With the observations now zero-mean and whitened, find the unmixing matrix
+  // for the whitened observations, leaving the result in tW[1].
   //////////////////////////////////////////////////////////////////////////////
-  for (i = 0; i < _tW[0].rows * _tW[0].cols; i++) {
-    _tW[0].elem[i] = 0.0;
-  }
-  for (i = 0; i < _tW[0].rows; i++) {
-    _tW[0].elem[i + i*_tW[0].rows] = 1.0;
+  if (st->num_comp > 0 && st->num_comp < num_dims) {
+    // Only num_comp rows of the unmixing matrix are estimated (fewer, if we're
+    // told to stop early), so shrink the outputs to match.
+    num_iter = deflation( st, &st->tW[1], W_init, &num_found );
+    W->rows = S->rows = A->cols = num_found;
+  } else {
+    // The symmetric update needs a guess for every row of the unmixing matrix,
+    // so a guess from a run that extracted fewer components can't be used.
+    if (W_init && W_init->rows != num_dims) {
+      W_init = NULL;
+    }
+    num_iter = symmetric( st, A, W_init );
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // With the observations now zero-mean and whitened, begin iterating.
+  // We now have a best guess at an unmixing matrix. We need to finish up our
+  // computations by computing the source signals, the source signal mixing
+  // matrix, the unmixing matrix that will unmix the original, nonwhitened
+  // observations, and the means of the source signals.
+  //////////////////////////////////////////////////////////////////////////////
+
+  // tW[1] holds the best guess at an unmixing matrix after our iterations.
+  // tW[2] holds the whitening matrix.
+  // tW[3] holds the dewhitening matrix.
+
+  // Finish the computations for A, W, and S.
+  st->tW[1].rows = W->rows;
+  GEMM_NT( *A, st->tW[3], st->tW[1] );
+  GEMM( *W, st->tW[1], st->tW[2] );
+  GEMM( *S, st->tW[1], st->white_Z );
+
+  // Compute the mean values of the signal vectors by unmixing the mean values
+  // of the observation vectors.
+  GEMV( st->eig_vals, *W, mu_S );
+  memcpy( mu_S, st->eig_vals, sizeof(NUMTYPE) * S->rows );
+  st->tW[1].rows = st->tW[1].ld;
+  monitorPhase( &st->mon, ICA_PHASE_FINALIZE );
+  monitorFinish( &st->mon, num_iter );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // And that's it!
+  //////////////////////////////////////////////////////////////////////////////
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int symmetric( FastICAState *st, Matrix *A, Matrix const *W_init )
+{
+  int num_iter, prev_i, new_i, i;
+  NUMTYPE min;
+
+  // tW[0] is another name for the caller's W matrix.
+  Matrix *W = &st->tW[0];
+
+  // The A matrix isn't needed until we're done, so it is used as scratch space
+  // of the same size as W.
+  Matrix T = *W;
+  T.elem = A->elem;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize our guess at the unmixing matrix. If we were given a guess at
+  // the unmixing matrix for the original observations, then W_init * dewhiten
+  // is the matching guess for the whitened observations, once its rows have
+  // been made orthonormal. Otherwise, start from the identity matrix.
   //////////////////////////////////////////////////////////////////////////////
+  if (W_init) {
+    GEMM( st->tW[4], *W_init, st->tW[3] );
+    decorrelate( st, W, &st->tW[4], &T, &st->tW[5] );
+  } else {
+    for (i = 0; i < W->rows * W->cols; i++) {
+      W->elem[i] = 0.0;
+    }
+    for (i = 0; i < W->rows; i++) {
+      W->elem[i + i*W->rows] = 1.0;
+    }
+  }
+
   num_iter = 0;
   do {
     // To save us from having to copy the previous unmixing matrix guess, we
-    // alternate between _tW[0] and _tW[1] holding the new/previous guess,
-    // starting with _tW[0] holding the previous guess, and _tW[1] holding the
+    // alternate between tW[0] and tW[1] holding the new/previous guess,
+    // starting with tW[0] holding the previous guess, and tW[1] holding the
     // new guess.
     new_i  = (num_iter + 1) & 0x01;
     prev_i = (num_iter    ) & 0x01;
     num_iter++;
 
     ////////////////////////////////////////////////////////////////////////////
-    // Apply the contrast rule to _tW[prev_i], storing the result in _tW[4].
+    // Apply the contrast rule to tW[prev_i], storing the result in tW[4].
     ////////////////////////////////////////////////////////////////////////////
-    _contrast( &_tW[4], &_tW[prev_i], &_white_Z );
+    st->contrast( &st->tW[4], &st->tW[prev_i], &st->white_Z, &st->cwork );
+    monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
 
     ////////////////////////////////////////////////////////////////////////////
     // Orthogonalize the updated unmixing matrix.
     ////////////////////////////////////////////////////////////////////////////
 
-    GEMM_NT( _tW[new_i], _tW[4], _tW[4] );
-    SYEV( _tW[new_i], _eig_vals );
-
-    for (i = 0; i < W->rows; i++) {
-      // We need to take the square root of the absolute value here, because it
-      // is possible, thanks to floating point error, than an eigenvalue has
-      // become negative. If we don't use the absolute value, we will get NaN
-      // infecting our data.
-
-      // TODO: if an eigenvector becomes negative, should be just quit there and
-      //       say that extraction of source signals is not possible?
-      _eig_vals[i] = 1.0 / sqrt( fabs( _eig_vals[i]) );
-    }
-
-    // A = D ^ (-1/2) * E'
-    for (col = 0; col < W->cols; col++) {
-      for (row = 0; row < W->rows; row++) {
-        i = col * W->rows + row;
-        A->elem[i] = _eig_vals[row] * _tW[new_i].elem[row*W->rows + col];
-      }
-    }
-    GEMM( _tW[5], _tW[new_i], *A );     // _tW[5] = E * D^(-1/2) * E'
-    GEMM( _tW[new_i], _tW[5], _tW[4] );
+    // TODO: if an eigenvalue becomes negative, should be just quit there and
+    //       say that extraction of source signals is not possible?
+    decorrelate( st, &st->tW[new_i], &st->tW[4], &T, &st->tW[5] );
 
     ////////////////////////////////////////////////////////////////////////////
     // Determine if the rows of the unmixing matrix have changed significantly
@@ -186,52 +327,191 @@ unsigned int fastica( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
     // We find the angle by using the dot product and the rule that the dot
     // product of two vectors is equal to the cosine of the angle between the
     // vectors.
-    GEMM_NT( _tW[4], _tW[new_i], _tW[prev_i] );
+    GEMM_NT( st->tW[4], st->tW[new_i], st->tW[prev_i] );
     min = 1.0;
 
     for (i = 0; i < W->rows; i++) {
-      if (min > fabs(_tW[4].elem[i*W->rows + i])) {
-        min = fabs(_tW[4].elem[i*W->rows + i]);
+      if (min > fabs(st->tW[4].elem[i*W->rows + i])) {
+        min = fabs(st->tW[4].elem[i*W->rows + i]);
       }
     }
+    monitorPhase( &st->mon, ICA_PHASE_ORTHO );
+    monitorReport( &st->mon, num_iter, 1.0 - min );
 
-  // Keep iterating until we meet the convergence criteria, or hit the maximum
-  // number of iterations.
-  } while ((1.0 - min) > _epsilon && num_iter < _max_iter);
+  // Keep iterating until we meet the convergence criteria, hit the maximum
+  // number of iterations, or are told to stop. Every guess is orthonormal, so
+  // the last one is as good a place to stop as any.
+  } while ((1.0 - min) > st->epsilon && num_iter < st->max_iter &&
+           !monitorStop( &st->mon ));
 
-  //////////////////////////////////////////////////////////////////////////////
-  // We now have a best guess at an unmixing matrix. We need to finish up our
-  // computations by computing the source signals, the source signal mixing
-  // matrix, the unmixing matrix that will unmix the original, nonwhitened
-  // observations, and the means of the source signals.
-  //////////////////////////////////////////////////////////////////////////////
+  if ((1.0 - min) > st->epsilon) {
+    monitorMaxIter( &st->mon );
+  }
 
-  // _tW[0] is just another name for *W. We need to use the newest result of the
+  // tW[0] is just another name for *W. We need to use the newest result of the
   // iteration process as an operand in the computation of the final W matrix.
   // To do this, we need to make sure the newest result comes from a matrix
   // that is not *W.
   if (new_i == 0) {
-    memcpy( _tW[1].elem, _tW[0].elem, sizeof(NUMTYPE) * W->rows * W->cols );
-    new_i = 1;
+    memcpy( st->tW[1].elem, st->tW[0].elem,
+            sizeof(NUMTYPE) * W->rows * W->cols );
   }
 
-  // _tW[1] holds the best guess at an unmixing matrix after our iterations.
-  // _tW[2] holds the whitening matrix.
-  // _tW[3] holds the dewhitening matrix.
+  return num_iter;
+}
 
-  // Finish the computations for A, W, and S.
-  GEMM_NT( *A, _tW[3], _tW[1] );
-  GEMM( *W, _tW[1], _tW[2] );
-  GEMM( *S, _tW[1], _white_Z );
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void decorrelate( FastICAState *st, Matrix *B, Matrix const *M,
+                         Matrix *T1, Matrix *T2 )
+{
+  // B = (M * M')^(-1/2) * M, using whichever method we were configured with.
+  if (st->decorr == DECORR_ITER) {
+    iterDecorrelate( B, M, T1, T2 );
+  } else {
+    symDecorrelate( B, M, T1, T2, st->eig_vals );
+  }
+}
 
-  // Compute the mean values of the signal vectors by unmixing the mean values
-  // of the observation vectors.
-  GEMV( _eig_vals, *W, mu_S );
-  memcpy( mu_S, _eig_vals, sizeof(NUMTYPE) * S->rows );
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int deflation( FastICAState *st, Matrix *B, Matrix const *W_init,
+                      int *num_found )
+{
+  int num_iter, comp_iter, comp, row, col, best;
+  NUMTYPE norm, best_norm, dot, *tmp;
+  Matrix w, w_next;
 
-  //////////////////////////////////////////////////////////////////////////////
-  // And that's it!
-  //////////////////////////////////////////////////////////////////////////////
+  // The current guess at a single unmixing vector and the next guess are both
+  // stored as row vectors in the otherwise unused tW[4] and tW[5] matrices.
+  w.rows = w.ld = w_next.rows = w_next.ld = 1;
+  w.cols = w.lag = w_next.cols = w_next.lag = st->white_Z.rows;
+  w.elem = st->tW[4].elem;
+  w_next.elem = st->tW[5].elem;
 
+  num_iter = 0;
+  for (comp = 0; comp < st->num_comp && !monitorStop( &st->mon ); comp++) {
+    ////////////////////////////////////////////////////////////////////////////
+    // Pick an initial guess that is orthogonal to the components we've already
+    // found. If we were given a guess at the unmixing matrix, its rows are
+    // used first (row w_init of the unmixing matrix for the original
+    // observations is w = w_init * dewhiten for the whitened ones). Otherwise,
+    // the first component starts from the seed, if there is one, since
+    // w = whiten * a unmixes the source with spatial pattern a (found without
+    // GEMV, since the seed may not be in our precision).
+    ////////////////////////////////////////////////////////////////////////////
+    norm = 0.0;
+    if (W_init && comp < W_init->rows) {
+      for (col = 0; col < w.cols; col++) {
+        w.elem[col] = 0.0;
+        for (row = 0; row < W_init->cols; row++) {
+          w.elem[col] += W_init->elem[row * W_init->ld + comp] *
+                         st->tW[3].elem[col * st->tW[3].ld + row];
+        }
+      }
+      norm = gramSchmidt( w.elem, B, comp );
+    } else if (comp == 0 && st->params->seed) {
+      for (col = 0; col < w.cols; col++) {
+        w.elem[col] = 0.0;
+        for (row = 0; row < st->tW[2].cols; row++) {
+          w.elem[col] += st->tW[2].elem[row * st->tW[2].ld + col] *
+                         (NUMTYPE) st->params->seed[row];
+        }
+      }
+      norm = gramSchmidt( w.elem, B, comp );
+    }
+
+    if (norm < 0.001) {
+      // Otherwise, start from the unit vector with the largest part left over
+      // after removing the components we've already found.
+      best = 0; best_norm = -1.0;
+      for (col = 0; col < w.cols; col++) {
+        norm = 1.0;
+        for (row = 0; row < comp; row++) {
+          norm -= B->elem[col * B->ld + row] * B->elem[col * B->ld + row];
+        }
+        if (norm > best_norm) {
+          best_norm = norm; best = col;
+        }
+      }
+
+      memset( w.elem, 0, sizeof(NUMTYPE) * w.cols );
+      w.elem[best] = 1.0;
+      gramSchmidt( w.elem, B, comp );
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Apply the one-unit learning rule, removing the projection onto the
+    // components already found after every step.
+    ////////////////////////////////////////////////////////////////////////////
+    comp_iter = 0;
+    do {
+      comp_iter++;
+
+      st->contrast( &w_next, &w, &st->white_Z, &st->cwork );
+      monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
+      gramSchmidt( w_next.elem, B, comp );
+
+      // The vectors are unit length, so their dot product is the cosine of the
+      // angle between them.
+      dot = 0.0;
+      for (col = 0; col < w.cols; col++) {
+        dot += w.elem[col] * w_next.elem[col];
+      }
+
+      tmp = w.elem; w.elem = w_next.elem; w_next.elem = tmp;
+      monitorPhase( &st->mon, ICA_PHASE_ORTHO );
+      monitorReport( &st->mon, num_iter + comp_iter, 1.0 - fabs(dot) );
+    } while ((1.0 - fabs(dot)) > st->epsilon && comp_iter < st->max_iter &&
+             !monitorStop( &st->mon ));
+
+    if ((1.0 - fabs(dot)) > st->epsilon) {
+      monitorMaxIter( &st->mon );
+    }
+    num_iter += comp_iter;
+
+    // Store the component as the next row of B.
+    for (col = 0; col < w.cols; col++) {
+      B->elem[col * B->ld + comp] = w.elem[col];
+    }
+  }
+
+  // If we were told to stop, the component we were working on is kept too, as
+  // our best guess at it.
+  *num_found = comp;
   return num_iter;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static NUMTYPE gramSchmidt( NUMTYPE *w, Matrix const *B, int num_rows )
+{
+  int row, col;
+  NUMTYPE dot, norm;
+
+  // Remove the projection of w onto each of the first num_rows rows of B (which
+  // are orthonormal), and then make w unit length.
+  for (row = 0; row < num_rows; row++) {
+    dot = 0.0;
+    for (col = 0; col < B->cols; col++) {
+      dot += w[col] * B->elem[col * B->ld + row];
+    }
+    for (col = 0; col < B->cols; col++) {
+      w[col] -= dot * B->elem[col * B->ld + row];
+    }
+  }
+
+  norm = 0.0;
+  for (col = 0; col < B->cols; col++) {
+    norm += w[col] * w[col];
+  }
+  norm = sqrt( norm );
+
+  if (norm > 0.0) {
+    for (col = 0; col < B->cols; col++) {
+      w[col] /= norm;
+    }
+  }
+
+  return norm;
+}
@@ -0,0 +1,430 @@
+#include "ica/ica.h"
+#include "ica/aux.h"
+#include "ica/fastica/contrast.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Everything an online FastICA estimate keeps between blocks. The statistics
+ * are exponentially weighted: before each block is added, the weight of every
+ * observation already in them is multiplied by forget^(block width). n is the
+ * number of variables and k the number of principal components kept.
+ *
+ * Each block's fixed-point update is found with the unmixing matrix as it was
+ * when the block arrived, and it is these updates that are averaged. Summing
+ * g(W * X) * X' and g`(W * X) over blocks and updating from the totals doesn't
+ * work: the learning rule relies on E{z * g(w' * z)} and E{g`(w' * z)} * w
+ * nearly cancelling, which they only do for the same w.
+ */
+struct ICAOnline {
+  unsigned int num_var;         // How many variables the observations have.
+  unsigned int pca_dims;        // The most principal components to keep.
+  NUMTYPE  forget;              // The weight kept by an observation per new one.
+  double   weight;              // The total weight of the observations seen.
+  double   g_weight;            // The total weight of the contrast statistics.
+  int      ready;               // Whether W has been estimated yet.
+  NUMTYPE *means;               // The weighted observation means.
+  Matrix   scatter;             // The weighted scatter matrix (n x n).
+  Matrix   W;                   // The unmixing matrix (k x n).
+  Matrix   B;                   // The unmixing matrix for whitened data (k x k).
+  Matrix   whiten;              // The whitening matrix (k x n).
+  Matrix   dewhiten;            // The dewhitening matrix (n x k).
+  Matrix   G;                   // The weighted sum of the updates (k x n).
+  Matrix   GZ;                  // A block's g(W * X) * X' (k x n).
+  Matrix   T[4];                // Scratch matrices (k x k).
+  Matrix   block_scatter;       // A block's scatter matrix (n x n).
+  NUMTYPE *block_means;         // A block's means.
+  NUMTYPE *centers;             // W * means, which the nonlinearity removes.
+  NUMTYPE *stats;               // A block's sums of g`(W * X) and g(W * X).
+  NUMTYPE *eig_vals;            // Where we store computed eigen values.
+  NUMTYPE *block;               // Scratch space for updateStats().
+  NUMTYPE *sums;                // Scratch space for updateStats().
+  NonlinFunc nonlin;            // The nonlinearity of the contrast.
+  ContrastWork cwork;           // Scratch space for the contrast.
+};
+
+/**
+ * What the centering nonlinearity needs: the contrast's own nonlinearity, and
+ * the value to remove from each row of W * X first.
+ */
+typedef struct CenterData {
+  NonlinFunc     nonlin;
+  NUMTYPE const *centers;
+} CenterData;
+
+static void nonlin_center( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                           void *data );
+static void addBlockStats( ICAOnline *ol, Matrix const *X, NUMTYPE decay );
+static void onlineStep( ICAOnline *ol, Matrix const *X, NUMTYPE decay );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAOnline *fastica_createOnline( ICAParams const *params,
+                                 NUMTYPE_NATIVE forget )
+{
+  ICAOnline *ol;
+  unsigned int n = params->num_var, block_size, i;
+  Matrix *mats[8];
+
+  if (n == 0 || forget < 0.0 || forget > 1.0) {
+    return NULL;
+  }
+
+  ol = (ICAOnline*) calloc( 1, sizeof(ICAOnline) );
+  if (ol == NULL) {
+    return NULL;
+  }
+
+  ol->num_var  = n;
+  ol->pca_dims = (params->pca_dims > 0 && params->pca_dims < n) ?
+                 params->pca_dims : n;
+  ol->forget   = (forget > 0.0) ? forget : DEF_FORGET;
+  ol->nonlin   = contrast_nonlin( params->contrast );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate memory. Every matrix has room for n x n values, and is stored
+  // contiguously (its ld is its number of rows).
+  //////////////////////////////////////////////////////////////////////////////
+  block_size = (n < WHITEN_BLOCK) ? WHITEN_BLOCK : n;
+
+  mats[0] = &ol->scatter;  mats[1] = &ol->W;        mats[2] = &ol->B;
+  mats[3] = &ol->whiten;   mats[4] = &ol->dewhiten; mats[5] = &ol->G;
+  mats[6] = &ol->GZ;       mats[7] = &ol->block_scatter;
+
+  for (i = 0; i < sizeof(mats) / sizeof(Matrix*); i++) {
+    mats[i]->elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * n );
+    mats[i]->rows = mats[i]->cols = mats[i]->ld = mats[i]->lag = n;
+  }
+  for (i = 0; i < sizeof(ol->T) / sizeof(Matrix); i++) {
+    ol->T[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * n );
+    ol->T[i].rows = ol->T[i].cols = ol->T[i].ld = ol->T[i].lag = n;
+  }
+
+  ol->means       = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  ol->block_means = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  ol->centers     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  ol->stats       = (NUMTYPE*) malloc( sizeof(NUMTYPE) * 2 * n );
+  ol->eig_vals    = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  ol->sums        = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  ol->block       = (NUMTYPE*) malloc( sizeof(NUMTYPE) * block_size );
+
+  // Blocks of any width can be handed to tiledContrast(); the width given here
+  // only caps how many tasks the tiles are split between.
+  if (!contrast_initWork( &ol->cwork, n, WHITEN_BLOCK, 2, 0 )) {
+    fastica_destroyOnline( ol );
+    return NULL;
+  }
+
+  for (i = 0; i < sizeof(mats) / sizeof(Matrix*); i++) {
+    if (mats[i]->elem == NULL) {
+      fastica_destroyOnline( ol );
+      return NULL;
+    }
+  }
+  for (i = 0; i < sizeof(ol->T) / sizeof(Matrix); i++) {
+    if (ol->T[i].elem == NULL) {
+      fastica_destroyOnline( ol );
+      return NULL;
+    }
+  }
+  if (!ol->means || !ol->block_means || !ol->centers ||
+      !ol->stats || !ol->eig_vals || !ol->sums || !ol->block) {
+    fastica_destroyOnline( ol );
+    return NULL;
+  }
+
+  fastica_resetOnline( ol );
+  return ol;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void fastica_resetOnline( ICAOnline *ol )
+{
+  unsigned int n = ol->num_var;
+
+  ol->weight = ol->g_weight = 0.0;
+  ol->ready  = 0;
+  memset( ol->means, 0, sizeof(NUMTYPE) * n );
+  memset( ol->scatter.elem, 0, sizeof(NUMTYPE) * n * n );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int fastica_updateOnline( ICAOnline *ol, Matrix const *X )
+{
+  unsigned int i;
+  NUMTYPE decay, scale;
+
+  if (X->rows != (int) ol->num_var) {
+    return 0;
+  }
+  if (X->cols == 0) {
+    return 1;
+  }
+
+  // How much of its weight each observation already seen keeps.
+  decay = pow( ol->forget, X->cols );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Add the block to the whitening statistics, and whiten with them once they
+  // describe enough observations for the covariance matrix to be full rank.
+  //////////////////////////////////////////////////////////////////////////////
+  addBlockStats( ol, X, decay );
+
+  if (ol->weight <= ol->num_var) {
+    return 1;
+  }
+
+  // The scatter matrix becomes the covariance matrix.
+  scale = 1.0 / ol->weight;
+  for (i = 0; i < ol->num_var * ol->num_var; i++) {
+    ol->dewhiten.elem[i] = scale * ol->scatter.elem[i];
+  }
+  ol->dewhiten.rows = ol->dewhiten.ld = ol->num_var;
+  covarianceWhiten( &ol->whiten, &ol->dewhiten, ol->eig_vals, ol->pca_dims,
+                    0.0 );
+  // whiten   <--   whitening matrix (k x n)
+  // dewhiten <-- dewhitening matrix (n x k)
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The first estimate of the unmixing matrix just whitens. After that, each
+  // block moves it one fixed-point step.
+  //////////////////////////////////////////////////////////////////////////////
+  if (!ol->ready) {
+    memcpy( ol->W.elem, ol->whiten.elem,
+            sizeof(NUMTYPE) * ol->whiten.rows * ol->whiten.cols );
+    ol->W.rows = ol->W.ld = ol->whiten.rows;
+    ol->W.cols = ol->whiten.cols;
+    ol->ready = 1;
+  }
+
+  onlineStep( ol, X, decay );
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int fastica_onlineUnmixing( ICAOnline const *ol, Matrix *W, Matrix *A,
+                                     NUMTYPE *mu_S )
+{
+  int row, col;
+
+  if (!ol->ready) {
+    return 0;
+  }
+
+  if (W) {
+    W->rows = ol->W.rows;
+    W->cols = ol->W.cols;
+    for (col = 0; col < W->cols; col++) {
+      for (row = 0; row < W->rows; row++) {
+        W->elem[col*W->ld + row] = ol->W.elem[col*ol->W.ld + row];
+      }
+    }
+  }
+
+  // A = dewhiten * B', whose columns are the sources' scalp maps.
+  if (A) {
+    A->rows = ol->dewhiten.rows;
+    A->cols = ol->B.rows;
+    GEMM_NT( *A, ol->dewhiten, ol->B );
+  }
+
+  if (mu_S) {
+    GEMV( mu_S, ol->W, ol->means );
+  }
+
+  return ol->W.rows;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void fastica_destroyOnline( ICAOnline *ol )
+{
+  unsigned int i;
+
+  if (ol == NULL) {
+    return;
+  }
+
+  free( ol->scatter.elem );  free( ol->W.elem );  free( ol->B.elem );
+  free( ol->whiten.elem );   free( ol->dewhiten.elem );
+  free( ol->G.elem );        free( ol->GZ.elem );
+  free( ol->block_scatter.elem );
+  for (i = 0; i < sizeof(ol->T) / sizeof(Matrix); i++) {
+    free( ol->T[i].elem );
+  }
+
+  free( ol->means );    free( ol->block_means ); free( ol->centers );
+  free( ol->stats );    free( ol->eig_vals );    free( ol->sums );
+  free( ol->block );
+
+  contrast_freeWork( &ol->cwork );
+  free( ol );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void nonlin_center( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                           void *data )
+{
+  CenterData const *d = (CenterData const*) data;
+  int row, col;
+
+  // The tile is W * X, so removing W * means centers it. The contrast's own
+  // nonlinearity then replaces it with g(W * (X - means)), summing g`() into
+  // the first row of statistics, and we sum g() into the second.
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      Y->elem[col*Y->ld + row] -= d->centers[row];
+    }
+  }
+
+  d->nonlin( Y, stats, scratch, NULL );
+
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      stats[Y->rows + row] += Y->elem[col*Y->ld + row];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void addBlockStats( ICAOnline *ol, Matrix const *X, NUMTYPE decay )
+{
+  unsigned int n = ol->num_var, count, row, col;
+  double old_weight, weight;
+  NUMTYPE scale;
+
+  // Find the block's own means and scatter matrix.
+  memset( ol->block_scatter.elem, 0, sizeof(NUMTYPE) * n * n );
+  count = 0;
+  updateStats( ol->block_means, &ol->block_scatter, &count, X, 0, ol->block,
+               ol->sums );
+
+  // Merge them with the decayed statistics of the observations before them,
+  // as updateStats() merges blocks, but with the old observations weighted
+  // by `decay':
+  //    means   += delta * T / weight
+  //    scatter  = decay * scatter + block_scatter
+  //               + delta * delta' * old_weight * T / weight
+  // where delta = block_means - means and T is the width of the block.
+  old_weight = decay * ol->weight;
+  weight     = old_weight + X->cols;
+
+  for (row = 0; row < n; row++) {
+    ol->sums[row] = ol->block_means[row] - ol->means[row];
+    ol->means[row] += ol->sums[row] * X->cols / weight;
+  }
+
+  // Only the upper triangles of the scatter matrices are kept (see
+  // updateStats()).
+  scale = old_weight * X->cols / weight;
+  for (col = 0; col < n; col++) {
+    for (row = 0; row <= col; row++) {
+      ol->scatter.elem[col*n + row] = decay * ol->scatter.elem[col*n + row] +
+                                      ol->block_scatter.elem[col*n + row] +
+                                      scale * ol->sums[row] * ol->sums[col];
+    }
+  }
+
+  ol->weight = weight;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void onlineStep( ICAOnline *ol, Matrix const *X, NUMTYPE decay )
+{
+  unsigned int k = ol->W.rows, n = ol->num_var, row, col, i;
+  CenterData cdata;
+  NUMTYPE dot;
+  Matrix *Gz = &ol->T[0], *B_next = &ol->T[1];
+
+  for (i = 0; i < sizeof(ol->T) / sizeof(Matrix); i++) {
+    ol->T[i].rows = ol->T[i].cols = ol->T[i].ld = ol->T[i].lag = k;
+  }
+  ol->B.rows = ol->B.cols = ol->B.ld = ol->B.lag = k;
+  ol->G.rows = ol->G.ld = ol->GZ.rows = ol->GZ.ld = k;
+  ol->G.cols = ol->GZ.cols = n;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Run the block through the contrast with the current unmixing matrix,
+  // centering it on the way (see nonlin_center()), so that
+  //    GZ    = g(Y) * X'
+  //    stats = the row sums of g`(Y), then those of g(Y)
+  // where Y = W * (X - means). Then g(Y) * (X - means)' = GZ - g_sum * means'.
+  //////////////////////////////////////////////////////////////////////////////
+  GEMV( ol->centers, ol->W, ol->means );
+  cdata.nonlin  = ol->nonlin;
+  cdata.centers = ol->centers;
+  tiledContrast( &ol->GZ, ol->stats, 2, &ol->W, X, nonlin_center, &cdata,
+                 &ol->cwork );
+
+  for (col = 0; col < n; col++) {
+    for (row = 0; row < k; row++) {
+      ol->GZ.elem[col*k + row] -= ol->stats[k + row] * ol->means[col];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The block's fixed-point update for the whitened observations Z, with
+  // E{g(Y) * Z'} = E{g(Y) * (X - means)'} * whiten', is
+  //    E{g(Y) * Z'} - diag(E{g`(Y)}) * W * dewhiten
+  // Multiplying by the whitening matrix gives the update for the centered
+  // observations, which (unlike the whitened ones, whose axes may flip from
+  // one block to the next) are the same for every block, and so can be added
+  // to the decayed sum of the updates from the blocks before.
+  //////////////////////////////////////////////////////////////////////////////
+  GEMM_NT( *Gz, ol->GZ, ol->whiten );
+  GEMM( ol->GZ, *Gz, ol->whiten );
+
+  if (ol->g_weight == 0.0) {
+    memset( ol->G.elem, 0, sizeof(NUMTYPE) * k * n );
+  }
+
+  for (col = 0; col < n; col++) {
+    for (row = 0; row < k; row++) {
+      i = col*k + row;
+      ol->G.elem[i] = decay * ol->G.elem[i] + ol->GZ.elem[i] -
+                      ol->stats[row] * ol->W.elem[i];
+    }
+  }
+  ol->g_weight = decay * ol->g_weight + X->cols;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Take the averaged update back to the whitened observations, and decorrelate
+  // its rows, keeping each one pointing the same way as the matching row of the
+  // current B = W * dewhiten, so that the updates of the blocks to come agree
+  // with those before them.
+  //////////////////////////////////////////////////////////////////////////////
+  GEMM( ol->B, ol->W, ol->dewhiten );
+  GEMM( *B_next, ol->G, ol->dewhiten );
+  for (i = 0; i < k * k; i++) {
+    B_next->elem[i] /= ol->g_weight;
+  }
+
+  symDecorrelate( Gz, B_next, &ol->T[2], &ol->T[3], ol->eig_vals );
+
+  for (row = 0; row < k; row++) {
+    dot = 0.0;
+    for (col = 0; col < k; col++) {
+      dot += Gz->elem[col*k + row] * ol->B.elem[col*k + row];
+    }
+
+    if (dot < 0.0) {
+      for (col = 0; col < k; col++) {
+        Gz->elem[col*k + row] = -Gz->elem[col*k + row];
+      }
+    }
+  }
+
+  memcpy( ol->B.elem, Gz->elem, sizeof(NUMTYPE) * k * k );
+
+  // W = B * whiten
+  GEMM( ol->W, ol->B, ol->whiten );
+}
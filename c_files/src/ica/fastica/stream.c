@@ -0,0 +1,444 @@
+#include "ica/ica.h"
+#include "ica/aux.h"
+#include "ica/fastica/contrast.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Everything needed by a run of fastica_stream(). None of it depends on how
+ * many observations there are: the observations are only ever seen a chunk of
+ * columns at a time, so the size of the workspace is set by the width of a
+ * chunk, which is as wide as the stream's memory budget allows.
+ */
+typedef struct StreamState {
+  ICAStream const *stream;      // Where the observations come from.
+  int      chunk_cols;          // The most columns in a chunk.
+  Matrix   X_chunk;             // A chunk of observations.
+  Matrix   Z_chunk;             // The chunk, whitened or unmixed.
+  Matrix   tW[7];               // Workspace matrices.
+  NUMTYPE *means;               // The observation means.
+  NUMTYPE *eig_vals;            // Where we store computed eigen values.
+  NUMTYPE *dg_sum;              // The row sums of g`(W * Z) over all chunks.
+  NUMTYPE *sums;                // Scratch space for updateStats().
+  NonlinFunc nonlin;            // The nonlinearity of the contrast.
+  ContrastWork cwork;           // Scratch space for the contrast.
+  ICAMonitor mon;               // Reports our progress to the observer.
+} StreamState;
+
+static int initStream( StreamState *st, ICAParams const *params,
+                       ICAStream const *stream );
+static void freeStream( StreamState *st );
+static int readStats( StreamState *st );
+static int unmixChunk( StreamState *st, Matrix const *M, unsigned int first );
+static int streamContrast( StreamState *st, Matrix *W_next, Matrix const *W );
+static int streamSymmetric( StreamState *st, ICAParams const *params,
+                            Matrix *A, Matrix const *W_init );
+static void streamDecorrelate( ICAParams const *params, StreamState *st,
+                               Matrix *B, Matrix const *M, Matrix *T1,
+                               Matrix *T2 );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int fastica_stream( ICAParams const *params, Matrix *W, Matrix *A,
+                             NUMTYPE *mu_S, ICAStream const *stream,
+                             Matrix const *W_init, ICAStatus *status )
+{
+  StreamState st;
+  unsigned int first, num_dims, i;
+  int num_iter;
+  Matrix init;
+
+  monitorStart( &st.mon, params );
+
+  if (W_init) {
+    init = *W_init;
+    W_init = &init;
+  }
+
+  if (!initStream( &st, params, stream )) {
+    *status = ICA_STATUS_FAILED;
+    return 0;
+  }
+
+  // Setup the renaming of the `W' parameter.
+  W->rows = W->cols = A->rows = A->cols = stream->num_var;
+  st.tW[0] = *W;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the observation means and covariance in one pass over the stream.
+  //////////////////////////////////////////////////////////////////////////////
+  if (!readStats( &st )) {
+    freeStream( &st );
+    *status = ICA_STATUS_FAILED;
+    return 0;
+  }
+  monitorPhase( &st.mon, ICA_PHASE_REMMEAN );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the whitening matrices, keeping only the principal components we've
+  // been asked to keep. The observations are whitened a chunk at a time as
+  // they are read on each iteration.
+  //////////////////////////////////////////////////////////////////////////////
+  num_dims = covarianceWhiten( &st.tW[2], &st.tW[3], st.eig_vals,
+                               params->pca_dims, params->pca_variance );
+  // tW[2] <--   whitening matrix (num_dims x num_var)
+  // tW[3] <-- dewhitening matrix (num_var x num_dims)
+  monitorPhase( &st.mon, ICA_PHASE_WHITEN );
+
+  for (i = 0; i < sizeof(st.tW) / sizeof(Matrix); i++) {
+    if (i != 2 && i != 3) {
+      st.tW[i].rows = st.tW[i].cols = st.tW[i].ld = st.tW[i].lag = num_dims;
+    }
+  }
+  W->rows = A->cols = num_dims;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the unmixing matrix for the whitened observations, leaving the result
+  // in tW[1]. A guess from a run that kept a different number of components
+  // can't be used.
+  //////////////////////////////////////////////////////////////////////////////
+  if (W_init && (W_init->rows != num_dims ||
+                 W_init->cols != (int) stream->num_var)) {
+    W_init = NULL;
+  }
+  num_iter = streamSymmetric( &st, params, A, W_init );
+
+  if (num_iter == 0) {
+    freeStream( &st );
+    *status = ICA_STATUS_FAILED;
+    return 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Finish up by computing the mixing matrix, the unmixing matrix for the
+  // original observations, and the means of the source signals, and then hand
+  // the source signals to the stream a chunk at a time.
+  //////////////////////////////////////////////////////////////////////////////
+  GEMM_NT( *A, st.tW[3], st.tW[1] );
+  GEMM( *W, st.tW[1], st.tW[2] );
+
+  GEMV( st.eig_vals, *W, st.means );
+  memcpy( mu_S, st.eig_vals, sizeof(NUMTYPE) * W->rows );
+
+  if (stream->write) {
+    for (first = 0; first < stream->num_obs; first += st.X_chunk.cols) {
+      if (!unmixChunk( &st, W, first ) ||
+          !stream->write( stream->data, &st.Z_chunk, first )) {
+        st.mon.status = ICA_STATUS_FAILED;
+        break;
+      }
+    }
+  }
+  monitorPhase( &st.mon, ICA_PHASE_FINALIZE );
+  monitorFinish( &st.mon, num_iter );
+
+  *status = st.mon.status;
+  freeStream( &st );
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int initStream( StreamState *st, ICAParams const *params,
+                       ICAStream const *stream )
+{
+  unsigned int n = stream->num_var, i;
+  size_t budget, fixed, per_col, max_cols, work;
+
+  memset( &st->X_chunk, 0, sizeof(Matrix) );
+  memset( &st->Z_chunk, 0, sizeof(Matrix) );
+  memset( st->tW, 0, sizeof(st->tW) );
+  memset( &st->cwork, 0, sizeof(ContrastWork) );
+  st->means = st->eig_vals = st->dg_sum = st->sums = NULL;
+  st->stream = stream;
+  st->nonlin = contrast_nonlin( params->contrast );
+
+  if (n == 0 || stream->num_obs < 2 || stream->read == NULL) {
+    return 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Besides the chunks, there are six n x n matrices (W and A are the
+  // caller's) and four vectors. The contrast workspace may have up to half of
+  // what's left, sized for the widest chunk that could fit (narrower tiles if
+  // the budget is tight), or if even that isn't enough, all but room for two
+  // observations. The rest goes to the chunk of observations and the chunk of
+  // whitened (or unmixed) observations, both n values per column.
+  //////////////////////////////////////////////////////////////////////////////
+  budget = stream->mem_budget ? stream->mem_budget : DEF_MEM_BUDGET;
+  fixed  = sizeof(NUMTYPE) * (6 * n * n + 4 * n);
+  per_col = sizeof(NUMTYPE) * 2 * n;
+
+  if (budget < fixed + 2 * per_col) {
+    return 0;
+  }
+
+  max_cols = (budget - fixed) / per_col;
+  if (max_cols > stream->num_obs) {
+    max_cols = stream->num_obs;
+  }
+
+  work = contrast_workSize( n, max_cols, 1, (budget - fixed) / 2 );
+  if (work == 0 && budget > fixed + 2 * per_col) {
+    work = contrast_workSize( n, 2, 1, budget - fixed - 2 * per_col );
+  }
+  if (work == 0) {
+    return 0;
+  }
+
+  max_cols = (budget - fixed - work) / per_col;
+  if (max_cols > stream->num_obs) {
+    max_cols = stream->num_obs;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate memory.
+  //////////////////////////////////////////////////////////////////////////////
+  st->chunk_cols = max_cols;
+  st->X_chunk.rows = st->X_chunk.ld  = n;
+  st->X_chunk.cols = st->X_chunk.lag = max_cols;
+  st->X_chunk.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * max_cols );
+  st->Z_chunk = st->X_chunk;
+  st->Z_chunk.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * max_cols );
+
+  st->means    = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  st->eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  st->dg_sum   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+  st->sums     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n );
+
+  // tW[0] is another name for the W parameter (set up by fastica_stream()).
+  for (i = 1; i < sizeof(st->tW) / sizeof(Matrix); i++) {
+    st->tW[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * n );
+    st->tW[i].rows = st->tW[i].cols = n;
+    st->tW[i].ld   = st->tW[i].lag  = n;
+    if (st->tW[i].elem == NULL) {
+      freeStream( st );
+      return 0;
+    }
+  }
+
+  if (!st->X_chunk.elem || !st->Z_chunk.elem || !st->means || !st->eig_vals ||
+      !st->dg_sum || !st->sums ||
+      !contrast_initWork( &st->cwork, n, max_cols, 1, work )) {
+    freeStream( st );
+    return 0;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void freeStream( StreamState *st )
+{
+  unsigned int i;
+
+  free( st->X_chunk.elem ); st->X_chunk.elem = NULL;
+  free( st->Z_chunk.elem ); st->Z_chunk.elem = NULL;
+  free( st->means );    st->means    = NULL;
+  free( st->eig_vals ); st->eig_vals = NULL;
+  free( st->dg_sum );   st->dg_sum   = NULL;
+  free( st->sums );     st->sums     = NULL;
+
+  for (i = 1; i < sizeof(st->tW) / sizeof(Matrix); i++) {
+    free( st->tW[i].elem ); st->tW[i].elem = NULL;
+  }
+
+  contrast_freeWork( &st->cwork );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readStats( StreamState *st )
+{
+  ICAStream const *stream = st->stream;
+  Matrix *C = &st->tW[3];
+  unsigned int first, count, n = stream->num_var, row, col;
+  int width = st->chunk_cols;
+  NUMTYPE scale;
+
+  // Merge each chunk's means and scatter matrix into those of the chunks
+  // before it, using the Z chunk as scratch space for the centered blocks.
+  memset( st->means, 0, sizeof(NUMTYPE) * n );
+  memset( C->elem, 0, sizeof(NUMTYPE) * n * n );
+  count = 0;
+
+  for (first = 0; first < stream->num_obs; first += width) {
+    st->X_chunk.cols = stream->num_obs - first;
+    if (st->X_chunk.cols > width) { st->X_chunk.cols = width; }
+
+    if (!stream->read( stream->data, &st->X_chunk, first )) {
+      return 0;
+    }
+    updateStats( st->means, C, &count, &st->X_chunk, 0, st->Z_chunk.elem,
+                 st->sums );
+  }
+
+  // The scatter matrix becomes the covariance matrix.
+  scale = 1.0 / (count - 1);
+  for (col = 0; col < n; col++) {
+    for (row = 0; row < n; row++) {
+      C->elem[col*C->ld + row] *= scale;
+    }
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int unmixChunk( StreamState *st, Matrix const *M, unsigned int first )
+{
+  ICAStream const *stream = st->stream;
+  int row, col;
+
+  // Read the chunk starting at observation `first' (the last chunk may be
+  // narrower than the rest), and leave M * (X_chunk - means) in the Z chunk.
+  st->X_chunk.cols = stream->num_obs - first;
+  if (st->X_chunk.cols > st->chunk_cols) {
+    st->X_chunk.cols = st->chunk_cols;
+  }
+
+  if (!stream->read( stream->data, &st->X_chunk, first )) {
+    return 0;
+  }
+
+  for (col = 0; col < st->X_chunk.cols; col++) {
+    for (row = 0; row < st->X_chunk.rows; row++) {
+      st->X_chunk.elem[col*st->X_chunk.ld + row] -= st->means[row];
+    }
+  }
+
+  st->Z_chunk.rows = st->Z_chunk.ld = M->rows;
+  st->Z_chunk.cols = st->X_chunk.cols;
+  GEMM( st->Z_chunk, *M, st->X_chunk );
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int streamContrast( StreamState *st, Matrix *W_next, Matrix const *W )
+{
+  unsigned int first;
+  int i, size = W->rows * W->cols;
+
+  // Sum g(W * Z) * Z' and the row sums of g`(W * Z) over every chunk of the
+  // whitened observations, and then apply the learning rule to the totals.
+  memset( W_next->elem, 0, sizeof(NUMTYPE) * size );
+  memset( st->dg_sum, 0, sizeof(NUMTYPE) * W->rows );
+
+  for (first = 0; first < st->stream->num_obs; first += st->X_chunk.cols) {
+    if (!unmixChunk( st, &st->tW[2], first )) {
+      return 0;
+    }
+
+    tiledContrast( &st->tW[6], st->cwork.sums, 1, W, &st->Z_chunk, st->nonlin,
+                   NULL, &st->cwork );
+
+    for (i = 0; i < size; i++) {
+      W_next->elem[i] += st->tW[6].elem[i];
+    }
+    for (i = 0; i < W->rows; i++) {
+      st->dg_sum[i] += st->cwork.sums[i];
+    }
+  }
+
+  contrast_applyRule( W_next, W, st->dg_sum, st->stream->num_obs );
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int streamSymmetric( StreamState *st, ICAParams const *params,
+                            Matrix *A, Matrix const *W_init )
+{
+  int num_iter, prev_i, new_i, i;
+  NUMTYPE min;
+
+  // tW[0] is another name for the caller's W matrix.
+  Matrix *W = &st->tW[0];
+
+  // The A matrix isn't needed until we're done, so it is used as scratch space
+  // of the same size as W.
+  Matrix T = *W;
+  T.elem = A->elem;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize our guess at the unmixing matrix, as symmetric FastICA does.
+  //////////////////////////////////////////////////////////////////////////////
+  if (W_init) {
+    GEMM( st->tW[4], *W_init, st->tW[3] );
+    streamDecorrelate( params, st, W, &st->tW[4], &T, &st->tW[5] );
+  } else {
+    for (i = 0; i < W->rows * W->cols; i++) {
+      W->elem[i] = 0.0;
+    }
+    for (i = 0; i < W->rows; i++) {
+      W->elem[i + i*W->rows] = 1.0;
+    }
+  }
+
+  num_iter = 0;
+  do {
+    // tW[0] and tW[1] take turns holding the new and previous guesses.
+    new_i  = (num_iter + 1) & 0x01;
+    prev_i = (num_iter    ) & 0x01;
+    num_iter++;
+
+    // Apply the contrast rule to tW[prev_i] with one pass over the stream,
+    // storing the result in tW[4].
+    if (!streamContrast( st, &st->tW[4], &st->tW[prev_i] )) {
+      return 0;
+    }
+    monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
+
+    // Orthogonalize the updated unmixing matrix, and then find the smallest
+    // cosine of the angle between a new row and the matching previous row.
+    streamDecorrelate( params, st, &st->tW[new_i], &st->tW[4], &T,
+                       &st->tW[5] );
+
+    GEMM_NT( st->tW[4], st->tW[new_i], st->tW[prev_i] );
+    min = 1.0;
+
+    for (i = 0; i < W->rows; i++) {
+      if (min > fabs(st->tW[4].elem[i*W->rows + i])) {
+        min = fabs(st->tW[4].elem[i*W->rows + i]);
+      }
+    }
+    monitorPhase( &st->mon, ICA_PHASE_ORTHO );
+    monitorReport( &st->mon, num_iter, 1.0 - min );
+
+  } while ((1.0 - min) > params->epsilon && num_iter < params->max_iter &&
+           !monitorStop( &st->mon ));
+
+  if ((1.0 - min) > params->epsilon) {
+    monitorMaxIter( &st->mon );
+  }
+
+  // Make sure the newest guess is in tW[1], rather than in the caller's W.
+  if (new_i == 0) {
+    memcpy( st->tW[1].elem, st->tW[0].elem,
+            sizeof(NUMTYPE) * W->rows * W->cols );
+  }
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void streamDecorrelate( ICAParams const *params, StreamState *st,
+                               Matrix *B, Matrix const *M, Matrix *T1,
+                               Matrix *T2 )
+{
+  // B = (M * M')^(-1/2) * M, using whichever method we were configured with.
+  if (params->decorr == DECORR_ITER) {
+    iterDecorrelate( B, M, T1, T2 );
+  } else {
+    symDecorrelate( B, M, T1, T2, st->eig_vals );
+  }
+}
@@ -1,163 +1,1276 @@
 #include "ica/ica.h"
+#include "ica/aux.h"
 #include "ica/setup.h"
+#include "ica/alt_precision.h"
+#include "ica/thread_pool.h"
+#include "ica/vmath.h"
 #include "ica/fastica/contrast.h"
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /**
- * A global copy of the ICA configuration parameters that we're using. We keep
- * a copy so that we can check for changes so that we know when we need to
- * reinitialize the library.
+ * The workspace of whichever CPU implementation an ICA context uses.
  */
-static ICAParams _ica_params;
-static int _initialized = 0;
+typedef union ICAState {
+  FastICAState *fastica;
+  JadeState    *jade;
+  PicardState  *picard;
+  SobiState    *sobi;
+} ICAState;
+
+/**
+ * Everything needed to run the ICA computation. We keep a copy of the ICA
+ * configuration parameters so that we can check for changes, so that we know
+ * when we need to reinitialize the implementation.
+ */
+struct ICAContext {
+  ICAParams params;
+  int initialized;
+
+  // Whether the implementation in `params' was chosen for the size of X from
+  // the calibration table (see ica_choose()), so must be chosen again when the
+  // size changes, and whether the GPU was allowed in that choice.
+  int auto_implem;
+  int auto_gpu;
+
+  // The most variables and observations the CPU workspace has room for. A CPU
+  // context can run on any X that fits without being reinitialized.
+  unsigned int max_var;
+  unsigned int max_obs;
+
+  // The workspace of the CPU implementation in the native precision and, if
+  // `params' asks for the other one, in the alternate precision (see
+  // numtype.h). The mixed precision needs both. The GPU implementations keep
+  // theirs to themselves.
+  int use_native;
+  int use_alt;
+  ICAState state;
+  ICAState alt_state;
+
+  // Copies of the inputs and outputs of the alternate precision computation.
+  MatrixAlt alt_X, alt_W, alt_A, alt_S, alt_W_init;
+  NUMTYPE_ALT *alt_mu_S;
+
+  // If `params' asks for decimation, the decimated observations, and scratch
+  // space for the filter taps followed by the observation means (see
+  // decimate() and unmixObservations()).
+  Matrix dec_X;
+  NUMTYPE *dec_work;
+
+  // How the last run ended.
+  ICAStatus status;
+};
+
+/**
+ * The context used by ica_init(), ica(), ica_warm(), and ica_shutdown().
+ */
+static ICAContext _default_ctx;
+
+/**
+ * Contexts are configured and shut down while holding _lock, since they share
+ * the thread pool, the choice of vmath routines, and the GPU. _num_active is
+ * how many contexts are initialized (counting streamed runs and online
+ * estimates, which use the thread pool without a context), and _gpu_ctx is
+ * the one using a GPU implementation, if any.
+ */
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int _num_active = 0;
+static ICAContext *_gpu_ctx = NULL;
+
+/**
+ * The calibration table ICA_AUTO chooses from (see ica_setCalibration()), also
+ * guarded by _lock.
+ */
+static ICACalibration const *_calibration = NULL;
+
+static void ica_shutdownImplem( ICAContext *ctx );
+static int ica_initCPU( ICAContext *ctx );
+static void ica_shutdownCPU( ICAContext *ctx );
+static unsigned int ica_runCPU( ICAContext *ctx, Matrix *W, Matrix *A,
+                                Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                Matrix const *W_init,
+                                ICAWhitenStats const *stats );
+static unsigned int ica_runNative( ICAContext *ctx, Matrix *W, Matrix *A,
+                                   Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                   Matrix const *W_init,
+                                   ICAWhitenStats const *stats );
+static unsigned int ica_runAlt( ICAContext *ctx, Matrix *W, Matrix *A,
+                                Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                Matrix const *W_init );
+static unsigned int ica_runDecimated( ICAContext *ctx, Matrix *W, Matrix *A,
+                                      Matrix *S, NUMTYPE *mu_S,
+                                      Matrix const *X, Matrix const *W_init );
+
+/**
+ * Copies the elements of one matrix into another of the same size, which may
+ * be in the other precision (see numtype.h).
+ */
+template <typename To, typename From>
+static void ica_convert( To *dst, From const *src )
+{
+  int row, col;
+
+  for (col = 0; col < src->cols; col++) {
+    for (row = 0; row < src->rows; row++) {
+      dst->elem[col * dst->ld + row] = src->elem[col * src->ld + row];
+    }
+  }
+}
+
+static void ica_defaultParams( ICAParams *params, Matrix const *X );
+static void ica_batchTask( void *data, unsigned int task,
+                           unsigned int num_tasks );
+
+/**
+ * The data shared by the tasks of a call to ica_batch(). Each task claims the
+ * next unclaimed item while holding `lock'.
+ */
+typedef struct BatchData {
+  ICABatchItem   *items;
+  unsigned int    num_items;
+  unsigned int    next_item;
+  ICAContext    **ctx;
+  unsigned int    max_var;
+  unsigned int    max_obs;
+  unsigned int    num_threads;
+  pthread_mutex_t lock;
+} BatchData;
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 int ica_init( ICAParams const *params )
 {
+  return ica_configure( &_default_ctx, params );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAContext *ica_create( ICAParams const *params )
+{
+  ICAContext *ctx = (ICAContext*) calloc( 1, sizeof(ICAContext) );
+
+  if (ctx && !ica_configure( ctx, params )) {
+    free( ctx );
+    ctx = NULL;
+  }
+
+  return ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_configure( ICAContext *ctx, ICAParams const *params )
+{
+  ICAParams chosen;
+  int others;
+
+  pthread_mutex_lock( &_lock );
+
+  // Choose an implementation for ICA_AUTO, and from then on carry on as if it
+  // had been asked for. The GPU can't be chosen if another context has it.
+  ctx->auto_implem = (params->implem == ICA_AUTO);
+  if (ctx->auto_implem) {
+    ctx->auto_gpu = params->use_gpu;
+    memcpy( &chosen, params, sizeof(ICAParams) );
+    if (_gpu_ctx != NULL && _gpu_ctx != ctx) {
+      chosen.use_gpu = 0;
+    }
+
+    if (_calibration == NULL || !ica_choose( _calibration, &chosen, NULL )) {
+      chosen.implem  = DEF_IMPLEM;
+      chosen.use_gpu = 0;
+    }
+
+    params = &chosen;
+  }
+
+  // The thread pool is shared by every implementation, so changing the number
+  // of threads never requires reinitializing the implementation itself. It is
+  // also shared by every context, so leave it alone if any other context might
+  // be using it.
+  others = _num_active - (ctx->initialized ? 1 : 0);
+  if (others == 0 && !tpool_init( params->num_threads )) {
+    pthread_mutex_unlock( &_lock );
+    return 0;
+  }
+
+  // Pick the fastest vectorized math routines the processor supports, unless
+  // the application has already chosen an implementation itself.
+  if (vmath_isa() == VMATH_AUTO) {
+    vmath_init( VMATH_AUTO );
+  }
+  if (vmath_isa_alt() == VMATH_AUTO) {
+    vmath_init_alt( VMATH_AUTO );
+  }
+
   // Check to see if we've already initialized. If we have, only reinitialize
-  // if the ICA params just given differ from the ones we've already got.
-  if (_initialized) {
-    if ((_ica_params.implem     != params->implem)     ||
-        (_ica_params.epsilon    != params->epsilon)    ||
-        (_ica_params.contrast   != params->contrast)   ||
-        (_ica_params.max_iter   != params->max_iter)   ||
-        (_ica_params.num_var    != params->num_var)    ||
-        (_ica_params.num_obs    != params->num_obs)    ||
-        (_ica_params.gpu_device != params->gpu_device) ||
-        (_ica_params.use_gpu    != params->use_gpu)) {
-      ica_shutdown();
+  // if the ICA params just given differ from the ones we've already got. A CPU
+  // workspace can be reused for any size of X it has room for, but the GPU
+  // implementations need the size to match exactly.
+  if (ctx->initialized) {
+    if ((ctx->params.implem     != params->implem)     ||
+        (ctx->params.epsilon    != params->epsilon)    ||
+        (ctx->params.contrast   != params->contrast)   ||
+        (ctx->params.max_iter   != params->max_iter)   ||
+        (ctx->params.gpu_device != params->gpu_device) ||
+        (ctx->params.use_gpu    != params->use_gpu)    ||
+        (ctx->params.num_components != params->num_components) ||
+        (ctx->params.pca_dims   != params->pca_dims)   ||
+        (ctx->params.pca_variance != params->pca_variance) ||
+        (ctx->params.decorr     != params->decorr)     ||
+        (ctx->params.num_lags   != params->num_lags)   ||
+        (ctx->params.precision  != params->precision)  ||
+        (ctx->params.decimate   != params->decimate)   ||
+        (params->use_gpu && ctx->params.num_var != params->num_var) ||
+        (params->use_gpu && ctx->params.num_obs != params->num_obs) ||
+        (params->num_var > ctx->max_var) ||
+        (params->num_obs > ctx->max_obs)) {
+      ica_shutdownImplem( ctx );
     } else {
-      return _initialized;
+      ctx->params.num_threads = params->num_threads;
+      ctx->params.seed        = params->seed;
+      ctx->params.observer    = params->observer;
+      ctx->params.observer_data = params->observer_data;
+      ctx->params.cancel      = params->cancel;
+      ctx->params.time_limit  = params->time_limit;
+      ctx->params.jade_eigenmats = params->jade_eigenmats;
+      ctx->params.num_var     = params->num_var;
+      ctx->params.num_obs     = params->num_obs;
+      pthread_mutex_unlock( &_lock );
+      return ctx->initialized;
     }
   }
 
+  // Only one context at a time may use the GPU implementations.
+  if (params->use_gpu && _gpu_ctx != NULL) {
+    pthread_mutex_unlock( &_lock );
+    return 0;
+  }
+
   // Backup the parameters so that we know how to properly shutdown.
-  memcpy( &_ica_params, params, sizeof(ICAParams) );
+  memcpy( &(ctx->params), params, sizeof(ICAParams) );
 
   //////////////////////////////////////////////////////////////////////////////
   // Initialize the appropriate library.
   //////////////////////////////////////////////////////////////////////////////
-  switch (_ica_params.implem) {
+  switch (ctx->params.implem) {
     case ICA_JADE:
-      if (_ica_params.use_gpu) {
+      if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
-        _initialized = jade_gpuInit( &_ica_params );
+        ctx->initialized = jade_gpuInit( &(ctx->params) );
 #endif
       } else {
-        _initialized = jade_init( &_ica_params );
+        ctx->initialized = ica_initCPU( ctx );
       }
       break;
 
+    case ICA_PICARD:
+    case ICA_SOBI:
+      // There are no GPU implementations of Picard or SOBI, so they always run
+      // on the CPU.
+      ctx->initialized = ica_initCPU( ctx );
+      break;
+
     case ICA_FASTICA:
     default:
-      if (_ica_params.use_gpu) {
+      if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
-        _initialized = fastica_gpuInit( &_ica_params );
+        ctx->initialized = fastica_gpuInit( &(ctx->params) );
 #endif
       } else {
-        _initialized = fastica_init( &_ica_params );
+        ctx->initialized = ica_initCPU( ctx );
       }
       break;
   }
 
-  return _initialized;
+  if (ctx->initialized) {
+    ctx->max_var = ctx->params.num_var;
+    ctx->max_obs = ctx->params.num_obs;
+
+    _num_active++;
+    if (ctx->params.use_gpu) {
+      _gpu_ctx = ctx;
+    }
+  }
+
+  pthread_mutex_unlock( &_lock );
+
+  return ctx->initialized;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 void ica_shutdown()
 {
-  if (_initialized) {
+  ica_destroy( &_default_ctx );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_destroy( ICAContext *ctx )
+{
+  if (ctx == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock( &_lock );
+
+  ica_shutdownImplem( ctx );
+
+  // Nobody else is using the thread pool, so let its threads go.
+  if (_num_active == 0) {
+    tpool_shutdown();
+  }
+
+  pthread_mutex_unlock( &_lock );
+
+  // The default context isn't ours to free.
+  if (ctx != &_default_ctx) {
+    free( ctx );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void ica_shutdownImplem( ICAContext *ctx )
+{
+  if (ctx->initialized) {
     ////////////////////////////////////////////////////////////////////////////
     // Shutdown the appropriate library.
     ////////////////////////////////////////////////////////////////////////////
-    switch (_ica_params.implem) {
+    switch (ctx->params.implem) {
       case ICA_JADE:
-        if (_ica_params.use_gpu) {
+        if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
           jade_gpuShutdown();
 #endif
         } else {
-          jade_shutdown();
+          ica_shutdownCPU( ctx );
         }
         break;
 
+      case ICA_PICARD:
+      case ICA_SOBI:
+        ica_shutdownCPU( ctx );
+        break;
+
       case ICA_FASTICA:
       default:
-        if (_ica_params.use_gpu) {
+        if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
           fastica_gpuShutdown();
 #endif
         } else {
-          fastica_shutdown();
+          ica_shutdownCPU( ctx );
         }
         break;
     }
 
-    _initialized = 0;
+    if (_gpu_ctx == ctx) {
+      _gpu_ctx = NULL;
+    }
+
+    ctx->initialized = 0;
+    ctx->max_var = ctx->max_obs = 0;
+    _num_active--;
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int ica_initCPU( ICAContext *ctx )
+{
+  ICAParams *params = &(ctx->params);
+  unsigned int mat_size, ok;
+  ICAPrecision precision;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Figure out which precisions we need. The mixed precision iterates in
+  // single precision and finishes up in double precision, so it needs both.
+  // Finishing JADE or SOBI in double precision would mean building all of
+  // their cumulant/lagged covariance matrices again, which costs more than
+  // running in double precision from the start, so they just do that.
+  //////////////////////////////////////////////////////////////////////////////
+  precision = params->precision;
+  if (precision == ICA_PRECISION_MIXED &&
+      (params->implem == ICA_JADE || params->implem == ICA_SOBI)) {
+    precision = ICA_PRECISION_DOUBLE;
+  }
+
+  switch (precision) {
+    case ICA_PRECISION_SINGLE:
+      ctx->use_native = ISDEF_USE_SINGLE;
+      ctx->use_alt    = !ISDEF_USE_SINGLE;
+      break;
+    case ICA_PRECISION_DOUBLE:
+      ctx->use_native = !ISDEF_USE_SINGLE;
+      ctx->use_alt    = ISDEF_USE_SINGLE;
+      break;
+    case ICA_PRECISION_MIXED:
+      ctx->use_native = ctx->use_alt = 1;
+      break;
+    case ICA_PRECISION_NATIVE:
+    default:
+      ctx->use_native = 1;
+      ctx->use_alt    = 0;
+      break;
+  }
+
+  memset( &(ctx->state), 0, sizeof(ICAState) );
+  memset( &(ctx->alt_state), 0, sizeof(ICAState) );
+  ctx->alt_X.elem = ctx->alt_W.elem = ctx->alt_A.elem = NULL;
+  ctx->alt_S.elem = ctx->alt_W_init.elem = NULL;
+  ctx->alt_mu_S = NULL;
+  ctx->dec_X.elem = ctx->dec_work = NULL;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize the implementation in each precision.
+  //////////////////////////////////////////////////////////////////////////////
+  ok = 1;
+  if (ctx->use_native) {
+    switch (params->implem) {
+      case ICA_JADE:
+        ok = jade_init( &(ctx->state.jade), params );
+        break;
+      case ICA_PICARD:
+        ok = picard_init( &(ctx->state.picard), params );
+        break;
+      case ICA_SOBI:
+        ok = sobi_init( &(ctx->state.sobi), params );
+        break;
+      case ICA_FASTICA:
+      default:
+        ok = fastica_init( &(ctx->state.fastica), params );
+        break;
+    }
+  }
+
+  if (ok && ctx->use_alt) {
+    switch (params->implem) {
+      case ICA_JADE:
+        ok = jade_init_alt( &(ctx->alt_state.jade), params );
+        break;
+      case ICA_PICARD:
+        ok = picard_init_alt( &(ctx->alt_state.picard), params );
+        break;
+      case ICA_SOBI:
+        ok = sobi_init_alt( &(ctx->alt_state.sobi), params );
+        break;
+      case ICA_FASTICA:
+      default:
+        ok = fastica_init_alt( &(ctx->alt_state.fastica), params );
+        break;
+    }
+
+    // The alternate precision copies of the inputs and outputs.
+    mat_size = params->num_var * params->num_var;
+    ctx->alt_X.elem = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) *
+                                             params->num_var * params->num_obs );
+    ctx->alt_S.elem = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) *
+                                             params->num_var * params->num_obs );
+    ctx->alt_W.elem = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) * mat_size );
+    ctx->alt_A.elem = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) * mat_size );
+    ctx->alt_W_init.elem = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) *
+                                                  mat_size );
+    ctx->alt_mu_S = (NUMTYPE_ALT*) malloc( sizeof(NUMTYPE_ALT) *
+                                           params->num_var );
+
+    if (!ctx->alt_X.elem || !ctx->alt_S.elem || !ctx->alt_W.elem ||
+        !ctx->alt_A.elem || !ctx->alt_W_init.elem || !ctx->alt_mu_S) {
+      ok = 0;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The decimated observations are run through the implementation like any
+  // other, so its workspace (sized for all of the observations) has room for
+  // them.
+  //////////////////////////////////////////////////////////////////////////////
+  if (ok && params->decimate > 1) {
+    ctx->dec_X.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var *
+                                         ((params->num_obs + params->decimate
+                                           - 1) / params->decimate) );
+    ctx->dec_work = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                       (DECIMATE_TAPS( params->decimate ) +
+                                        params->num_var) );
+
+    if (!ctx->dec_X.elem || !ctx->dec_work) {
+      ok = 0;
+    }
+  }
+
+  if (!ok) {
+    ica_shutdownCPU( ctx );
+  }
+
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void ica_shutdownCPU( ICAContext *ctx )
+{
+  // A workspace that failed to initialize is left NULL, and the shutdown
+  // functions do nothing with a NULL workspace.
+  if (ctx->use_native) {
+    switch (ctx->params.implem) {
+      case ICA_JADE:    jade_shutdown( ctx->state.jade );         break;
+      case ICA_PICARD:  picard_shutdown( ctx->state.picard );     break;
+      case ICA_SOBI:    sobi_shutdown( ctx->state.sobi );         break;
+      case ICA_FASTICA:
+      default:          fastica_shutdown( ctx->state.fastica );   break;
+    }
+  }
+
+  if (ctx->use_alt) {
+    switch (ctx->params.implem) {
+      case ICA_JADE:    jade_shutdown_alt( ctx->alt_state.jade );       break;
+      case ICA_PICARD:  picard_shutdown_alt( ctx->alt_state.picard );   break;
+      case ICA_SOBI:    sobi_shutdown_alt( ctx->alt_state.sobi );       break;
+      case ICA_FASTICA:
+      default:          fastica_shutdown_alt( ctx->alt_state.fastica ); break;
+    }
+
+    free( ctx->alt_X.elem );      ctx->alt_X.elem = NULL;
+    free( ctx->alt_S.elem );      ctx->alt_S.elem = NULL;
+    free( ctx->alt_W.elem );      ctx->alt_W.elem = NULL;
+    free( ctx->alt_A.elem );      ctx->alt_A.elem = NULL;
+    free( ctx->alt_W_init.elem ); ctx->alt_W_init.elem = NULL;
+    free( ctx->alt_mu_S );        ctx->alt_mu_S = NULL;
+  }
+
+  free( ctx->dec_X.elem ); ctx->dec_X.elem = NULL;
+  free( ctx->dec_work );   ctx->dec_work = NULL;
+
+  memset( &(ctx->state), 0, sizeof(ICAState) );
+  memset( &(ctx->alt_state), 0, sizeof(ICAState) );
+  ctx->use_native = ctx->use_alt = 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 unsigned int ica( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
                   Matrix const *X )
+{
+  return ica_run( &_default_ctx, W, A, S, mu_S, X, NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int ica_warm( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
+                       Matrix const *X, Matrix const *W_init )
+{
+  return ica_run( &_default_ctx, W, A, S, mu_S, X, W_init );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAStatus ica_lastStatus()
+{
+  return ica_status( &_default_ctx );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int ica_run( ICAContext *ctx, Matrix *W, Matrix *A, Matrix *S,
+                      NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init )
+{
+  return ica_runStats( ctx, W, A, S, mu_S, X, W_init, NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int ica_runStats( ICAContext *ctx, Matrix *W, Matrix *A, Matrix *S,
+                           NUMTYPE *mu_S, Matrix const *X,
+                           Matrix const *W_init, ICAWhitenStats const *stats )
 {
   ICAParams def_params;
 
+  ctx->status = ICA_STATUS_FAILED;
+
   //////////////////////////////////////////////////////////////////////////////
   // Verify that we've been initialized and with the correct settings.
   //////////////////////////////////////////////////////////////////////////////
-  if (!_initialized) {
+  if (!ctx->initialized) {
     // If we haven't already been initialized, setup the default values.
-    def_params.implem     = DEF_IMPLEM;
-    def_params.epsilon    = DEF_EPSILON;
-    def_params.contrast   = DEF_CONTRAST;
-    def_params.max_iter   = DEF_MAX_ITER;
-    def_params.num_var    = X->rows;
-    def_params.num_obs    = X->cols;
-    def_params.gpu_device = DEF_GPU_DEVICE;
-    def_params.use_gpu    = 0;
-
-    ica_init( &def_params );
+    ica_defaultParams( &def_params, X );
+    ica_configure( ctx, &def_params );
   }
 
   // Make sure that the parameters we initialized with match the size of the
-  // X matrix on which we're about to operate.
-  if (_ica_params.num_var != X->rows || _ica_params.num_obs != X->cols) {
-    // We need to reinitialize for a new observation matrix size.
-    memcpy( &def_params, &_ica_params, sizeof(ICAParams) );
+  // X matrix on which we're about to operate. ica_configure() only sets the
+  // workspace up again if it doesn't have room for X.
+  if (ctx->params.num_var != X->rows || ctx->params.num_obs != X->cols) {
+    memcpy( &def_params, &(ctx->params), sizeof(ICAParams) );
     def_params.num_var = X->rows; def_params.num_obs = X->cols;
 
-    ica_init( &def_params );
+    // ICA_AUTO may choose differently for this size.
+    if (ctx->auto_implem) {
+      def_params.implem  = ICA_AUTO;
+      def_params.use_gpu = ctx->auto_gpu;
+    }
+
+    ica_configure( ctx, &def_params );
+  }
+
+  // If the (re)initialization failed, there's nothing we can do.
+  if (!ctx->initialized) {
+    return 0;
+  }
+
+  // An initial guess at the unmixing matrix is only any use if it unmixes
+  // observations like the ones we've been given.
+  if (W_init && (W_init->cols != X->rows || W_init->rows == 0)) {
+    W_init = NULL;
+  }
+
+  // Only the CPU implementations learn from decimated observations, and only
+  // if there would be enough of them left.
+  if (!ctx->params.use_gpu && ctx->params.decimate > 1 &&
+      (X->cols + ctx->params.decimate - 1) / ctx->params.decimate > X->rows) {
+    return ica_runDecimated( ctx, W, A, S, mu_S, X, W_init );
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Launch the appropriate function.
+  // Launch the appropriate function. The GPU implementations always run to the
+  // end, and the CPU ones set the status themselves.
   //////////////////////////////////////////////////////////////////////////////
-  switch (_ica_params.implem) {
+  switch (ctx->params.implem) {
     case ICA_JADE:
-      if (_ica_params.use_gpu) {
+      if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
+        ctx->status = ICA_STATUS_CONVERGED;
         return jade_gpu( W, A, S, mu_S, X );
 #endif
       } else {
-        return jade( W, A, S, mu_S, X );
+        return ica_runCPU( ctx, W, A, S, mu_S, X, W_init, stats );
       }
 
+    case ICA_PICARD:
+    case ICA_SOBI:
+      return ica_runCPU( ctx, W, A, S, mu_S, X, W_init, stats );
+
     case ICA_FASTICA:
     default:
-      if (_ica_params.use_gpu) {
+      if (ctx->params.use_gpu) {
 #ifdef ENABLE_GPU
+        ctx->status = ICA_STATUS_CONVERGED;
         return fastica_gpu( W, A, S, mu_S, X );
 #endif
       } else {
-        return fastica( W, A, S, mu_S, X );
+        return ica_runCPU( ctx, W, A, S, mu_S, X, W_init, stats );
       }
   }
 
   // If we get here, something bad happened.
   return 0;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAStatus ica_status( ICAContext const *ctx )
+{
+  return ctx->status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAWhitenStats *ica_createStats( unsigned int num_var )
+{
+  ICAWhitenStats *stats;
+  unsigned int block_size;
+
+  if (num_var == 0) {
+    return NULL;
+  }
+
+  stats = (ICAWhitenStats*) malloc( sizeof(ICAWhitenStats) );
+  if (stats == NULL) {
+    return NULL;
+  }
+
+  // The work array holds a block of centered observations, followed by one
+  // value per variable (see updateStats()).
+  block_size = (num_var < WHITEN_BLOCK) ? WHITEN_BLOCK : num_var;
+
+  stats->num_var = num_var;
+  stats->scatter.rows = stats->scatter.cols = num_var;
+  stats->scatter.ld   = stats->scatter.lag  = num_var;
+  stats->means        = (NUMTYPE*) malloc( sizeof(NUMTYPE) * num_var );
+  stats->scatter.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * num_var*num_var );
+  stats->work = (NUMTYPE*) malloc( sizeof(NUMTYPE) * (block_size + num_var) );
+
+  if (stats->means == NULL || stats->scatter.elem == NULL ||
+      stats->work == NULL) {
+    ica_destroyStats( stats );
+    return NULL;
+  }
+
+  ica_resetStats( stats );
+  return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_resetStats( ICAWhitenStats *stats )
+{
+  stats->count = 0;
+  memset( stats->means, 0, sizeof(NUMTYPE) * stats->num_var );
+  memset( stats->scatter.elem, 0,
+          sizeof(NUMTYPE) * stats->num_var * stats->num_var );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_addStats( ICAWhitenStats *stats, Matrix const *X )
+{
+  unsigned int block_size;
+
+  if (X->rows != (int) stats->num_var) {
+    return 0;
+  }
+
+  block_size = (stats->num_var < WHITEN_BLOCK) ? WHITEN_BLOCK : stats->num_var;
+  updateStats( stats->means, &(stats->scatter), &(stats->count), X, 0,
+               stats->work, stats->work + block_size );
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_removeStats( ICAWhitenStats *stats, Matrix const *X )
+{
+  unsigned int block_size;
+
+  if (X->rows != (int) stats->num_var) {
+    return 0;
+  }
+
+  block_size = (stats->num_var < WHITEN_BLOCK) ? WHITEN_BLOCK : stats->num_var;
+  updateStats( stats->means, &(stats->scatter), &(stats->count), X, 1,
+               stats->work, stats->work + block_size );
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_destroyStats( ICAWhitenStats *stats )
+{
+  if (stats == NULL) {
+    return;
+  }
+
+  free( stats->means );
+  free( stats->scatter.elem );
+  free( stats->work );
+  free( stats );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void ica_defaultParams( ICAParams *params, Matrix const *X )
+{
+  params->implem      = DEF_IMPLEM;
+  params->epsilon     = DEF_EPSILON;
+  params->contrast    = DEF_CONTRAST;
+  params->max_iter    = DEF_MAX_ITER;
+  params->num_var     = X->rows;
+  params->num_obs     = X->cols;
+  params->gpu_device  = DEF_GPU_DEVICE;
+  params->use_gpu     = 0;
+  params->num_threads = DEF_NUM_THREADS;
+  params->num_components = DEF_NUM_COMPONENTS;
+  params->seed        = NULL;
+  params->pca_dims    = DEF_PCA_DIMS;
+  params->pca_variance = DEF_PCA_VARIANCE;
+  params->decorr      = DEF_DECORR;
+  params->num_lags    = DEF_NUM_LAGS;
+  params->precision   = DEF_PRECISION;
+  params->observer    = NULL;
+  params->observer_data = NULL;
+  params->cancel      = NULL;
+  params->time_limit  = DEF_TIME_LIMIT;
+  params->decimate    = DEF_DECIMATE;
+  params->jade_eigenmats = DEF_JADE_EIGENMATS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_batch( ICABatchItem *items, unsigned int num_items,
+               unsigned int num_workers )
+{
+  BatchData data;
+  ICAParams params;
+  unsigned int i;
+  int ok;
+
+  if (num_items == 0) {
+    return 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the largest item, so that every worker's workspace has room for any
+  // of them.
+  //////////////////////////////////////////////////////////////////////////////
+  data.max_var = data.max_obs = 0;
+  for (i = 0; i < num_items; i++) {
+    items[i].num_iter = 0;
+    items[i].status   = ICA_STATUS_FAILED;
+    if (items[i].X->rows > data.max_var) { data.max_var = items[i].X->rows; }
+    if (items[i].X->cols > data.max_obs) { data.max_obs = items[i].X->cols; }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Create one context per worker up front. The first one sets the size of
+  // the thread pool, which the workers themselves then run on.
+  //////////////////////////////////////////////////////////////////////////////
+  if (items[0].params) {
+    params = *(items[0].params);
+  } else {
+    ica_defaultParams( &params, items[0].X );
+  }
+  params.use_gpu = 0;
+  params.num_var = data.max_var;
+  params.num_obs = data.max_obs;
+
+  data.ctx = (ICAContext**) calloc( num_items, sizeof(ICAContext*) );
+  if (data.ctx == NULL) {
+    return 0;
+  }
+
+  data.ctx[0] = ica_create( &params );
+  if (data.ctx[0] == NULL) {
+    free( data.ctx );
+    return 0;
+  }
+
+  if (num_workers == 0) {
+    num_workers = tpool_numThreads();
+  }
+  if (num_workers > num_items) {
+    num_workers = num_items;
+  }
+
+  for (i = 1; i < num_workers; i++) {
+    data.ctx[i] = ica_create( &params );
+    if (data.ctx[i] == NULL) {
+      // Make do with the workers we've already got.
+      num_workers = i;
+      break;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Run the items.
+  //////////////////////////////////////////////////////////////////////////////
+  data.num_threads = params.num_threads;
+  data.items     = items;
+  data.num_items = num_items;
+  data.next_item = 0;
+  pthread_mutex_init( &data.lock, NULL );
+
+  tpool_run( ica_batchTask, &data, num_workers );
+
+  pthread_mutex_destroy( &data.lock );
+
+  for (i = 0; i < num_workers; i++) {
+    ica_destroy( data.ctx[i] );
+  }
+  free( data.ctx );
+
+  ok = 1;
+  for (i = 0; i < num_items; i++) {
+    if (items[i].status == ICA_STATUS_FAILED) {
+      ok = 0;
+    }
+  }
+
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void ica_batchTask( void *data, unsigned int task,
+                           unsigned int num_tasks )
+{
+  BatchData *d = (BatchData*) data;
+  ICAContext *ctx = d->ctx[task];
+  ICABatchItem *item;
+  ICAParams params;
+  unsigned int i;
+
+  while (1) {
+    pthread_mutex_lock( &d->lock );
+    i = d->next_item++;
+    pthread_mutex_unlock( &d->lock );
+
+    if (i >= d->num_items) {
+      break;
+    }
+    item = d->items + i;
+
+    // Configure the worker's context for this item. Sizing it for the largest
+    // item means only a change of implementation or settings sets up the
+    // workspace again. The thread pool is already running this task, so it
+    // must keep the size it was given.
+    if (item->params) {
+      params = *(item->params);
+    } else {
+      ica_defaultParams( &params, item->X );
+    }
+    params.use_gpu = 0;
+    params.num_threads = d->num_threads;
+    params.num_var = d->max_var;
+    params.num_obs = d->max_obs;
+
+    if (!ica_configure( ctx, &params )) {
+      continue;
+    }
+
+    item->num_iter = ica_run( ctx, item->W, item->A, item->S, item->mu_S,
+                              item->X, item->W_init );
+    item->status   = ctx->status;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int ica_stream( ICAParams const *params, Matrix *W, Matrix *A,
+                         NUMTYPE *mu_S, ICAStream const *stream,
+                         Matrix const *W_init, ICAStatus *status )
+{
+  ICAParams run_params;
+  ICAStatus run_status;
+  Matrix dims;
+  unsigned int num_iter;
+
+  if (params) {
+    run_params = *params;
+  } else {
+    dims.rows = stream->num_var;
+    dims.cols = stream->num_obs;
+    ica_defaultParams( &run_params, &dims );
+  }
+  run_params.num_var = stream->num_var;
+  run_params.num_obs = stream->num_obs;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The run uses the thread pool and vmath routines like any context does, so
+  // it counts as an active context while it runs.
+  //////////////////////////////////////////////////////////////////////////////
+  pthread_mutex_lock( &_lock );
+
+  if (_num_active == 0 && !tpool_init( run_params.num_threads )) {
+    pthread_mutex_unlock( &_lock );
+    if (status) { *status = ICA_STATUS_FAILED; }
+    return 0;
+  }
+  if (vmath_isa() == VMATH_AUTO) {
+    vmath_init( VMATH_AUTO );
+  }
+  _num_active++;
+
+  pthread_mutex_unlock( &_lock );
+
+  num_iter = fastica_stream( &run_params, W, A, mu_S, stream, W_init,
+                             &run_status );
+  if (status) { *status = run_status; }
+
+  pthread_mutex_lock( &_lock );
+  _num_active--;
+  if (_num_active == 0) {
+    tpool_shutdown();
+  }
+  pthread_mutex_unlock( &_lock );
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAOnline *ica_createOnline( ICAParams const *params, NUMTYPE_NATIVE forget )
+{
+  ICAOnline *online;
+
+  // Like a streamed run, an online estimate counts as an active context for
+  // as long as it exists.
+  pthread_mutex_lock( &_lock );
+
+  if (_num_active == 0 && !tpool_init( params->num_threads )) {
+    pthread_mutex_unlock( &_lock );
+    return NULL;
+  }
+  if (vmath_isa() == VMATH_AUTO) {
+    vmath_init( VMATH_AUTO );
+  }
+
+  online = fastica_createOnline( params, forget );
+  if (online) {
+    _num_active++;
+  } else if (_num_active == 0) {
+    tpool_shutdown();
+  }
+
+  pthread_mutex_unlock( &_lock );
+
+  return online;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int ica_updateOnline( ICAOnline *online, Matrix const *X )
+{
+  return fastica_updateOnline( online, X );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int ica_onlineUnmixing( ICAOnline const *online, Matrix *W,
+                                 Matrix *A, NUMTYPE *mu_S )
+{
+  return fastica_onlineUnmixing( online, W, A, mu_S );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_resetOnline( ICAOnline *online )
+{
+  fastica_resetOnline( online );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_destroyOnline( ICAOnline *online )
+{
+  if (online == NULL) {
+    return;
+  }
+
+  fastica_destroyOnline( online );
+
+  pthread_mutex_lock( &_lock );
+  _num_active--;
+  if (_num_active == 0) {
+    tpool_shutdown();
+  }
+  pthread_mutex_unlock( &_lock );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void ica_setCalibration( ICACalibration const *cal )
+{
+  pthread_mutex_lock( &_lock );
+  _calibration = cal;
+  pthread_mutex_unlock( &_lock );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int ica_runCPU( ICAContext *ctx, Matrix *W, Matrix *A,
+                                Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                Matrix const *W_init,
+                                ICAWhitenStats const *stats )
+{
+  unsigned int num_iter;
+  NUMTYPE_NATIVE time_limit;
+  struct timespec start, now;
+
+  if (!ctx->use_alt) {
+    return ica_runNative( ctx, W, A, S, mu_S, X, W_init, stats );
+  } else if (!ctx->use_native) {
+    return ica_runAlt( ctx, W, A, S, mu_S, X, W_init );
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // In the mixed precision, the single precision run comes first, and its
+  // unmixing matrix is the initial guess for the double precision run, which
+  // whitens the observations again and (having little left to do) finishes up
+  // in a few iterations. Both runs' iterations are counted. If the first run
+  // is stopped early, its results are the best we've got. Otherwise, the time
+  // limit covers both runs, so the second only gets what is left of it. Only
+  // the native precision run can use the whitening statistics.
+  //////////////////////////////////////////////////////////////////////////////
+  time_limit = ctx->params.time_limit;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+
+  if (ISDEF_USE_SINGLE) {
+    num_iter = ica_runNative( ctx, W, A, S, mu_S, X, W_init, stats );
+  } else {
+    num_iter = ica_runAlt( ctx, W, A, S, mu_S, X, W_init );
+  }
+
+  if (ctx->status == ICA_STATUS_CANCELLED ||
+      ctx->status == ICA_STATUS_DEADLINE) {
+    return num_iter;
+  }
+
+  if (time_limit > 0.0) {
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    ctx->params.time_limit -= (now.tv_sec - start.tv_sec) +
+                              (now.tv_nsec - start.tv_nsec) * 1e-9;
+    if (ctx->params.time_limit <= 0.0) {
+      ctx->params.time_limit = time_limit;
+      ctx->status = ICA_STATUS_DEADLINE;
+      return num_iter;
+    }
+  }
+
+  if (ISDEF_USE_SINGLE) {
+    num_iter += ica_runAlt( ctx, W, A, S, mu_S, X, W );
+  } else {
+    num_iter += ica_runNative( ctx, W, A, S, mu_S, X, W, stats );
+  }
+
+  ctx->params.time_limit = time_limit;
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int ica_runNative( ICAContext *ctx, Matrix *W, Matrix *A,
+                                   Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                   Matrix const *W_init,
+                                   ICAWhitenStats const *stats )
+{
+  unsigned int num_iter;
+
+  switch (ctx->params.implem) {
+    case ICA_JADE:
+      num_iter = jade( ctx->state.jade, W, A, S, mu_S, X, W_init,
+                       stats );
+      ctx->status = jade_status( ctx->state.jade );
+      break;
+    case ICA_PICARD:
+      num_iter = picard( ctx->state.picard, W, A, S, mu_S, X, W_init,
+                         stats );
+      ctx->status = picard_status( ctx->state.picard );
+      break;
+    case ICA_SOBI:
+      num_iter = sobi( ctx->state.sobi, W, A, S, mu_S, X, W_init,
+                       stats );
+      ctx->status = sobi_status( ctx->state.sobi );
+      break;
+    case ICA_FASTICA:
+    default:
+      num_iter = fastica( ctx->state.fastica, W, A, S, mu_S, X, W_init,
+                          stats );
+      ctx->status = fastica_status( ctx->state.fastica );
+      break;
+  }
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int ica_runAlt( ICAContext *ctx, Matrix *W, Matrix *A,
+                                Matrix *S, NUMTYPE *mu_S, Matrix const *X,
+                                Matrix const *W_init )
+{
+  unsigned int num_iter;
+  int i;
+  MatrixAlt *alt_W_init = NULL;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Copy the inputs into the alternate precision, and size the outputs for X.
+  //////////////////////////////////////////////////////////////////////////////
+  ctx->alt_X.rows = ctx->alt_X.ld  = X->rows;
+  ctx->alt_X.cols = ctx->alt_X.lag = X->cols;
+  ica_convert( &(ctx->alt_X), X );
+
+  ctx->alt_W.rows = ctx->alt_W.cols = ctx->alt_W.ld = ctx->alt_W.lag = X->rows;
+  ctx->alt_A.rows = ctx->alt_A.cols = ctx->alt_A.ld = ctx->alt_A.lag = X->rows;
+  ctx->alt_S.rows = ctx->alt_S.ld  = X->rows;
+  ctx->alt_S.cols = ctx->alt_S.lag = X->cols;
+
+  if (W_init) {
+    ctx->alt_W_init.rows = ctx->alt_W_init.ld  = W_init->rows;
+    ctx->alt_W_init.cols = ctx->alt_W_init.lag = W_init->cols;
+    ica_convert( &(ctx->alt_W_init), W_init );
+    alt_W_init = &(ctx->alt_W_init);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Run the implementation.
+  //////////////////////////////////////////////////////////////////////////////
+  switch (ctx->params.implem) {
+    case ICA_JADE:
+      num_iter = jade_alt( ctx->alt_state.jade, &(ctx->alt_W), &(ctx->alt_A),
+                           &(ctx->alt_S), ctx->alt_mu_S, &(ctx->alt_X),
+                           alt_W_init, NULL );
+      ctx->status = jade_status_alt( ctx->alt_state.jade );
+      break;
+    case ICA_PICARD:
+      num_iter = picard_alt( ctx->alt_state.picard, &(ctx->alt_W),
+                             &(ctx->alt_A), &(ctx->alt_S), ctx->alt_mu_S,
+                             &(ctx->alt_X), alt_W_init, NULL );
+      ctx->status = picard_status_alt( ctx->alt_state.picard );
+      break;
+    case ICA_SOBI:
+      num_iter = sobi_alt( ctx->alt_state.sobi, &(ctx->alt_W), &(ctx->alt_A),
+                           &(ctx->alt_S), ctx->alt_mu_S, &(ctx->alt_X),
+                           alt_W_init, NULL );
+      ctx->status = sobi_status_alt( ctx->alt_state.sobi );
+      break;
+    case ICA_FASTICA:
+    default:
+      num_iter = fastica_alt( ctx->alt_state.fastica, &(ctx->alt_W),
+                              &(ctx->alt_A), &(ctx->alt_S), ctx->alt_mu_S,
+                              &(ctx->alt_X), alt_W_init, NULL );
+      ctx->status = fastica_status_alt( ctx->alt_state.fastica );
+      break;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Copy the outputs back into the native precision. The implementation may
+  // have shrunk them (e.g. if it kept fewer principal components).
+  //////////////////////////////////////////////////////////////////////////////
+  W->rows = ctx->alt_W.rows; W->cols = ctx->alt_W.cols;
+  A->rows = ctx->alt_A.rows; A->cols = ctx->alt_A.cols;
+  S->rows = ctx->alt_S.rows; S->cols = ctx->alt_S.cols;
+  ica_convert( W, &(ctx->alt_W) );
+  ica_convert( A, &(ctx->alt_A) );
+  ica_convert( S, &(ctx->alt_S) );
+
+  for (i = 0; i < ctx->alt_S.rows; i++) {
+    mu_S[i] = (NUMTYPE) ctx->alt_mu_S[i];
+  }
+
+  return num_iter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int ica_runDecimated( ICAContext *ctx, Matrix *W, Matrix *A,
+                                      Matrix *S, NUMTYPE *mu_S,
+                                      Matrix const *X, Matrix const *W_init )
+{
+  unsigned int num_iter;
+  Matrix S_dec;
+
+  decimate( &(ctx->dec_X), X, ctx->params.decimate, ctx->dec_work );
+
+  // The decimated source signals are of no use to the caller, so they're put
+  // in S, which has more than enough room for them.
+  S_dec.elem = S->elem;
+  S_dec.rows = S_dec.ld  = X->rows;
+  S_dec.cols = S_dec.lag = ctx->dec_X.cols;
+
+  num_iter = ica_runCPU( ctx, W, A, &S_dec, mu_S, &(ctx->dec_X), W_init,
+                         NULL );
+
+  // Apply the unmixing matrix to all of the observations. The implementation
+  // may have shrunk W, and S along with it.
+  if (ctx->status != ICA_STATUS_FAILED) {
+    unmixObservations( S, mu_S, W, X,
+                       ctx->dec_work + DECIMATE_TAPS( ctx->params.decimate ) );
+  }
+
+  return num_iter;
+}
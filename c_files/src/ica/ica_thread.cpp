@@ -14,15 +14,25 @@ void *icaMainThread( void *data )
   Matrix *A       = thr_data->A;
   Matrix *S       = thr_data->S;
 
+  Matrix const *W_init = thr_data->W_init;
+
   NUMTYPE *mu_S = thr_data->mu_S;
 
   ICAParams const *ica_params = thr_data->ica_params;
 
-  // Initialize the ICA library.
-  ica_init( ica_params );
+  ICAContext *ctx = thr_data->ctx;
+
+  if (ctx) {
+    // Configure the context we were given, and run the ica algorithm in it.
+    ica_configure( ctx, ica_params );
+    ica_run( ctx, W, A, S, mu_S, X, W_init );
+  } else {
+    // Initialize the ICA library.
+    ica_init( ica_params );
 
-  // Run the ica algorithm.
-  ica( W, A, S, mu_S, X );
+    // Run the ica algorithm.
+    ica_warm( W, A, S, mu_S, X, W_init );
+  }
 
   // That's it!
   return NULL;
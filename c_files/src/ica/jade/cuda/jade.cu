@@ -33,7 +33,7 @@ static NUMTYPE *_d_vals = NULL;
 
 // Host memory pointers.
 static Matrix _h_white = {0}, _h_dewhite = {0}, _h_Z = {0};
-static NUMTYPE *_h_Q = NULL, *_mu_X = NULL;
+static NUMTYPE *_h_Q = NULL, *_mu_X = NULL, *_h_eig = NULL;
 
 // Dimensions used by CUDA kernel functions.
 static dim3 _grid_size(0), _block_size(0), _s1_grid(0), _s1_block(0);
@@ -131,6 +131,7 @@ int jade_gpuInit( ICAParams *params )
 
   _h_Q  = (NUMTYPE*) malloc( _mat_size * _num_cm );
   _mu_X = (NUMTYPE*) malloc( sizeof(NUMTYPE) * _num_var );
+  _h_eig = (NUMTYPE*) malloc( sizeof(NUMTYPE) * _num_var );
 
   // Return that everything went OK.
   // TODO: check for CUDA errors.
@@ -166,7 +167,8 @@ void jade_gpuShutdown()
   _d_vals = NULL;
 
   free( _h_dewhite.elem ); free( _h_white.elem ); free( _h_Q ); free( _mu_X );
-  _h_dewhite.elem = _h_white.elem = _h_Q = _mu_X = NULL;
+  free( _h_eig );
+  _h_dewhite.elem = _h_white.elem = _h_Q = _mu_X = _h_eig = NULL;
   _h_dewhite.ld = _h_dewhite.lag = _h_dewhite.rows = _h_dewhite.cols = 0;
   _h_white.ld   = _h_white.lag   = _h_white.rows   = _h_white.cols = 0;
 
@@ -201,7 +203,7 @@ unsigned int jade_gpu( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
 
   // We use the CPU for this because we don't have a convenient method for
   // getting the eigenvalue decomposition using the GPU.
-  computeWhiten( &_h_white, &_h_dewhite, &_h_Z, 1 );
+  computeWhiten( &_h_white, &_h_dewhite, &_h_Z, 1, _h_eig, 0, 0.0 );
 
   //////////////////////////////////////////////////////////////////////////////
   // Copy the things we've calculated so far to the GPU. Almost all of the rest
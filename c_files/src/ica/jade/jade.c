@@ -7,83 +7,170 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+// How many products of pairs of whitened variables jade() forms at a time. The
+// block stays in the cache while SYRK multiplies it by its own transpose, and
+// is wide enough for SYRK to run at full speed.
+#define CUMULANT_BLOCK 262144
+
 /**
- * Global variables setup in our initialization function. Setup of these
- * variables is an overhead that we shouldn't have to incur for every run of
- * the fastica() computation, since the values for these variables is dependent
- * on the ICA configuration parameters and nothing else.
+ * Everything setup in our initialization function. Setup of this state is an
+ * overhead that we shouldn't have to incur for every run of the jade()
+ * computation, since its values are dependent on the ICA configuration
+ * parameters and nothing else.
  */
-
-// The number of variables in the observations, the number of cumulant matrices
-// that we will generate, and the number of elements in a cumulant matrix.
-static unsigned int _num_var = 0;
-static unsigned int _num_cm = 0;
-static unsigned int _num_elem = 0;
-
-// Size (in bytes) of a cumulant matrix.
-static size_t _mat_size = 0;
-
-// Convenience variable used to help find mean values.
-static NUMTYPE _scale = 0.0;
-
-// Where we will store the cumulant matrices.
-static NUMTYPE *_cm_mat = NULL;
-
-// Minimum rotation angle. If we calculate an angle below this, we don't perform
-// the rotation.
-static NUMTYPE _threshold = 0.0;
-
-// Temporary workspace matrices that will be used throughout.
-static Matrix _t[6];
-#define MAT_Z         _t[1] // Matrix for zero-mean, whitened observations.
-#define MAT_TEMP      _t[2] // Matrix for temporary workspace matrix.
-#define MAT_WHITEN    _t[3] // Matrix for whitening matrix.
-#define MAT_DEWHITEN  _t[4] // Matrix for dewhitening matrix.
-#define MAT_V         _t[5] // Matrix for rotation matrix.
-
-// Storage for the means of observed variables.
-static NUMTYPE *_mu_X = NULL;
+struct JadeState {
+  // The number of variables in the observations, the number of cumulant
+  // matrices that we will generate, and the number of elements in a cumulant
+  // matrix. Memory is allocated for the number of variables we were
+  // initialized with, but if we're given fewer, or the whitening step keeps
+  // fewer principal components, jade() resets these to match for the rest of
+  // the run.
+  unsigned int num_var;
+  unsigned int num_cm;
+  unsigned int num_elem;
+
+  // Size (in bytes) of a cumulant matrix.
+  size_t mat_size;
+
+  // Convenience variable used to help find mean values (set for each run,
+  // since we may be given fewer observations than we were initialized for).
+  NUMTYPE scale;
+
+  // Where we will store the cumulant matrices.
+  NUMTYPE *cm_mat;
+
+  // The fourth moments of the whitened observations, E{zi zj zk zl}, that the
+  // cumulant matrices are made from, with a row and column for every pair of
+  // variables i >= j (num_cm x num_cm, only the upper triangle is kept), and a
+  // block of the products zi zj they are found from (num_cm rows, and as many
+  // columns as fit in CUMULANT_BLOCK values).
+  NUMTYPE *moments;
+  NUMTYPE *pairs;
+
+  // The eigenvalues of the cumulant tensor, and the pair (i, j) that each row
+  // and column of the moments stands for, when only its most significant
+  // eigenmatrices are diagonalized (see `jade_eigenmats' in ica.h).
+  NUMTYPE *pair_vals;
+  unsigned int *pair_var;
+
+  // Minimum rotation angle. If we calculate an angle below this, we don't
+  // perform the rotation. This is also set for each run.
+  NUMTYPE threshold;
+
+  // Temporary workspace matrices that will be used throughout.
+  Matrix t[7];
+
+  // Storage for the means of observed variables.
+  NUMTYPE *mu_X;
+
+  // Storage for the eigenvalues computed while whitening.
+  NUMTYPE *eig_vals;
+
+  // The most principal components to keep and the fraction of the variance
+  // they must explain.
+  unsigned int pca_dims;
+  NUMTYPE pca_variance;
+
+  // The parameters given to jade_init(), for the observer, and the monitor
+  // that reports our progress to it.
+  ICAParams const *params;
+  ICAMonitor mon;
+};
+
+// Names for the workspace matrices of the state, `st', being worked on.
+#define MAT_Z         (st->t[1]) // Matrix for zero-mean, whitened observations.
+#define MAT_TEMP      (st->t[2]) // Matrix for temporary workspace matrix.
+#define MAT_WHITEN    (st->t[3]) // Matrix for whitening matrix.
+#define MAT_DEWHITEN  (st->t[4]) // Matrix for dewhitening matrix.
+#define MAT_V         (st->t[5]) // Matrix for rotation matrix.
+#define MAT_WARM      (st->t[6]) // Matrix for applying an initial rotation.
+
+static unsigned int pairIndex( unsigned int i, unsigned int j );
+static NUMTYPE moment( Matrix const *M, unsigned int a, unsigned int b );
+static unsigned int eigenmatrices( JadeState *st, Matrix *M );
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-int jade_init( ICAParams *params )
+int jade_init( JadeState **state, ICAParams *params )
 {
-  int i;
+  int i, j;
+  JadeState *st;
 
-  _num_var  = params->num_var;
-  _num_cm   = (_num_var * (_num_var + 1)) / 2;
-  _num_elem = _num_var * _num_var;
+  *state = st = (JadeState*) calloc( 1, sizeof(JadeState) );
+  if (st == NULL) {
+    return 0;
+  }
 
-  _mat_size = sizeof(NUMTYPE) * _num_elem;
+  st->num_var  = params->num_var;
+  st->num_cm   = (st->num_var * (st->num_var + 1)) / 2;
+  st->num_elem = st->num_var * st->num_var;
 
-  _scale = 1.0 / (NUMTYPE) params->num_obs;
+  st->mat_size = sizeof(NUMTYPE) * st->num_elem;
 
-  _threshold = (1.0 / sqrt((NUMTYPE) params->num_obs)) / 100.0;
+  st->pca_dims     = params->pca_dims;
+  st->pca_variance = params->pca_variance;
+  st->params       = params;
 
   //////////////////////////////////////////////////////////////////////////////
   // Allocate memory and initialize matrices.
   //////////////////////////////////////////////////////////////////////////////
-  _cm_mat = (NUMTYPE*) malloc( _mat_size * _num_cm );
-  _mu_X   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * _num_var );
+  st->cm_mat   = (NUMTYPE*) malloc( st->mat_size * st->num_cm );
+  st->moments  = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_cm * st->num_cm );
+  st->pairs    = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                    (st->num_cm < CUMULANT_BLOCK ?
+                                     CUMULANT_BLOCK : st->num_cm) );
+  st->mu_X     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_var );
+  st->eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_var );
+
+  // The pairs are numbered the same way for any number of variables, so the
+  // table for the most variables serves for fewer.
+  st->pair_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_cm );
+  st->pair_var  = (unsigned int*) malloc( sizeof(unsigned int) * 2 *
+                                          st->num_cm );
+
+  // t[0] will be used to iterate through the cumulant matrices in cm_mat.
+  st->t[0].elem = st->cm_mat;
+  st->t[0].rows = st->t[0].cols = st->t[0].ld = st->t[0].lag = st->num_var;
+
+  // t[1] will store the zero-meaned, whitened observations, t[2] will be used
+  // to rotate them when starting from an initial guess.
+  for (i = 1; i <= 2; i++) {
+    st->t[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                       st->num_var * params->num_obs );
+    st->t[i].rows = st->t[i].ld  = st->num_var;
+    st->t[i].cols = st->t[i].lag = params->num_obs;
+  }
+
+  // t[3] will store the whitening matrix, t[4] will hold the dewhitening
+  // matrix, t[5] will hold the rotation matrix, and t[6] is used when starting
+  // from an initial guess at the unmixing matrix.
+  for (i = 3; i <= 6; i++) {
+    st->t[i].elem = (NUMTYPE*) malloc( st->mat_size );
+    st->t[i].rows = st->t[i].cols = st->t[i].ld = st->t[i].lag = st->num_var;
+  }
 
-  // _t[0] will be used to iterate through the cumulant matrices in _cm_mat.
-  _t[0].elem = _cm_mat;
-  _t[0].rows = _t[0].cols = _t[0].ld = _t[0].lag = _num_var;
+  // The moment matrix alone grows as n^4 / 4, so running out of memory is a
+  // real possibility here.
+  if (!st->cm_mat || !st->moments || !st->pairs || !st->mu_X ||
+      !st->eig_vals || !st->pair_vals || !st->pair_var) {
+    jade_shutdown( st );
+    *state = NULL;
+    return 0;
+  }
 
-  // _t[1] will store the zero-meaned, whitened observations, _t[2] will be used
-  // to help calculate the cumulant matrices.
-  for (i = 1; i <= 2; i++) {
-    _t[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
-                                    _num_var * params->num_obs );
-    _t[i].rows = _t[i].ld  = _num_var;
-    _t[i].cols = _t[i].lag = params->num_obs;
+  for (i = 1; i <= 6; i++) {
+    if (!st->t[i].elem) {
+      jade_shutdown( st );
+      *state = NULL;
+      return 0;
+    }
   }
 
-  // _t[3] will store the whitening matrix, _t[4] will hold the dewhitening
-  // matrix, and _t[5] will hold the rotation matrix.
-  for (i = 3; i <= 5; i++) {
-    _t[i].elem = (NUMTYPE*) malloc( _mat_size );
-    _t[i].rows = _t[i].cols = _t[i].ld = _t[i].lag = _num_var;
+  for (i = 0; i < st->num_var; i++) {
+    for (j = 0; j <= i; j++) {
+      st->pair_var[2 * pairIndex( i, j )    ] = i;
+      st->pair_var[2 * pairIndex( i, j ) + 1] = j;
+    }
   }
 
   // Return that everything went OK.
@@ -92,255 +179,236 @@ int jade_init( ICAParams *params )
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void jade_shutdown()
+void jade_shutdown( JadeState *st )
 {
   int i;
 
+  if (st == NULL) {
+    return;
+  }
+
   //////////////////////////////////////////////////////////////////////////////
-  // Free all allocated memory and set everything to NULL/0.
+  // Free all allocated memory, including the state itself.
   //////////////////////////////////////////////////////////////////////////////
-  free( _cm_mat ); _cm_mat = NULL;
-
-  free( _mu_X ); _mu_X = NULL;
-
-  for (i = 1; i < 6; i++) {
-    free( _t[i].elem );
-    _t[i].elem = NULL;
-    _t[i].ld = _t[i].lag = _t[i].rows = _t[i].cols = 0;
+  free( st->cm_mat );
+  free( st->moments );
+  free( st->pairs );
+  free( st->pair_vals );
+  free( st->pair_var );
+  free( st->mu_X );
+  free( st->eig_vals );
+
+  for (i = 1; i < 7; i++) {
+    free( st->t[i].elem );
   }
 
-  _num_var = _num_cm = _num_elem = _mat_size = 0;
-  _scale = _threshold = 0.0;
+  free( st );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAStatus jade_status( JadeState const *st )
+{
+  return st->mon.status;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-unsigned int jade( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
-                   Matrix const *X )
+unsigned int jade( JadeState *st, Matrix *W, Matrix *A, Matrix *S,
+                   NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                   ICAWhitenStats const *stats )
 {
   // Indexing variables.
-  unsigned int i, var_i, var_j, var, var2, row, col, sweeps, modified;
-  unsigned int p_i, q_i, pp_i, qq_i, pq_i, p, q, cm;
+  unsigned int i, var, var2, row, col, start, width, max_width, pair, sweeps;
+  unsigned int num_mats;
 
-  // Variables used in the calculation of the Jacobi rotation.
-  NUMTYPE on_diag, off_diag, GG_x, GG_z, GG_y, theta, cosine, sine, tmp1, tmp2;
-  NUMTYPE cos_sqr, sin_sqr;
+  NUMTYPE *z, *p, weight;
+  Matrix T1, T2, P, M;
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Initialize the rotation matrix to the identity matrix.
-  //////////////////////////////////////////////////////////////////////////////
-  memset( MAT_V.elem, 0, _mat_size );
-  for (i = 0; i < _num_var; i++) {
-    MAT_V.elem[i * _num_var + i] = 1.0;
-  }
+  // The outputs may have been shrunk by a previous run that kept fewer
+  // principal components, so start out with them at full size.
+  W->rows = S->rows = A->cols = X->rows;
+
+  // The workspace may have room for more variables and observations than we've
+  // been given, so size it for these ones.
+  MAT_Z.cols    = MAT_Z.lag    = X->cols;
+  MAT_TEMP.cols = MAT_TEMP.lag = X->cols;
+  MAT_DEWHITEN.rows = MAT_DEWHITEN.ld = X->rows;
+
+  st->scale     = 1.0 / (NUMTYPE) X->cols;
+  st->threshold = (1.0 / sqrt((NUMTYPE) X->cols)) / 100.0;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Make the observations zero-mean, remembering the observation means, so that
-  // we can calculate the source signal means later, and using the S matrix
-  // parameter to temporarily hold the zero-mean observations.
+  // Find the observation means and covariance (from the statistics we were
+  // given, if they're for X, and otherwise in one pass over X), remembering
+  // the means, so that we can calculate the source signal means later, and
+  // using the S matrix parameter as scratch space for the blocks of centered
+  // observations.
   //////////////////////////////////////////////////////////////////////////////
 
-  remmean( _mu_X, S, X );
+  monitorStart( &st->mon, st->params );
+
+  if (!statsCovariance( st->mu_X, &(MAT_DEWHITEN), stats, X )) {
+    meanCovariance( st->mu_X, &(MAT_DEWHITEN), X, S->elem, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_REMMEAN );
 
   //////////////////////////////////////////////////////////////////////////////
-  // Make the zero-mean observations white.
+  // Make the observations zero-mean and white.
   //////////////////////////////////////////////////////////////////////////////
 
-  whiten( &(MAT_Z), &(MAT_WHITEN), &(MAT_DEWHITEN), S, 0 );
+  st->num_var = whitenMean( &(MAT_Z), &(MAT_WHITEN), &(MAT_DEWHITEN), X,
+                            st->mu_X, S->elem, st->eig_vals, st->pca_dims,
+                            st->pca_variance );
   // MAT_Z        -> the zero-mean, white observations
   // MAT_WHITEN   -> the whitening matrix
   // MAT_DEWHITEN -> the dewhitening matrix
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Form the cumulant matrices.
-  //////////////////////////////////////////////////////////////////////////////
-  _t[0].elem = _cm_mat;
-  for (var = 0; var < _num_var; var++) {
-    // Generate the cumulant matrix of the form Qiikl.
-    // i <- var, k <- row, l <- col
-    for (col = 0; col < X->cols; col++) {
-      for (row = 0; row < X->rows; row++) {
-        i     = col * _num_var + row;
-        var_i = col * _num_var + var;
-
-        MAT_TEMP.elem[i] = (_scale *
-                            (MAT_Z.elem[var_i] *
-                             MAT_Z.elem[var_i])) *
-                           MAT_Z.elem[i];
-      }
-    }
+  // The whitening may have kept fewer principal components than there are
+  // observed variables, in which case we separate that many sources.
+  st->num_cm   = (st->num_var * (st->num_var + 1)) / 2;
+  st->num_elem = st->num_var * st->num_var;
+  st->mat_size = sizeof(NUMTYPE) * st->num_elem;
 
-    GEMM_NT( _t[0], MAT_TEMP, MAT_Z );
+  st->t[0].rows = st->t[0].cols = st->t[0].ld = st->t[0].lag = st->num_var;
+  MAT_TEMP.rows = MAT_TEMP.ld = st->num_var;
+  MAT_V.rows = MAT_V.cols = MAT_V.ld = MAT_V.lag = st->num_var;
+  MAT_WARM.rows = MAT_WARM.cols = MAT_WARM.ld = MAT_WARM.lag = st->num_var;
 
-    for (i = 0; i < _num_var; i++) {
-      var_i = i * _num_var + i;
+  W->rows = S->rows = A->cols = st->num_var;
 
-      if (i == var) {
-        _t[0].elem[var_i] -= 3.0;
-      } else {
-        _t[0].elem[var_i] -= 1.0;
-      }
-    }
+  // A guess at the unmixing matrix must have a row for every source.
+  if (W_init && W_init->rows != st->num_var) {
+    W_init = NULL;
+  }
 
-    _t[0].elem += _num_elem;
-
-    // Generate cumulant matrices of the form Qijkl.
-    // i <- var, j <- var2, k <- row, l <- col
-    for (var2 = 0; var2 < var; var2++) {
-      for (col = 0; col < X->cols; col++) {
-        for (row = 0; row < X->rows; row++) {
-          i     = col * _num_var + row;
-          var_i = col * _num_var + var;
-          var_j = col * _num_var + var2;
-
-          MAT_TEMP.elem[i] = (_scale *
-                              (MAT_Z.elem[var_i] *
-                               MAT_Z.elem[var_j])) *
-                             MAT_Z.elem[i];
-        }
-      }
+  //////////////////////////////////////////////////////////////////////////////
+  // If we were given a guess at the unmixing matrix, W_init * dewhiten is the
+  // matching rotation of the whitened observations, once its rows have been
+  // made orthonormal. Apply that rotation, R, to the whitened observations and
+  // fold it into the whitening/dewhitening matrices:
+  //    Z <- R * Z,  whiten <- R * whiten,  dewhiten <- dewhiten * R'
+  // The Jacobi sweeps below then only need to find the (small) rotation that is
+  // left over (see the weighting of the cumulant matrices below).
+  //////////////////////////////////////////////////////////////////////////////
+  if (W_init) {
+    // The cumulant matrices and MAT_TEMP haven't been filled in yet, so borrow
+    // them for scratch space.
+    T1 = st->t[0]; T1.elem = st->cm_mat;
+    T2 = st->t[0]; T2.elem = MAT_TEMP.elem;
+
+    warmRotate( &(MAT_Z), &(MAT_WHITEN), &(MAT_DEWHITEN), W_init, &(MAT_V),
+                &(MAT_WARM), &(MAT_TEMP), &T1, &T2, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_WHITEN );
 
-      GEMM_NT( _t[0], MAT_TEMP, MAT_Z );
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize the rotation matrix to the identity matrix.
+  //////////////////////////////////////////////////////////////////////////////
+  memset( MAT_V.elem, 0, st->mat_size );
+  for (i = 0; i < st->num_var; i++) {
+    MAT_V.elem[i * st->num_var + i] = 1.0;
+  }
 
-      _t[0].elem[ var * _num_var + var2 ] -= 1.0;
-      _t[0].elem[ var2 * _num_var + var ] -= 1.0;
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the fourth moments of the whitened observations. If P holds the
+  // products zi zj of every pair of variables i >= j, a row for each pair and a
+  // column for each observation, the moments are the elements of P * P' / T.
+  // P is formed a block of observations at a time and SYRK adds up its
+  // products, so Z is read once, and every moment is found once, rather than
+  // in each of the (up to) four cumulant matrices it appears in.
+  //////////////////////////////////////////////////////////////////////////////
+  M.elem = st->moments;
+  M.rows = M.cols = M.ld = M.lag = st->num_cm;
+  for (col = 0; col < st->num_cm; col++) {
+    memset( M.elem + col * M.ld, 0, sizeof(NUMTYPE) * (col + 1) );
+  }
 
-      _t[0].elem += _num_elem;
+  P.elem = st->pairs;
+  P.rows = P.ld = st->num_cm;
+  max_width = (st->num_cm < CUMULANT_BLOCK) ? CUMULANT_BLOCK / st->num_cm : 1;
+
+  for (start = 0; start < X->cols && !monitorStop( &st->mon ); start += width) {
+    width = X->cols - start;
+    if (width > max_width) { width = max_width; }
+    P.cols = P.lag = width;
+
+    // The pairs are in the same order as the cumulant matrices (see
+    // pairIndex()).
+    for (col = 0; col < width; col++) {
+      z = MAT_Z.elem + (start + col) * MAT_Z.ld;
+      p = P.elem + col * P.ld;
+      for (var = 0; var < st->num_var; var++) {
+        *p++ = z[var] * z[var];
+        for (var2 = 0; var2 < var; var2++) {
+          *p++ = z[var] * z[var2];
+        }
+      }
     }
+
+    SYRK_ADD( M, P );
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Begin performing Jacobi sweeps in an attempt to diagonalize all cumulant
-  // matrices simulaneously.
+  // Form the cumulant matrices from the moments. For whitened observations,
+  // the (k, l)'th element of the cumulant matrix Qij is
+  //    E{zi zj zk zl} - d(i,j) d(k,l) - d(i,k) d(j,l) - d(i,l) d(j,k)
+  // where d(a,b) is one when a == b and zero otherwise. The Qij with i != j
+  // are weighted by sqrt(2), which makes them the images of an orthonormal
+  // basis of the symmetric matrices (as in eigenmatrices()). The JADE
+  // criterion then doesn't depend on how the whitened observations have been
+  // rotated, so a good initial guess leaves little to do. Or, if we've been
+  // asked to, form only the n most significant eigenmatrices of the cumulant
+  // tensor in their place.
   //////////////////////////////////////////////////////////////////////////////
-  sweeps   = 0;
-  modified = 1;
-  while (sweeps < 100 && modified) {
-    modified = 0;
-    sweeps++;
-
-    // Attempt to zero out all off diagonal elements. The cumulant matrices are
-    // all symmetric, so we only need to work on either the upper or lower
-    // triangle of the matrices. We arbitrarily choose the upper.
-    for (p = 0; p < _num_var - 1; p++) {
-      for (q = p + 1; q < _num_var; q++) {
-        // The core of this double loop attempts to minimize the p,q'th element
-        // in each cumulant matrix. It takes a lot of algebra to explain why
-        // this calculation is valid--too much to put into these comments.
-
-        // Find the sum of the difference between diagonal elements and the sum
-        // of the off diagonal elements (the matrices are symmetric, so we just
-        // multiply the upper off diagonal by two).
-        GG_x = 0.0f;
-        GG_y = 0.0f;
-        GG_z = 0.0f;
-        for (cm = 0; cm < _num_cm; cm++) {
-          pp_i = cm * _num_elem + p * _num_var + p; // row p, column p
-          qq_i = cm * _num_elem + q * _num_var + q; // row q, column q
-          pq_i = cm * _num_elem + q * _num_var + p; // row p, column q
-
-          on_diag  = _cm_mat[pp_i] - _cm_mat[qq_i];
-          off_diag = _cm_mat[pq_i] * 2.0;
-          GG_x += on_diag  * on_diag;
-          GG_y += on_diag  * off_diag;
-          GG_z += off_diag * off_diag;
-        }
-
-        on_diag  = GG_x - GG_z;
-        off_diag = GG_y * 2.0;
-
-        // Find the angle of rotation to be performed. It is possible to find
-        // this angle using only multiply/divides, but experiments showed that
-        // timing was roughly the same, so we use atan2() because it's cleaner
-        // code.
-        theta = 0.5 * atan2( off_diag, on_diag +
-                             sqrt(on_diag * on_diag + off_diag * off_diag));
-
-        // Only perform a rotation if it is 'statistically relavent'.
-        if (fabs( theta ) > _threshold) {
-          modified = 1;
-          cosine   = cos( theta );
-          sine     = sin( theta );
-
-          //////////////////////////////////////////////////////////////////////
-          // We only need to update the upper triangle of the cumulant matrices.
-          //////////////////////////////////////////////////////////////////////
-
-          // For each cumulant matrix...
-          for (i = 0; i < _num_cm; i++) {
-            // Update the p,q'th, p,p'th, and q,q'th elements.
-            pp_i = p * _num_var + p + _num_elem * i; // row p, column p
-            qq_i = q * _num_var + q + _num_elem * i; // row q, column q
-            pq_i = q * _num_var + p + _num_elem * i; // row p, column q
-
-            cos_sqr = cosine * cosine;
-            sin_sqr =   sine *   sine;
-
-            tmp1 = _cm_mat[pp_i];
-            tmp2 =  2.0 * cosine * sine * _cm_mat[pq_i];
-
-            _cm_mat[pq_i] = (cos_sqr - sin_sqr) * _cm_mat[pq_i] +
-                           cosine * sine * (_cm_mat[qq_i] - _cm_mat[pp_i]);
-            _cm_mat[pp_i] = cos_sqr * tmp1 + sin_sqr * _cm_mat[qq_i] + tmp2;
-            _cm_mat[qq_i] = sin_sqr * tmp1 + cos_sqr * _cm_mat[qq_i] - tmp2;
-
-            // Update the elements in columns p and q that are above the p'th
-            // row.
-            for (row = 0; row < p; row++) {
-              p_i = p * _num_var + row + _num_elem * i;
-              q_i = q * _num_var + row + _num_elem * i;   // Update (example):
-                                                        // * * x * * x *
-              tmp1 = cosine * _cm_mat[p_i];              // * * x * * x *
-              tmp2 =  -sine * _cm_mat[p_i];              // * * + * * + *
-                                                        // * * * * * * *
-              _cm_mat[p_i] = tmp1 +   sine * _cm_mat[q_i];// * * * * * * *
-              _cm_mat[q_i] = tmp2 + cosine * _cm_mat[q_i];// * * * * * + *
-            }                                           // * * * * * * *
-
-            // Update the elements in the p'th row from just to the right of the
-            // diagonal to the q'th column, and update the elements in the q'th
-            // column from just above the diagonal up to the p'th row.
-            for (col = p + 1; col < q; col++) {
-              p_i = col * _num_var +  p  + _num_elem * i;
-              q_i = q   * _num_var + col + _num_elem * i; // Update (example):
-                                                        // * * + * * + *
-              tmp1 = cosine * _cm_mat[p_i];              // * * + * * + *
-              tmp2 =  -sine * _cm_mat[p_i];              // * * + x x + *
-                                                        // * * * * * x *
-              _cm_mat[p_i] = tmp1 +   sine * _cm_mat[q_i];// * * * * * x *
-              _cm_mat[q_i] = tmp2 + cosine * _cm_mat[q_i];// * * * * * + *
-            }                                           // * * * * * * *
-
-            // In each cumulant matrix, update the elements in rows p and q that
-            // are to the right of the q'th column.
-            for (col = q + 1; col < _num_var; col++) {
-              p_i = col * _num_var + p + _num_elem * i;
-              q_i = col * _num_var + q + _num_elem * i;   // Update (example):
-                                                        // * * + * * + *
-              tmp1 = cosine * _cm_mat[p_i];              // * * + * * + *
-              tmp2 =  -sine * _cm_mat[p_i];              // * * + + + + x
-                                                        // * * * * * + *
-              _cm_mat[p_i] = tmp1 +   sine * _cm_mat[q_i];// * * * * * + *
-              _cm_mat[q_i] = tmp2 + cosine * _cm_mat[q_i];// * * * * * + x
-            }                                           // * * * * * * *
+  num_mats = st->num_cm;
+  if (st->params->jade_eigenmats) {
+    if (!monitorStop( &st->mon )) {
+      num_mats = eigenmatrices( st, &M );
+    }
+  } else {
+    st->t[0].elem = st->cm_mat;
+    for (var = 0; var < st->num_var && !monitorStop( &st->mon ); var++) {
+      // The cumulant matrix Qiikl comes first, then the Qijkl for j < i.
+      // i <- var, j <- var2, k <- row, l <- col
+      for (i = 0; i <= var; i++) {
+        var2 = (i == 0) ? var : i - 1;
+        pair = pairIndex( var, var2 );
+        weight = (var == var2) ? 1.0 : M_SQRT2;
+
+        for (col = 0; col < st->num_var; col++) {
+          for (row = 0; row < st->num_var; row++) {
+            st->t[0].elem[col * st->num_var + row] =
+              weight * st->scale * moment( &M, pair, pairIndex( row, col ) );
           }
+        }
 
-          //////////////////////////////////////////////////////////////////////
-          // Update the rotation matrix.
-          //////////////////////////////////////////////////////////////////////
-
-          for (row = 0; row < _num_var; row++) {
-            p_i = p * _num_var + row; // row 'row', column p of V matrix
-            q_i = q * _num_var + row; // row 'row', column q of V matrix
-
-            tmp1            = cosine * MAT_V.elem[p_i] + sine * MAT_V.elem[q_i];
-            MAT_V.elem[q_i] = cosine * MAT_V.elem[q_i] - sine * MAT_V.elem[p_i];
-            MAT_V.elem[p_i] = tmp1;
+        if (var == var2) {
+          for (row = 0; row < st->num_var; row++) {
+            st->t[0].elem[row * st->num_var + row] -= (row == var) ? 3.0 : 1.0;
           }
+        } else {
+          st->t[0].elem[ var * st->num_var + var2 ] -= weight;
+          st->t[0].elem[ var2 * st->num_var + var ] -= weight;
         }
+
+        st->t[0].elem += st->num_elem;
       }
     }
   }
+  monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Perform Jacobi sweeps in an attempt to diagonalize all cumulant matrices
+  // simultaneously, accumulating the rotations in MAT_V. If we were told to
+  // stop before the cumulant matrices were all formed, the best we can do is
+  // the (identity) rotation we've got.
+  //////////////////////////////////////////////////////////////////////////////
+  sweeps = 0;
+  if (!monitorStop( &st->mon )) {
+    sweeps = jointDiagonalize( st->cm_mat, num_mats, &(MAT_V), st->threshold,
+                               &st->mon );
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // We now have a best guess at an unmixing matrix. We need to finish up our
@@ -355,7 +423,9 @@ unsigned int jade( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
   GEMM( *A, MAT_DEWHITEN, MAT_V );  // A = dewhiten * V
 
   // Recreate the source signal means.
-  GEMV( mu_S, *W, _mu_X );
+  GEMV( mu_S, *W, st->mu_X );
+  monitorPhase( &st->mon, ICA_PHASE_FINALIZE );
+  monitorFinish( &st->mon, sweeps );
 
   //////////////////////////////////////////////////////////////////////////////
   // We're done!
@@ -363,3 +433,91 @@ unsigned int jade( Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
 
   return sweeps;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int pairIndex( unsigned int i, unsigned int j )
+{
+  // Pairs are ordered like the cumulant matrices: for each variable i, the
+  // pair (i, i) comes first, then (i, j) for every j < i.
+  if (i < j) {
+    return (j * (j + 1)) / 2 + i + 1;
+  } else if (i > j) {
+    return (i * (i + 1)) / 2 + j + 1;
+  }
+  return (i * (i + 1)) / 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static NUMTYPE moment( Matrix const *M, unsigned int a, unsigned int b )
+{
+  // Only the upper triangle of the moments is kept.
+  return (a <= b) ? M->elem[b * M->ld + a] : M->elem[a * M->ld + b];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned int eigenmatrices( JadeState *st, Matrix *M )
+{
+  unsigned int a, b, i, j, k, l, lo, hi, mat, pick;
+  NUMTYPE weight, value, *u, *Q;
+  unsigned int n = st->num_var;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The cumulant tensor maps a symmetric matrix N to the symmetric matrix with
+  // elements sum_kl cum(i,j,k,l) N(k,l). In the orthonormal basis of symmetric
+  // matrices with a one on the diagonal at (i, i), or 1/sqrt(2) at both (i, j)
+  // and (j, i), the tensor is the num_cm x num_cm matrix
+  //    K(a, b) = s(a) s(b) cum(a, b)
+  // where s is sqrt(2) for the pairs i != j, and one otherwise. The moments
+  // are replaced by (the upper triangle of) K.
+  //////////////////////////////////////////////////////////////////////////////
+  for (b = 0; b < st->num_cm; b++) {
+    k = st->pair_var[2 * b];
+    l = st->pair_var[2 * b + 1];
+
+    for (a = 0; a <= b; a++) {
+      i = st->pair_var[2 * a];
+      j = st->pair_var[2 * a + 1];
+
+      value = st->scale * M->elem[b * M->ld + a] -
+              ((i == j && k == l) + (i == k && j == l) + (i == l && j == k));
+      weight = ((i == j) ? 1.0 : M_SQRT2) * ((k == l) ? 1.0 : M_SQRT2);
+
+      M->elem[b * M->ld + a] = weight * value;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Keep the n eigenvectors whose eigenvalues are largest in magnitude. The
+  // eigenvalues come back in ascending order, so they are taken from either
+  // end. Each one, scaled by its eigenvalue, is turned back into a matrix.
+  //////////////////////////////////////////////////////////////////////////////
+  SYEV( *M, st->pair_vals );
+
+  lo = 0;
+  hi = st->num_cm - 1;
+  for (mat = 0; mat < n; mat++) {
+    if (fabs( st->pair_vals[lo] ) > fabs( st->pair_vals[hi] )) {
+      pick = lo++;
+    } else {
+      pick = hi--;
+    }
+
+    u = M->elem + pick * M->ld;
+    Q = st->cm_mat + mat * st->num_elem;
+    for (a = 0; a < st->num_cm; a++) {
+      i = st->pair_var[2 * a];
+      j = st->pair_var[2 * a + 1];
+
+      if (i == j) {
+        Q[i * n + i] = st->pair_vals[pick] * u[a];
+      } else {
+        Q[i * n + j] = Q[j * n + i] = st->pair_vals[pick] * u[a] / M_SQRT2;
+      }
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,664 @@
+#include "ica/ica.h"
+#include "ica/aux.h"
+#include "ica/setup.h"
+#include "ica/vmath.h"
+#include "ica/fastica/contrast.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+// How many previous steps the L-BFGS method remembers, how many times a step
+// is halved before the line search gives up, and the smallest value allowed
+// in the Hessian approximation.
+#define PICARD_MEMORY     7
+#define PICARD_LS_TRIES   10
+#define PICARD_LAMBDA_MIN 0.01
+
+// The number of Taylor series terms used to compute the exponential of a step
+// once it has been scaled down so that its norm is at most 1/2.
+#define PICARD_EXP_TERMS  8
+
+// Coefficients of the series atanh(u) / u = 1 + u^2/3 + u^4/5 + ..., cast so
+// that single precision builds don't compute the series in double precision.
+#define ATANH_C3  ((NUMTYPE) (1.0 / 3.0))
+#define ATANH_C5  ((NUMTYPE) (1.0 / 5.0))
+#define ATANH_C7  ((NUMTYPE) (1.0 / 7.0))
+#define ATANH_C9  ((NUMTYPE) (1.0 / 9.0))
+#define ATANH_C11 ((NUMTYPE) (1.0 / 11.0))
+
+/**
+ * Everything setup in our initialization function. Setup of this state is an
+ * overhead that we shouldn't have to incur for every run of the picard()
+ * computation, since its values are dependent on the ICA configuration
+ * parameters and nothing else.
+ */
+struct PicardState {
+  // Temporary workspace matrices that will be used throughout. Apart from the
+  // whitening matrices, they are all num_dims x num_dims once the observations
+  // have been whitened.
+  Matrix t[10];
+
+  // The zero-mean, whitened observations.
+  Matrix white_Z;
+
+  // The steps (s) and gradient changes (y) remembered by the L-BFGS method,
+  // oldest first, along with 1 / <s, y> for each pair.
+  Matrix mem_s[PICARD_MEMORY], mem_y[PICARD_MEMORY];
+  NUMTYPE mem_rho[PICARD_MEMORY];
+  int num_mem;
+
+  // Per-component values: the mean of psi`(y) and log(2 cosh(y)) at MAT_ROT
+  // and at MAT_ROT_NEW, the sign of each component's density, and the diagonal
+  // of the Hessian approximation. Passes over the data measure log(2 cosh(y))
+  // relative to its mean at MAT_ROT, lc.
+  NUMTYPE *psid, *psid_new;
+  NUMTYPE *lc, *lc_new;
+  NUMTYPE *signs;
+  NUMTYPE *kappa;
+
+  NUMTYPE *eig_vals;            // Where we store computed eigen values.
+  ContrastWork cwork;           // Scratch space for tiledContrast().
+  NUMTYPE  epsilon;             // Convergence epsilon.
+  int max_iter;                 // Max number of iterations to perform.
+  unsigned int pca_dims;        // Most principal components to keep.
+  NUMTYPE pca_variance;         // Fraction of the variance to keep.
+  ICAMonitor mon;               // Reports our progress to the observer.
+  ICAParams const *params;      // The parameters given to picard_init().
+};
+
+// Names for the workspace matrices of the state, `st', being worked on.
+#define MAT_WHITEN    (st->t[0]) // Matrix for whitening matrix.
+#define MAT_DEWHITEN  (st->t[1]) // Matrix for dewhitening matrix.
+#define MAT_ROT       (st->t[2]) // The current rotation of the whitened data.
+#define MAT_ROT_NEW   (st->t[3]) // The rotation being tried by the line search.
+#define MAT_G         (st->t[4]) // The relative gradient at MAT_ROT.
+#define MAT_G_NEW     (st->t[5]) // The relative gradient at MAT_ROT_NEW.
+#define MAT_DIR       (st->t[6]) // The search direction (then the step taken).
+#define MAT_EXP       (st->t[7]) // The exponential of a step.
+#define MAT_TEMP1     (st->t[8]) // Matrix for temporary workspace matrix.
+#define MAT_TEMP2     (st->t[9]) // Matrix for temporary workspace matrix.
+
+static void evaluate( PicardState *st, Matrix *G, NUMTYPE *psid, NUMTYPE *lc,
+                      Matrix const *R );
+static int lineSearch( PicardState *st, double loss, int *num_passes );
+static void lbfgsDirection( PicardState *st );
+static void expSkew( PicardState *st, Matrix *E, Matrix const *D,
+                     NUMTYPE scale );
+static void nonlin_picard( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                           void *data );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int picard_init( PicardState **state, ICAParams *params )
+{
+  int i;
+  size_t mat_size;
+  PicardState *st;
+
+  *state = st = (PicardState*) calloc( 1, sizeof(PicardState) );
+  if (st == NULL) {
+    return 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize configuration parameters.
+  //////////////////////////////////////////////////////////////////////////////
+  st->epsilon  = params->epsilon;
+  st->max_iter = params->max_iter;
+
+  st->pca_dims     = params->pca_dims;
+  st->pca_variance = params->pca_variance;
+  st->params       = params;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate memory.
+  //////////////////////////////////////////////////////////////////////////////
+  mat_size = sizeof(NUMTYPE) * params->num_var * params->num_var;
+
+  st->eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->psid     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->psid_new = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->lc       = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->lc_new   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->signs    = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+  st->kappa    = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var );
+
+  st->white_Z.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * params->num_var *
+                                        params->num_obs );
+  st->white_Z.cols = st->white_Z.lag = params->num_obs;
+  st->white_Z.rows = st->white_Z.ld  = params->num_var;
+
+  for (i = 0; i < sizeof(st->t) / sizeof(Matrix); i++) {
+    st->t[i].elem = (NUMTYPE*) malloc( mat_size );
+    st->t[i].rows = st->t[i].cols = params->num_var;
+    st->t[i].ld   = st->t[i].lag  = params->num_var;
+  }
+
+  for (i = 0; i < PICARD_MEMORY; i++) {
+    st->mem_s[i].elem = (NUMTYPE*) malloc( mat_size );
+    st->mem_y[i].elem = (NUMTYPE*) malloc( mat_size );
+    st->mem_s[i].rows = st->mem_s[i].cols = st->mem_s[i].ld = params->num_var;
+    st->mem_y[i].rows = st->mem_y[i].cols = st->mem_y[i].ld = params->num_var;
+    st->mem_s[i].lag  = st->mem_y[i].lag  = params->num_var;
+  }
+  st->num_mem = 0;
+
+  // Each pass over the data accumulates two statistics per component: the sum
+  // of psi`(y) and the sum of log(2 cosh(y)).
+  if (!contrast_initWork( &st->cwork, params->num_var, params->num_obs,
+                          2, 0 )) {
+    picard_shutdown( st );
+    *state = NULL;
+    return 0;
+  }
+
+  // All done. Return that things went OK.
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void picard_shutdown( PicardState *st )
+{
+  int i;
+
+  if (st == NULL) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Free all allocated memory, including the state itself.
+  //////////////////////////////////////////////////////////////////////////////
+  free( st->eig_vals );
+  free( st->psid );
+  free( st->psid_new );
+  free( st->lc );
+  free( st->lc_new );
+  free( st->signs );
+  free( st->kappa );
+
+  free( st->white_Z.elem );
+
+  for (i = 0; i < sizeof(st->t) / sizeof(Matrix); i++) {
+    free( st->t[i].elem );
+  }
+
+  for (i = 0; i < PICARD_MEMORY; i++) {
+    free( st->mem_s[i].elem );
+    free( st->mem_y[i].elem );
+  }
+
+  contrast_freeWork( &st->cwork );
+
+  free( st );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAStatus picard_status( PicardState const *st )
+{
+  return st->mon.status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int picard( PicardState *st, Matrix *W, Matrix *A, Matrix *S,
+                     NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                     ICAWhitenStats const *stats )
+{
+  int num_iter, num_passes, sign_change, i, row, col;
+  unsigned int num_dims;
+  NUMTYPE sign, max, g, *tmp;
+  double loss;
+  Matrix init;
+
+  // The initial guess may be the W parameter itself, so remember its size
+  // before we change it.
+  if (W_init) {
+    init = *W_init;
+    W_init = &init;
+  }
+
+  // The outputs may have been shrunk by a previous run, so start out with them
+  // at full size.
+  W->rows = S->rows = A->cols = X->rows;
+
+  // The workspace may have room for more variables and observations than we've
+  // been given, so size it for these ones.
+  st->white_Z.cols = st->white_Z.lag = X->cols;
+  MAT_DEWHITEN.rows = MAT_DEWHITEN.ld = X->rows;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the observation means and covariance (from the statistics we were
+  // given, if they're for X, and otherwise in one pass over X), temporarily
+  // recommissioning the mu_S array to store the observation means, so that we
+  // can calculate the source signal means later, and using the S matrix
+  // parameter as scratch space for the blocks of centered observations. Then
+  // make them zero-mean and white, keeping only the principal components
+  // we've been asked to keep.
+  //////////////////////////////////////////////////////////////////////////////
+  monitorStart( &st->mon, st->params );
+
+  if (!statsCovariance( mu_S, &MAT_DEWHITEN, stats, X )) {
+    meanCovariance( mu_S, &MAT_DEWHITEN, X, S->elem, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_REMMEAN );
+
+  num_dims = whitenMean( &st->white_Z, &MAT_WHITEN, &MAT_DEWHITEN, X, mu_S,
+                         S->elem, st->eig_vals, st->pca_dims,
+                         st->pca_variance );
+  monitorPhase( &st->mon, ICA_PHASE_WHITEN );
+
+  // From here on, we're working with num_dims whitened variables, so the
+  // rotation and all of its workspaces are num_dims x num_dims.
+  for (i = 2; i < sizeof(st->t) / sizeof(Matrix); i++) {
+    st->t[i].rows = st->t[i].cols = st->t[i].ld = st->t[i].lag = num_dims;
+  }
+  for (i = 0; i < PICARD_MEMORY; i++) {
+    st->mem_s[i].rows = st->mem_s[i].cols = num_dims;
+    st->mem_s[i].ld   = st->mem_s[i].lag  = num_dims;
+    st->mem_y[i].rows = st->mem_y[i].cols = num_dims;
+    st->mem_y[i].ld   = st->mem_y[i].lag  = num_dims;
+  }
+  W->rows = S->rows = A->cols = num_dims;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize our guess at the rotation. If we were given a guess at the
+  // unmixing matrix for the original observations, then W_init * dewhiten is
+  // the matching guess for the whitened observations, once its rows have been
+  // made orthonormal. Otherwise, start from the identity matrix.
+  //////////////////////////////////////////////////////////////////////////////
+  if (W_init && W_init->rows == num_dims) {
+    GEMM( MAT_TEMP1, *W_init, MAT_DEWHITEN );
+    symDecorrelate( &MAT_ROT, &MAT_TEMP1, &MAT_TEMP2, &MAT_EXP, st->eig_vals );
+  } else {
+    memset( MAT_ROT.elem, 0, sizeof(NUMTYPE) * num_dims * num_dims );
+    for (i = 0; i < num_dims; i++) {
+      MAT_ROT.elem[i * num_dims + i] = 1.0;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Minimize the negative log-likelihood of the rotated data, Y = R * Z, over
+  // rotations R, using the L-BFGS method on the relative gradient
+  //
+  //    G = (E{psi(Y) * Y'} - E{psi(Y) * Y'}') / 2
+  //
+  // where psi(y) = +/- tanh(y), the sign of each component chosen so that its
+  // density is super-Gaussian (log cosh) or sub-Gaussian, whichever fits it
+  // best. Each evaluation of the loss and the gradient takes a single pass
+  // over the data, and an accepted step is usually the only pass an iteration
+  // needs.
+  //////////////////////////////////////////////////////////////////////////////
+  memset( st->lc, 0, sizeof(NUMTYPE) * num_dims );
+  evaluate( st, &MAT_G, st->psid, st->lc, &MAT_ROT );
+  num_passes = 1;
+  st->num_mem = 0;
+
+  for (num_iter = 0; num_iter < st->max_iter; num_iter++) {
+    ////////////////////////////////////////////////////////////////////////////
+    // Pick the sign of each component's density from its "kurtosis"
+    // E{psi`(y)} - E{psi(y) * y}, and flip the matching rows of the gradient.
+    // If a sign changes, the remembered steps belong to a different loss.
+    ////////////////////////////////////////////////////////////////////////////
+    sign_change = 0;
+    loss = 0.0;
+    for (row = 0; row < num_dims; row++) {
+      sign = (st->psid[row] - MAT_G.elem[row * num_dims + row] >= 0.0) ?
+             1.0 : -1.0;
+      if (num_iter > 0 && sign != st->signs[row]) {
+        sign_change = 1;
+      }
+      st->signs[row] = sign;
+
+      for (col = 0; col < num_dims; col++) {
+        MAT_G.elem[col * num_dims + row] *= sign;
+      }
+      st->kappa[row] = sign * st->psid[row] - MAT_G.elem[row * num_dims + row];
+      loss += sign * st->lc[row];
+    }
+
+    if (sign_change) {
+      st->num_mem = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Project the gradient onto the skew-symmetric matrices (the directions
+    // that keep R a rotation), and stop once it is small enough.
+    ////////////////////////////////////////////////////////////////////////////
+    max = 0.0;
+    for (col = 0; col < num_dims; col++) {
+      for (row = 0; row < col; row++) {
+        g = 0.5 * (MAT_G.elem[col * num_dims + row] -
+                   MAT_G.elem[row * num_dims + col]);
+        MAT_G.elem[col * num_dims + row] =  g;
+        MAT_G.elem[row * num_dims + col] = -g;
+        if (fabs( g ) > max) { max = fabs( g ); }
+      }
+      MAT_G.elem[col * num_dims + col] = 0.0;
+    }
+    monitorPhase( &st->mon, ICA_PHASE_ORTHO );
+    monitorReport( &st->mon, num_passes, max );
+
+    if (max < st->epsilon) {
+      break;
+    }
+
+    // Every guess is a rotation, so if we're told to stop, the current one is
+    // as good a place to stop as any.
+    if (monitorStop( &st->mon )) {
+      break;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Remember the last step and the change in the gradient it caused. Pairs
+    // with <s, y> <= 0 would make the Hessian approximation indefinite.
+    ////////////////////////////////////////////////////////////////////////////
+    if (num_iter > 0 && !sign_change) {
+      if (st->num_mem == PICARD_MEMORY) {
+        tmp = st->mem_s[0].elem;
+        for (i = 1; i < PICARD_MEMORY; i++) {
+          st->mem_s[i - 1].elem = st->mem_s[i].elem;
+        }
+        st->mem_s[PICARD_MEMORY - 1].elem = tmp;
+
+        tmp = st->mem_y[0].elem;
+        for (i = 1; i < PICARD_MEMORY; i++) {
+          st->mem_y[i - 1].elem = st->mem_y[i].elem;
+          st->mem_rho[i - 1] = st->mem_rho[i];
+        }
+        st->mem_y[PICARD_MEMORY - 1].elem = tmp;
+
+        st->num_mem--;
+      }
+
+      g = 0.0;
+      for (i = 0; i < num_dims * num_dims; i++) {
+        st->mem_s[st->num_mem].elem[i] = MAT_DIR.elem[i];
+        st->mem_y[st->num_mem].elem[i] = MAT_G.elem[i] - MAT_G_NEW.elem[i];
+        g += MAT_DIR.elem[i] * st->mem_y[st->num_mem].elem[i];
+      }
+
+      if (g > 0.0) {
+        st->mem_rho[st->num_mem++] = 1.0 / g;
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Find the search direction and take a step along it. If no step along it
+    // decreases the loss, fall back to the gradient and forget the remembered
+    // steps.
+    ////////////////////////////////////////////////////////////////////////////
+    lbfgsDirection( st );
+
+    if (!lineSearch( st, loss, &num_passes )) {
+      for (i = 0; i < num_dims * num_dims; i++) {
+        MAT_DIR.elem[i] = -MAT_G.elem[i];
+      }
+      st->num_mem = 0;
+
+      lineSearch( st, loss, &num_passes );
+    }
+
+    // Accept the step. MAT_G_NEW is left holding the gradient from before the
+    // step, so that its change can be remembered.
+    tmp = MAT_ROT.elem; MAT_ROT.elem = MAT_ROT_NEW.elem; MAT_ROT_NEW.elem = tmp;
+    tmp = MAT_G.elem;   MAT_G.elem   = MAT_G_NEW.elem;   MAT_G_NEW.elem   = tmp;
+    tmp = st->psid; st->psid = st->psid_new; st->psid_new = tmp;
+    tmp = st->lc;   st->lc   = st->lc_new;   st->lc_new   = tmp;
+  }
+
+  if (num_iter == st->max_iter) {
+    monitorMaxIter( &st->mon );
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // We now have a best guess at the rotation. We need to finish up our
+  // computations by computing the source signals, the source signal mixing
+  // matrix, the unmixing matrix that will unmix the original, nonwhitened
+  // observations, and the means of the source signals.
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Every step multiplied the rotation by another rotation, so it has only
+  // picked up rounding error, which making its rows orthonormal removes.
+  symDecorrelate( &MAT_ROT_NEW, &MAT_ROT, &MAT_TEMP1, &MAT_TEMP2,
+                  st->eig_vals );
+
+  // Finish the computations for A, W, and S.
+  GEMM_NT( *A, MAT_DEWHITEN, MAT_ROT_NEW );
+  GEMM( *W, MAT_ROT_NEW, MAT_WHITEN );
+  GEMM( *S, MAT_ROT_NEW, st->white_Z );
+
+  // Compute the mean values of the signal vectors by unmixing the mean values
+  // of the observation vectors.
+  GEMV( st->eig_vals, *W, mu_S );
+  memcpy( mu_S, st->eig_vals, sizeof(NUMTYPE) * S->rows );
+  monitorPhase( &st->mon, ICA_PHASE_FINALIZE );
+  monitorFinish( &st->mon, num_passes );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // And that's it!
+  //////////////////////////////////////////////////////////////////////////////
+
+  return num_passes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void evaluate( PicardState *st, Matrix *G, NUMTYPE *psid, NUMTYPE *lc,
+                      Matrix const *R )
+{
+  int row, n = R->rows;
+  NUMTYPE scale = 1.0 / (NUMTYPE) st->white_Z.cols;
+
+  // Everything since the last evaluation was spent finding R.
+  monitorPhase( &st->mon, ICA_PHASE_ORTHO );
+
+  // Find psi(R * Z) * Z' in a single pass over the data, along with the sums of
+  // psi`(R * Z) and log(2 cosh(R * Z)) along each row. Then, since Y = R * Z,
+  // E{psi(Y) * Y'} = psi(R * Z) * Z' * R' / T.
+  tiledContrast( &MAT_TEMP1, st->cwork.sums, 2, R, &st->white_Z, nonlin_picard,
+                 st->lc, &st->cwork );
+  GEMM_NT( *G, MAT_TEMP1, *R );
+
+  for (row = 0; row < n * n; row++) {
+    G->elem[row] *= scale;
+  }
+
+  for (row = 0; row < n; row++) {
+    psid[row] = scale * st->cwork.sums[row];
+    lc[row]   = st->lc[row] + scale * st->cwork.sums[n + row];
+  }
+  monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int lineSearch( PicardState *st, double loss, int *num_passes )
+{
+  int tries, row;
+  NUMTYPE alpha;
+  double new_loss;
+
+  // Try R_new = expm(alpha * D) * R, halving alpha until the loss decreases.
+  // Whatever the outcome, MAT_ROT_NEW and friends are left holding the last
+  // step tried, and MAT_DIR holds that step.
+  alpha = 1.0;
+  for (tries = 0; tries < PICARD_LS_TRIES; tries++) {
+    expSkew( st, &MAT_EXP, &MAT_DIR, alpha );
+    GEMM( MAT_ROT_NEW, MAT_EXP, MAT_ROT );
+    evaluate( st, &MAT_G_NEW, st->psid_new, st->lc_new, &MAT_ROT_NEW );
+    (*num_passes)++;
+
+    new_loss = 0.0;
+    for (row = 0; row < MAT_ROT.rows; row++) {
+      new_loss += st->signs[row] * st->lc_new[row];
+    }
+
+    if (new_loss < loss) {
+      break;
+    }
+
+    if (tries + 1 < PICARD_LS_TRIES) {
+      alpha *= 0.5;
+    }
+  }
+
+  for (row = 0; row < MAT_DIR.rows * MAT_DIR.cols; row++) {
+    MAT_DIR.elem[row] *= alpha;
+  }
+
+  return tries < PICARD_LS_TRIES;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void lbfgsDirection( PicardState *st )
+{
+  int i, j, k, n = MAT_G.rows, num_elem = MAT_G.rows * MAT_G.cols;
+  NUMTYPE a[PICARD_MEMORY], b, h, dot;
+  NUMTYPE *q = MAT_DIR.elem;
+
+  // The two-loop recursion, starting from the gradient and using the
+  // diagonal Hessian approximation h_ij = (kappa_i + kappa_j) / 2 (kept away
+  // from zero) as the initial inverse Hessian.
+  memcpy( q, MAT_G.elem, sizeof(NUMTYPE) * num_elem );
+
+  for (k = st->num_mem - 1; k >= 0; k--) {
+    dot = 0.0;
+    for (i = 0; i < num_elem; i++) {
+      dot += st->mem_s[k].elem[i] * q[i];
+    }
+    a[k] = st->mem_rho[k] * dot;
+    for (i = 0; i < num_elem; i++) {
+      q[i] -= a[k] * st->mem_y[k].elem[i];
+    }
+  }
+
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < n; i++) {
+      h = 0.5 * (st->kappa[i] + st->kappa[j]);
+      q[j * n + i] /= (h > PICARD_LAMBDA_MIN) ? h : PICARD_LAMBDA_MIN;
+    }
+  }
+
+  for (k = 0; k < st->num_mem; k++) {
+    dot = 0.0;
+    for (i = 0; i < num_elem; i++) {
+      dot += st->mem_y[k].elem[i] * q[i];
+    }
+    b = st->mem_rho[k] * dot;
+    for (i = 0; i < num_elem; i++) {
+      q[i] += (a[k] - b) * st->mem_s[k].elem[i];
+    }
+  }
+
+  // We want to go downhill, so the direction is the negative of the result.
+  for (i = 0; i < num_elem; i++) {
+    q[i] = -q[i];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void expSkew( PicardState *st, Matrix *E, Matrix const *D,
+                     NUMTYPE scale )
+{
+  int i, k, n = D->rows, num_elem = D->rows * D->cols, num_squares;
+  NUMTYPE norm, sum;
+
+  // Scale the step down by a power of two so that its 1-norm is at most 1/2,
+  // where a few terms of the Taylor series of exp() are accurate, and then
+  // square the result back up: exp(D) = exp(D / 2^s)^(2^s).
+  norm = 0.0;
+  for (k = 0; k < n; k++) {
+    sum = 0.0;
+    for (i = 0; i < n; i++) {
+      sum += fabs( D->elem[k * n + i] );
+    }
+    if (sum > norm) { norm = sum; }
+  }
+  norm *= fabs( scale );
+
+  num_squares = 0;
+  while (norm > 0.5) {
+    norm *= 0.5;
+    scale *= 0.5;
+    num_squares++;
+  }
+
+  for (i = 0; i < num_elem; i++) {
+    MAT_TEMP1.elem[i] = scale * D->elem[i];
+  }
+
+  // Horner's rule: exp(X) ~= I + X (I + X/2 (I + X/3 (... (I + X/N)))).
+  for (i = 0; i < num_elem; i++) {
+    E->elem[i] = MAT_TEMP1.elem[i] / PICARD_EXP_TERMS;
+  }
+  for (i = 0; i < n; i++) {
+    E->elem[i * n + i] += 1.0;
+  }
+
+  for (k = PICARD_EXP_TERMS - 1; k > 0; k--) {
+    GEMM( MAT_TEMP2, MAT_TEMP1, *E );
+    for (i = 0; i < num_elem; i++) {
+      E->elem[i] = MAT_TEMP2.elem[i] / k;
+    }
+    for (i = 0; i < n; i++) {
+      E->elem[i * n + i] += 1.0;
+    }
+  }
+
+  for (k = 0; k < num_squares; k++) {
+    GEMM( MAT_TEMP2, *E, *E );
+    memcpy( E->elem, MAT_TEMP2.elem, sizeof(NUMTYPE) * num_elem );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void nonlin_picard( Matrix *Y, NUMTYPE *stats, NUMTYPE *scratch,
+                           void *data )
+{
+  int row, col, i, n = Y->rows * Y->cols;
+  NUMTYPE const *lc = (NUMTYPE const*) data;
+  NUMTYPE y, e, t, u, u2;
+
+  // Everything we need comes from e = exp(-2|y|):
+  //    tanh(y)         = sign(y) * (1 - e) / (1 + e)
+  //    log(2 cosh(y))  = |y| + log(1 + e)
+  // with log(1 + e) = 2 atanh(u) for u = e / (2 + e), which is at most 1/3,
+  // so a few terms of the series for atanh() are enough. The tile is walked
+  // as a flat array so that these loops vectorize, leaving log(2 cosh(y)) in
+  // the scratch space.
+  for (i = 0; i < n; i++) {
+    scratch[i] = -2 * fabs( Y->elem[i] );
+  }
+  vmath_exp( scratch, scratch, n );
+
+  for (i = 0; i < n; i++) {
+    y = Y->elem[i];
+    e = scratch[i];
+
+    t  = (1 - e) / (1 + e);
+    u  = e / (2 + e);
+    u2 = u * u;
+
+    scratch[i] = fabs( y ) + 2 * u * (1 + u2 * (ATANH_C3 + u2 * (ATANH_C5 +
+                 u2 * (ATANH_C7 + u2 * (ATANH_C9 + u2 * ATANH_C11)))));
+    Y->elem[i] = (y < 0) ? -t : t;
+  }
+
+  // The first statistic is the sum of psi`(y) = 1 - tanh^2(y). The second is
+  // the sum of log(2 cosh(y)) less its mean at the current rotation, so that
+  // the small changes in the loss that the line search looks for near the
+  // optimum aren't lost to rounding error in single precision.
+  for (col = 0; col < Y->cols; col++) {
+    for (row = 0; row < Y->rows; row++) {
+      i = col * Y->ld + row;
+      stats[row]           += 1 - Y->elem[i] * Y->elem[i];
+      stats[Y->rows + row] += scratch[i] - lc[row];
+    }
+  }
+}
@@ -0,0 +1,313 @@
+#include "ica/ica.h"
+#include "ica/aux.h"
+#include "ica/setup.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Everything setup in our initialization function. Setup of this state is an
+ * overhead that we shouldn't have to incur for every run of the sobi()
+ * computation, since its values are dependent on the ICA configuration
+ * parameters and nothing else.
+ */
+struct SobiState {
+  // The number of variables in the observations and the number of elements in
+  // a lagged covariance matrix. Memory is allocated for the number of variables
+  // we were initialized with, but if we're given fewer, or the whitening step
+  // keeps fewer principal components, sobi() resets these to match for the
+  // rest of the run.
+  unsigned int num_var;
+  unsigned int num_elem;
+
+  // The most time lags (and so lagged covariance matrices) to use. A run with
+  // too few observations for all of them uses fewer.
+  unsigned int num_lags;
+
+  // Where we will store the lagged covariance matrices.
+  NUMTYPE *lag_mat;
+
+  // Minimum rotation angle. If we calculate an angle below this, we don't
+  // perform the rotation. This is set for each run, since we may be given
+  // fewer observations than we were initialized for.
+  NUMTYPE threshold;
+
+  // Temporary workspace matrices that will be used throughout.
+  Matrix t[6];
+
+  // Storage for the means of observed variables.
+  NUMTYPE *mu_X;
+
+  // Storage for the eigenvalues computed while whitening.
+  NUMTYPE *eig_vals;
+
+  // The most principal components to keep and the fraction of the variance
+  // they must explain.
+  unsigned int pca_dims;
+  NUMTYPE pca_variance;
+
+  // The parameters given to sobi_init(), for the observer, and the monitor
+  // that reports our progress to it.
+  ICAParams const *params;
+  ICAMonitor mon;
+};
+
+// Names for the workspace matrices of the state, `st', being worked on.
+#define MAT_Z         (st->t[0]) // Matrix for zero-mean, whitened observations.
+#define MAT_TEMP      (st->t[1]) // Matrix for temporary workspace matrix.
+#define MAT_WHITEN    (st->t[2]) // Matrix for whitening matrix.
+#define MAT_DEWHITEN  (st->t[3]) // Matrix for dewhitening matrix.
+#define MAT_V         (st->t[4]) // Matrix for rotation matrix.
+#define MAT_WARM      (st->t[5]) // Matrix for applying an initial rotation.
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sobi_init( SobiState **state, ICAParams *params )
+{
+  int i;
+  SobiState *st;
+
+  *state = st = (SobiState*) calloc( 1, sizeof(SobiState) );
+  if (st == NULL) {
+    return 0;
+  }
+
+  st->num_var  = params->num_var;
+  st->num_elem = st->num_var * st->num_var;
+
+  // A lag must leave at least one pair of observations to compare.
+  st->num_lags = params->num_lags ? params->num_lags : DEF_NUM_LAGS;
+  if (st->num_lags >= params->num_obs) {
+    st->num_lags = (params->num_obs > 1) ? params->num_obs - 1 : 1;
+  }
+
+  st->pca_dims     = params->pca_dims;
+  st->pca_variance = params->pca_variance;
+  st->params       = params;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Allocate memory and initialize matrices.
+  //////////////////////////////////////////////////////////////////////////////
+  st->lag_mat  = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                    st->num_elem * st->num_lags );
+  st->mu_X     = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_var );
+  st->eig_vals = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_var );
+
+  // t[0] will store the zero-meaned, whitened observations, and t[1] is used
+  // to rotate them when starting from an initial guess.
+  for (i = 0; i <= 1; i++) {
+    st->t[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) *
+                                       st->num_var * params->num_obs );
+    st->t[i].rows = st->t[i].ld  = st->num_var;
+    st->t[i].cols = st->t[i].lag = params->num_obs;
+  }
+
+  // t[2] will store the whitening matrix, t[3] will hold the dewhitening
+  // matrix, t[4] will hold the rotation matrix, and t[5] is used when starting
+  // from an initial guess at the unmixing matrix.
+  for (i = 2; i <= 5; i++) {
+    st->t[i].elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * st->num_elem );
+    st->t[i].rows = st->t[i].cols = st->t[i].ld = st->t[i].lag = st->num_var;
+  }
+
+  if (!st->lag_mat || !st->mu_X || !st->eig_vals ||
+      !MAT_Z.elem || !MAT_TEMP.elem) {
+    sobi_shutdown( st );
+    *state = NULL;
+    return 0;
+  }
+
+  // Return that everything went OK.
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void sobi_shutdown( SobiState *st )
+{
+  int i;
+
+  if (st == NULL) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Free all allocated memory, including the state itself.
+  //////////////////////////////////////////////////////////////////////////////
+  free( st->lag_mat );
+  free( st->mu_X );
+  free( st->eig_vals );
+
+  for (i = 0; i < 6; i++) {
+    free( st->t[i].elem );
+  }
+
+  free( st );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+ICAStatus sobi_status( SobiState const *st )
+{
+  return st->mon.status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int sobi( SobiState *st, Matrix *W, Matrix *A, Matrix *S,
+                   NUMTYPE *mu_S, Matrix const *X, Matrix const *W_init,
+                   ICAWhitenStats const *stats )
+{
+  unsigned int i, lag, row, col, sweeps, num_lags;
+  NUMTYPE *C, sym;
+  Matrix T1, T2, Z_lag, Z_now, M;
+
+  // The outputs may have been shrunk by a previous run that kept fewer
+  // principal components, so start out with them at full size.
+  W->rows = S->rows = A->cols = X->rows;
+
+  // The workspace may have room for more variables and observations than we've
+  // been given, so size it for these ones.
+  MAT_Z.cols    = MAT_Z.lag    = X->cols;
+  MAT_TEMP.cols = MAT_TEMP.lag = X->cols;
+  MAT_DEWHITEN.rows = MAT_DEWHITEN.ld = X->rows;
+
+  st->threshold = (1.0 / sqrt((NUMTYPE) X->cols)) / 100.0;
+
+  // A lag must leave at least one pair of observations to compare.
+  num_lags = st->num_lags;
+  if (num_lags >= X->cols) {
+    num_lags = (X->cols > 1) ? X->cols - 1 : 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the observation means and covariance (from the statistics we were
+  // given, if they're for X, and otherwise in one pass over X), remembering
+  // the means, so that we can calculate the source signal means later, and
+  // using the S matrix parameter as scratch space for the blocks of centered
+  // observations.
+  //////////////////////////////////////////////////////////////////////////////
+
+  monitorStart( &st->mon, st->params );
+
+  if (!statsCovariance( st->mu_X, &(MAT_DEWHITEN), stats, X )) {
+    meanCovariance( st->mu_X, &(MAT_DEWHITEN), X, S->elem, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_REMMEAN );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Make the observations zero-mean and white.
+  //////////////////////////////////////////////////////////////////////////////
+
+  st->num_var = whitenMean( &(MAT_Z), &(MAT_WHITEN), &(MAT_DEWHITEN), X,
+                            st->mu_X, S->elem, st->eig_vals, st->pca_dims,
+                            st->pca_variance );
+  // MAT_Z        -> the zero-mean, white observations
+  // MAT_WHITEN   -> the whitening matrix
+  // MAT_DEWHITEN -> the dewhitening matrix
+
+  // The whitening may have kept fewer principal components than there are
+  // observed variables, in which case we separate that many sources.
+  st->num_elem = st->num_var * st->num_var;
+
+  MAT_TEMP.rows = MAT_TEMP.ld = st->num_var;
+  MAT_V.rows = MAT_V.cols = MAT_V.ld = MAT_V.lag = st->num_var;
+  MAT_WARM.rows = MAT_WARM.cols = MAT_WARM.ld = MAT_WARM.lag = st->num_var;
+
+  W->rows = S->rows = A->cols = st->num_var;
+
+  // A guess at the unmixing matrix must have a row for every source.
+  if (W_init && W_init->rows != st->num_var) {
+    W_init = NULL;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // If we were given a guess at the unmixing matrix, fold the matching rotation
+  // of the whitened observations into the observations and the whitening/
+  // dewhitening matrices (see warmRotate()). The Jacobi sweeps below then only
+  // need to find the (small) rotation that is left over.
+  //////////////////////////////////////////////////////////////////////////////
+  if (W_init) {
+    // The lagged covariance matrices and MAT_TEMP haven't been filled in yet,
+    // so borrow them for scratch space.
+    T1 = MAT_V; T1.elem = st->lag_mat;
+    T2 = MAT_V; T2.elem = MAT_TEMP.elem;
+
+    warmRotate( &(MAT_Z), &(MAT_WHITEN), &(MAT_DEWHITEN), W_init, &(MAT_V),
+                &(MAT_WARM), &(MAT_TEMP), &T1, &T2, st->eig_vals );
+  }
+  monitorPhase( &st->mon, ICA_PHASE_WHITEN );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize the rotation matrix to the identity matrix.
+  //////////////////////////////////////////////////////////////////////////////
+  memset( MAT_V.elem, 0, sizeof(NUMTYPE) * st->num_elem );
+  for (i = 0; i < st->num_var; i++) {
+    MAT_V.elem[i * st->num_var + i] = 1.0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Form the lagged covariance matrices of the whitened observations,
+  //    C(lag) = E{ z(t + lag) * z(t)' }
+  // for lags 1 through num_lags. Each one is a single matrix product of two
+  // views of Z, offset from each other by `lag' columns. The sources are
+  // uncorrelated at every lag, so the right rotation makes every C(lag)
+  // diagonal. Only the symmetric part of C(lag) carries that information.
+  //////////////////////////////////////////////////////////////////////////////
+  M = MAT_V;
+  Z_lag = Z_now = MAT_Z;
+
+  for (lag = 1; lag <= num_lags && !monitorStop( &st->mon ); lag++) {
+    C = M.elem = st->lag_mat + (lag - 1) * st->num_elem;
+
+    Z_lag.elem = MAT_Z.elem + lag * MAT_Z.ld;
+    Z_lag.cols = Z_now.cols = MAT_Z.cols - lag;
+
+    GEMM_NT( M, Z_lag, Z_now );
+
+    for (col = 0; col < st->num_var; col++) {
+      for (row = 0; row <= col; row++) {
+        sym = 0.5 * (C[col * st->num_var + row] + C[row * st->num_var + col]) /
+              Z_now.cols;
+        C[col * st->num_var + row] = C[row * st->num_var + col] = sym;
+      }
+    }
+  }
+  monitorPhase( &st->mon, ICA_PHASE_CONTRAST );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Perform Jacobi sweeps in an attempt to diagonalize all lagged covariance
+  // matrices simultaneously, accumulating the rotations in MAT_V. As in jade(),
+  // if we were told to stop before they were all formed, we keep the rotation
+  // we've got.
+  //////////////////////////////////////////////////////////////////////////////
+  sweeps = 0;
+  if (!monitorStop( &st->mon )) {
+    sweeps = jointDiagonalize( st->lag_mat, num_lags, &(MAT_V), st->threshold,
+                               &st->mon );
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // We now have a best guess at an unmixing matrix. We need to finish up our
+  // computations by computing the source signals, the source signal mixing
+  // matrix, the unmixing matrix that will unmix the original, nonwhitened
+  // observations, and the means of the source signals.
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Finish computations for A, W, and S.
+  GEMM_TN( *S, MAT_V, MAT_Z );      // S = V' * Z
+  GEMM_TN( *W, MAT_V, MAT_WHITEN ); // W = V' * whiten_matrix
+  GEMM( *A, MAT_DEWHITEN, MAT_V );  // A = dewhiten * V
+
+  // Recreate the source signal means.
+  GEMV( mu_S, *W, st->mu_X );
+  monitorPhase( &st->mon, ICA_PHASE_FINALIZE );
+  monitorFinish( &st->mon, sweeps );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // We're done!
+  //////////////////////////////////////////////////////////////////////////////
+
+  return sweeps;
+}
@@ -0,0 +1,254 @@
+#include "ica/thread_pool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/**
+ * A job is one call to tpool_run(). Jobs live on the stack of the thread that
+ * submitted them and are linked into a queue while they still have tasks that
+ * no thread has claimed.
+ */
+typedef struct PoolJob {
+  PoolTask        task;       // The function to run.
+  void           *data;       // Data given to every task.
+  unsigned int    num_tasks;  // Total number of tasks in the job.
+  unsigned int    claimed;    // How many tasks have been claimed by a thread.
+  unsigned int    finished;   // How many tasks have completed.
+  struct PoolJob *next;       // Next job in the queue.
+} PoolJob;
+
+/**
+ * Global pool state. Everything below is protected by _lock.
+ */
+static pthread_mutex_t _lock      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  _work_cond = PTHREAD_COND_INITIALIZER; // New work.
+static pthread_cond_t  _done_cond = PTHREAD_COND_INITIALIZER; // Job finished.
+
+static pthread_t   *_workers     = NULL;  // Worker thread IDs.
+static unsigned int _num_workers = 0;     // Number of worker threads.
+static int          _stopping    = 0;     // Set when workers should exit.
+
+static PoolJob *_queue_head = NULL;       // Jobs with unclaimed tasks.
+static PoolJob *_queue_tail = NULL;
+
+static void *tpool_worker( void *unused );
+static int   tpool_claim( PoolJob *job, unsigned int *task_i );
+static void  tpool_finish( PoolJob *job );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int tpool_init( unsigned int num_threads )
+{
+  unsigned int i;
+
+  if (num_threads == 0) {
+    num_threads = tpool_numProcessors();
+  }
+
+  // Nothing to do if we're already running with this many threads.
+  if (_num_workers == num_threads - 1) {
+    return 1;
+  }
+
+  tpool_shutdown();
+
+  if (num_threads == 1) {
+    return 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Start up the worker threads. The calling thread counts as one of the
+  // threads in the pool, so we only need to start num_threads - 1 of them.
+  //////////////////////////////////////////////////////////////////////////////
+  _workers = (pthread_t*) malloc( sizeof(pthread_t) * (num_threads - 1) );
+  if (_workers == NULL) {
+    return 0;
+  }
+
+  pthread_mutex_lock( &_lock );
+  _stopping = 0;
+  for (i = 0; i < num_threads - 1; i++) {
+    if (pthread_create( &_workers[i], NULL, tpool_worker, NULL ) != 0) {
+      break;
+    }
+    _num_workers++;
+  }
+  pthread_mutex_unlock( &_lock );
+
+  return (_num_workers == num_threads - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void tpool_shutdown()
+{
+  unsigned int i;
+
+  // Tell the workers to exit and wait for them to do so.
+  pthread_mutex_lock( &_lock );
+  _stopping = 1;
+  pthread_cond_broadcast( &_work_cond );
+  pthread_mutex_unlock( &_lock );
+
+  for (i = 0; i < _num_workers; i++) {
+    pthread_join( _workers[i], NULL );
+  }
+
+  free( _workers );
+  _workers     = NULL;
+  _num_workers = 0;
+  _stopping    = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int tpool_numThreads()
+{
+  return _num_workers + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+unsigned int tpool_numProcessors()
+{
+  long num_procs = sysconf( _SC_NPROCESSORS_ONLN );
+  return (num_procs > 0 ? (unsigned int) num_procs : 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void tpool_run( PoolTask task, void *data, unsigned int num_tasks )
+{
+  unsigned int i;
+  PoolJob job;
+
+  if (num_tasks == 0) {
+    num_tasks = tpool_numThreads();
+  }
+
+  // If there is nobody to share the work with, just do it ourselves.
+  if (_num_workers == 0 || num_tasks == 1) {
+    for (i = 0; i < num_tasks; i++) {
+      task( data, i, num_tasks );
+    }
+    return;
+  }
+
+  job.task      = task;
+  job.data      = data;
+  job.num_tasks = num_tasks;
+  job.claimed   = 0;
+  job.finished  = 0;
+  job.next      = NULL;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Queue the job and wake up the workers.
+  //////////////////////////////////////////////////////////////////////////////
+  pthread_mutex_lock( &_lock );
+  if (_queue_tail) {
+    _queue_tail->next = &job;
+  } else {
+    _queue_head = &job;
+  }
+  _queue_tail = &job;
+  pthread_cond_broadcast( &_work_cond );
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Help run our own job's tasks rather than sitting idle. Only our own tasks
+  // are run here so that a task that itself submits work can never end up
+  // waiting on a job that is stuck behind it.
+  //////////////////////////////////////////////////////////////////////////////
+  while (tpool_claim( &job, &i )) {
+    pthread_mutex_unlock( &_lock );
+    task( data, i, num_tasks );
+    pthread_mutex_lock( &_lock );
+    tpool_finish( &job );
+  }
+
+  // Wait for the tasks that were claimed by the workers to complete.
+  while (job.finished < job.num_tasks) {
+    pthread_cond_wait( &_done_cond, &_lock );
+  }
+  pthread_mutex_unlock( &_lock );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void *tpool_worker( void *unused )
+{
+  unsigned int i;
+  PoolJob *job;
+
+  pthread_mutex_lock( &_lock );
+  while (1) {
+    // Sleep until there's work to do or we're told to stop.
+    while (_queue_head == NULL && !_stopping) {
+      pthread_cond_wait( &_work_cond, &_lock );
+    }
+
+    if (_stopping) {
+      break;
+    }
+
+    // Take the next task from the job at the head of the queue. A job leaves
+    // the queue once its last task is claimed, so this only fails if that
+    // invariant is broken.
+    job = _queue_head;
+    if (!tpool_claim( job, &i )) {
+      continue;
+    }
+
+    pthread_mutex_unlock( &_lock );
+    job->task( job->data, i, job->num_tasks );
+    pthread_mutex_lock( &_lock );
+
+    tpool_finish( job );
+  }
+  pthread_mutex_unlock( &_lock );
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int tpool_claim( PoolJob *job, unsigned int *task_i )
+{
+  PoolJob *prev;
+
+  // NOTE: _lock must be held when calling this function.
+  if (job->claimed == job->num_tasks) {
+    return 0;
+  }
+
+  *task_i = job->claimed++;
+
+  // Once every task in a job has been claimed, take it out of the queue.
+  if (job->claimed == job->num_tasks) {
+    if (_queue_head == job) {
+      _queue_head = job->next;
+      prev = NULL;
+    } else {
+      for (prev = _queue_head; prev->next != job; prev = prev->next);
+      prev->next = job->next;
+    }
+
+    if (_queue_tail == job) {
+      _queue_tail = prev;
+    }
+    job->next = NULL;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void tpool_finish( PoolJob *job )
+{
+  // NOTE: _lock must be held when calling this function.
+  job->finished++;
+  if (job->finished == job->num_tasks) {
+    pthread_cond_broadcast( &_done_cond );
+  }
+}
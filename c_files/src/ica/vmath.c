@@ -0,0 +1,478 @@
+#include "ica/vmath.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The vector implementations are only built for single precision on x86, using
+// GCC's target attributes so that the rest of the library doesn't need to be
+// compiled for a particular instruction set.
+#if defined(USE_SINGLE) && defined(__GNUC__) &&\
+    (defined(__x86_64__) || defined(__i386__))
+  #define VMATH_X86
+  #include <immintrin.h>
+#endif
+
+// How many points vmath_verify() checks over its range, and how many of them
+// are handed to an implementation at once.
+#define VERIFY_POINTS   (1 << 22)
+#define VERIFY_BLOCK    1024
+
+// Constants for the Cephes single precision exp() and tanh() approximations.
+#define EXP_MAX     88.37f
+#define EXP_LOG2E   1.44269504088896341f
+#define EXP_C1      0.693359375f
+#define EXP_C2     -2.12194440e-4f
+#define EXP_P0      1.9875691500E-4f
+#define EXP_P1      1.3981999507E-3f
+#define EXP_P2      8.3334519073E-3f
+#define EXP_P3      4.1665795894E-2f
+#define EXP_P4      1.6666665459E-1f
+#define EXP_P5      5.0000001201E-1f
+
+#define TANH_MAX    9.0f      // tanh(x) rounds to 1 for all larger x.
+#define TANH_SMALL  0.625f    // Below this, use the odd polynomial.
+#define TANH_P0    -5.70498872745E-3f
+#define TANH_P1     2.06390887954E-2f
+#define TANH_P2    -5.37397155531E-2f
+#define TANH_P3     1.33314422036E-1f
+#define TANH_P4    -3.33332819422E-1f
+
+// The general form of an element-wise function.
+typedef void (*VMathFunc)( NUMTYPE*, NUMTYPE const*, int );
+
+static void scalar_tanh( NUMTYPE *y, NUMTYPE const *x, int n );
+static void scalar_exp( NUMTYPE *y, NUMTYPE const *x, int n );
+
+#ifdef VMATH_X86
+static void avx2_tanh( NUMTYPE *y, NUMTYPE const *x, int n );
+static void avx2_exp( NUMTYPE *y, NUMTYPE const *x, int n );
+static void avx512_tanh( NUMTYPE *y, NUMTYPE const *x, int n );
+static void avx512_exp( NUMTYPE *y, NUMTYPE const *x, int n );
+#endif
+
+static int selectFuncs( VMathISA isa, VMathFunc *f_tanh, VMathFunc *f_exp );
+
+/**
+ * The selected implementation. These start out as the scalar functions so that
+ * the vmath_* functions work even if vmath_init() is never called.
+ */
+static VMathISA  _isa  = VMATH_AUTO;
+static VMathFunc _tanh = scalar_tanh;
+static VMathFunc _exp  = scalar_exp;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+VMathISA vmath_init( VMathISA isa )
+{
+  if (isa == VMATH_AUTO) {
+    if (vmath_supported( VMATH_AVX512 )) {
+      isa = VMATH_AVX512;
+    } else if (vmath_supported( VMATH_AVX2 )) {
+      isa = VMATH_AVX2;
+    } else {
+      isa = VMATH_SCALAR;
+    }
+  }
+
+  if (!selectFuncs( isa, &_tanh, &_exp )) {
+    isa = VMATH_SCALAR;
+    selectFuncs( isa, &_tanh, &_exp );
+  }
+
+  _isa = isa;
+  return _isa;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+VMathISA vmath_isa()
+{
+  return _isa;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int vmath_supported( VMathISA isa )
+{
+  switch (isa) {
+    case VMATH_SCALAR:
+      return 1;
+#ifdef VMATH_X86
+    case VMATH_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx2" ) &&
+             __builtin_cpu_supports( "fma" );
+    case VMATH_AVX512:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx512f" );
+#endif
+    default:
+      return 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+char const *vmath_isaName( VMathISA isa )
+{
+  switch (isa) {
+    case VMATH_AUTO:    return "auto";
+    case VMATH_SCALAR:  return "scalar";
+    case VMATH_AVX2:    return "avx2";
+    case VMATH_AVX512:  return "avx512";
+    default:            return "unknown";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void vmath_tanh( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  _tanh( y, x, n );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void vmath_exp( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  _exp( y, x, n );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int vmath_verify( VMathISA isa, double max_abs, double *tanh_err,
+                  double *exp_err )
+{
+  NUMTYPE in[VERIFY_BLOCK], t_out[VERIFY_BLOCK], e_in[VERIFY_BLOCK];
+  NUMTYPE e_out[VERIFY_BLOCK];
+  VMathFunc f_tanh, f_exp;
+  double ref, err, step;
+  int i, j, n;
+
+  if (isa == VMATH_AUTO || !vmath_supported( isa ) ||
+      !selectFuncs( isa, &f_tanh, &f_exp )) {
+    return 0;
+  }
+
+  *tanh_err = *exp_err = 0.0;
+  step = 2.0 * max_abs / (VERIFY_POINTS - 1);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sweep over [-max_abs, max_abs] a block at a time, comparing the results to
+  // the C library evaluated in double precision.
+  //////////////////////////////////////////////////////////////////////////////
+  for (i = 0; i < VERIFY_POINTS; i += VERIFY_BLOCK) {
+    n = VERIFY_BLOCK;
+    if (i + n > VERIFY_POINTS) {
+      n = VERIFY_POINTS - i;
+    }
+
+    for (j = 0; j < n; j++) {
+      in[j]   = (NUMTYPE) (-max_abs + (i + j) * step);
+      e_in[j] = -in[j] * in[j] / 2.0;
+    }
+
+    f_tanh( t_out, in, n );
+    f_exp( e_out, e_in, n );
+
+    for (j = 0; j < n; j++) {
+      ref = tanh( (double) in[j] );
+      if (ref != 0.0) {
+        err = fabs( (t_out[j] - ref) / ref );
+        if (err > *tanh_err) {
+          *tanh_err = err;
+        }
+      }
+
+      if (e_in[j] >= VMATH_EXP_MIN) {
+        ref = exp( (double) e_in[j] );
+        err = fabs( (e_out[j] - ref) / ref );
+        if (err > *exp_err) {
+          *exp_err = err;
+        }
+      }
+    }
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int selectFuncs( VMathISA isa, VMathFunc *f_tanh, VMathFunc *f_exp )
+{
+  switch (isa) {
+    case VMATH_SCALAR:
+      *f_tanh = scalar_tanh;
+      *f_exp  = scalar_exp;
+      return 1;
+#ifdef VMATH_X86
+    case VMATH_AVX2:
+      if (!vmath_supported( isa )) {
+        return 0;
+      }
+      *f_tanh = avx2_tanh;
+      *f_exp  = avx2_exp;
+      return 1;
+    case VMATH_AVX512:
+      if (!vmath_supported( isa )) {
+        return 0;
+      }
+      *f_tanh = avx512_tanh;
+      *f_exp  = avx512_exp;
+      return 1;
+#endif
+    default:
+      return 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void scalar_tanh( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    y[i] = tanh( x[i] );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void scalar_exp( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    y[i] = exp( x[i] );
+  }
+}
+
+#ifdef VMATH_X86
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2,fma")))
+static inline __m256 avx2_exp8( __m256 x )
+{
+  __m256 fx, p, z, valid;
+  __m256i n;
+
+  // Inputs that are too small produce zero, inputs that are too big are
+  // clamped so that 2^n stays a normal number.
+  valid = _mm256_cmp_ps( x, _mm256_set1_ps( VMATH_EXP_MIN ), _CMP_GE_OQ );
+  x = _mm256_min_ps( x, _mm256_set1_ps( EXP_MAX ) );
+  x = _mm256_max_ps( x, _mm256_set1_ps( VMATH_EXP_MIN ) );
+
+  // exp(x) = 2^n * exp(r), with n = round(x / ln(2)) and r = x - n * ln(2).
+  fx = _mm256_round_ps( _mm256_mul_ps( x, _mm256_set1_ps( EXP_LOG2E ) ),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+  x = _mm256_fnmadd_ps( fx, _mm256_set1_ps( EXP_C1 ), x );
+  x = _mm256_fnmadd_ps( fx, _mm256_set1_ps( EXP_C2 ), x );
+
+  z = _mm256_mul_ps( x, x );
+  p = _mm256_set1_ps( EXP_P0 );
+  p = _mm256_fmadd_ps( p, x, _mm256_set1_ps( EXP_P1 ) );
+  p = _mm256_fmadd_ps( p, x, _mm256_set1_ps( EXP_P2 ) );
+  p = _mm256_fmadd_ps( p, x, _mm256_set1_ps( EXP_P3 ) );
+  p = _mm256_fmadd_ps( p, x, _mm256_set1_ps( EXP_P4 ) );
+  p = _mm256_fmadd_ps( p, x, _mm256_set1_ps( EXP_P5 ) );
+  p = _mm256_fmadd_ps( p, z, _mm256_add_ps( x, _mm256_set1_ps( 1.0f ) ) );
+
+  // Build 2^n directly in the exponent bits.
+  n = _mm256_cvttps_epi32( fx );
+  n = _mm256_slli_epi32( _mm256_add_epi32( n, _mm256_set1_epi32( 127 ) ), 23 );
+  p = _mm256_mul_ps( p, _mm256_castsi256_ps( n ) );
+
+  return _mm256_and_ps( p, valid );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2,fma")))
+static inline __m256 avx2_tanh8( __m256 x )
+{
+  __m256 sign, ax, z, p, small, large, e;
+
+  sign = _mm256_and_ps( x, _mm256_set1_ps( -0.0f ) );
+  ax   = _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), x );
+  ax   = _mm256_min_ps( ax, _mm256_set1_ps( TANH_MAX ) );
+
+  // For small |x|: tanh(x) = x + x^3 * P(x^2).
+  z = _mm256_mul_ps( ax, ax );
+  p = _mm256_set1_ps( TANH_P0 );
+  p = _mm256_fmadd_ps( p, z, _mm256_set1_ps( TANH_P1 ) );
+  p = _mm256_fmadd_ps( p, z, _mm256_set1_ps( TANH_P2 ) );
+  p = _mm256_fmadd_ps( p, z, _mm256_set1_ps( TANH_P3 ) );
+  p = _mm256_fmadd_ps( p, z, _mm256_set1_ps( TANH_P4 ) );
+  small = _mm256_fmadd_ps( _mm256_mul_ps( p, z ), ax, ax );
+
+  // Otherwise: tanh(x) = 1 - 2 / (exp(2x) + 1).
+  e = avx2_exp8( _mm256_add_ps( ax, ax ) );
+  large = _mm256_sub_ps( _mm256_set1_ps( 1.0f ),
+                         _mm256_div_ps( _mm256_set1_ps( 2.0f ),
+                                        _mm256_add_ps( e,
+                                                    _mm256_set1_ps( 1.0f ) ) ));
+
+  p = _mm256_blendv_ps( large, small,
+                  _mm256_cmp_ps( ax, _mm256_set1_ps( TANH_SMALL ), _CMP_LT_OQ ));
+  return _mm256_or_ps( p, sign );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2,fma")))
+static void avx2_tanh( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  NUMTYPE tail[8];
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps( y + i, avx2_tanh8( _mm256_loadu_ps( x + i ) ) );
+  }
+
+  // Pad out whatever is left over to a full vector.
+  if (i < n) {
+    memset( tail, 0, sizeof(tail) );
+    memcpy( tail, x + i, sizeof(NUMTYPE) * (n - i) );
+    _mm256_storeu_ps( tail, avx2_tanh8( _mm256_loadu_ps( tail ) ) );
+    memcpy( y + i, tail, sizeof(NUMTYPE) * (n - i) );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2,fma")))
+static void avx2_exp( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  NUMTYPE tail[8];
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps( y + i, avx2_exp8( _mm256_loadu_ps( x + i ) ) );
+  }
+
+  // Pad out whatever is left over to a full vector.
+  if (i < n) {
+    memset( tail, 0, sizeof(tail) );
+    memcpy( tail, x + i, sizeof(NUMTYPE) * (n - i) );
+    _mm256_storeu_ps( tail, avx2_exp8( _mm256_loadu_ps( tail ) ) );
+    memcpy( y + i, tail, sizeof(NUMTYPE) * (n - i) );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static inline __m512 avx512_exp16( __m512 x )
+{
+  __m512 fx, p, z;
+  __m512i n;
+  __mmask16 valid;
+
+  // Inputs that are too small produce zero, inputs that are too big are
+  // clamped so that 2^n stays a normal number.
+  valid = _mm512_cmp_ps_mask( x, _mm512_set1_ps( VMATH_EXP_MIN ), _CMP_GE_OQ );
+  x = _mm512_min_ps( x, _mm512_set1_ps( EXP_MAX ) );
+  x = _mm512_max_ps( x, _mm512_set1_ps( VMATH_EXP_MIN ) );
+
+  // exp(x) = 2^n * exp(r), with n = round(x / ln(2)) and r = x - n * ln(2).
+  fx = _mm512_roundscale_ps( _mm512_mul_ps( x, _mm512_set1_ps( EXP_LOG2E ) ),
+                             _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+  x = _mm512_fnmadd_ps( fx, _mm512_set1_ps( EXP_C1 ), x );
+  x = _mm512_fnmadd_ps( fx, _mm512_set1_ps( EXP_C2 ), x );
+
+  z = _mm512_mul_ps( x, x );
+  p = _mm512_set1_ps( EXP_P0 );
+  p = _mm512_fmadd_ps( p, x, _mm512_set1_ps( EXP_P1 ) );
+  p = _mm512_fmadd_ps( p, x, _mm512_set1_ps( EXP_P2 ) );
+  p = _mm512_fmadd_ps( p, x, _mm512_set1_ps( EXP_P3 ) );
+  p = _mm512_fmadd_ps( p, x, _mm512_set1_ps( EXP_P4 ) );
+  p = _mm512_fmadd_ps( p, x, _mm512_set1_ps( EXP_P5 ) );
+  p = _mm512_fmadd_ps( p, z, _mm512_add_ps( x, _mm512_set1_ps( 1.0f ) ) );
+
+  // Build 2^n directly in the exponent bits.
+  n = _mm512_cvttps_epi32( fx );
+  n = _mm512_slli_epi32( _mm512_add_epi32( n, _mm512_set1_epi32( 127 ) ), 23 );
+  p = _mm512_mul_ps( p, _mm512_castsi512_ps( n ) );
+
+  return _mm512_maskz_mov_ps( valid, p );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static inline __m512 avx512_tanh16( __m512 x )
+{
+  __m512i sign;
+  __m512 ax, z, p, small, large, e;
+
+  sign = _mm512_and_epi32( _mm512_castps_si512( x ),
+                           _mm512_set1_epi32( 0x80000000 ) );
+  ax   = _mm512_abs_ps( x );
+  ax   = _mm512_min_ps( ax, _mm512_set1_ps( TANH_MAX ) );
+
+  // For small |x|: tanh(x) = x + x^3 * P(x^2).
+  z = _mm512_mul_ps( ax, ax );
+  p = _mm512_set1_ps( TANH_P0 );
+  p = _mm512_fmadd_ps( p, z, _mm512_set1_ps( TANH_P1 ) );
+  p = _mm512_fmadd_ps( p, z, _mm512_set1_ps( TANH_P2 ) );
+  p = _mm512_fmadd_ps( p, z, _mm512_set1_ps( TANH_P3 ) );
+  p = _mm512_fmadd_ps( p, z, _mm512_set1_ps( TANH_P4 ) );
+  small = _mm512_fmadd_ps( _mm512_mul_ps( p, z ), ax, ax );
+
+  // Otherwise: tanh(x) = 1 - 2 / (exp(2x) + 1).
+  e = avx512_exp16( _mm512_add_ps( ax, ax ) );
+  large = _mm512_sub_ps( _mm512_set1_ps( 1.0f ),
+                         _mm512_div_ps( _mm512_set1_ps( 2.0f ),
+                                        _mm512_add_ps( e,
+                                                    _mm512_set1_ps( 1.0f ) ) ));
+
+  p = _mm512_mask_blend_ps(
+          _mm512_cmp_ps_mask( ax, _mm512_set1_ps( TANH_SMALL ), _CMP_LT_OQ ),
+          large, small );
+  return _mm512_castsi512_ps( _mm512_or_epi32( _mm512_castps_si512( p ),
+                                               sign ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static void avx512_tanh( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  __mmask16 mask;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps( y + i, avx512_tanh16( _mm512_loadu_ps( x + i ) ) );
+  }
+
+  // Handle whatever is left over with a masked load and store.
+  if (i < n) {
+    mask = (__mmask16) ((1u << (n - i)) - 1);
+    _mm512_mask_storeu_ps( y + i, mask,
+                        avx512_tanh16( _mm512_maskz_loadu_ps( mask, x + i ) ) );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static void avx512_exp( NUMTYPE *y, NUMTYPE const *x, int n )
+{
+  __mmask16 mask;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps( y + i, avx512_exp16( _mm512_loadu_ps( x + i ) ) );
+  }
+
+  // Handle whatever is left over with a masked load and store.
+  if (i < n) {
+    mask = (__mmask16) ((1u << (n - i)) - 1);
+    _mm512_mask_storeu_ps( y + i, mask,
+                         avx512_exp16( _mm512_maskz_loadu_ps( mask, x + i ) ) );
+  }
+}
+#endif
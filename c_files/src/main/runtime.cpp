@@ -38,6 +38,7 @@ int main( int argc, char **argv )
   NUMTYPE *mu_S;
 
   struct timeval start, stop, diff;
+  ICACalibration *cal;
   double *runtimes;
   double average;
   double std_dev;
@@ -61,6 +62,20 @@ int main( int argc, char **argv )
     return 0;
   }
 
+  // Measure a calibration table for ICA_AUTO instead, if asked to. The GPU is
+  // timed too, if the library was built with it.
+  if (cmd_args.calibration) {
+    printf("Calibrating (this may take a while)...\n");
+    cal = ica_calibrate( &(ica_params[IMPLEM_TYPES / 2]), MAX_TEST,
+                         cmd_args.samples );
+    if (cal == NULL || !ica_saveCalibration( cal, cmd_args.calibration )) {
+      printf("Couldn't save the calibration table to %s.\n",
+             cmd_args.calibration);
+    }
+    ica_destroyCalibration( cal );
+    return 0;
+  }
+
   // Initialize the results array.
   num_results = MAX_TEST - MIN_TEST + 1;
 
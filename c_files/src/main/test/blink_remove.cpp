@@ -16,6 +16,7 @@ int main( int argc, char **argv ){
 
   CmdLineArgs cmd_args;
   ICAParams ica_params;
+  ICACalibration *cal = NULL;
 
   struct timeval start, stop, diff;
   double t_process;
@@ -32,6 +33,35 @@ int main( int argc, char **argv ){
   ica_params.implem   = cmd_args.implem;
   ica_params.use_gpu  = cmd_args.use_gpu;
   ica_params.gpu_device = 1;
+  ica_params.num_threads = DEF_NUM_THREADS;
+  ica_params.num_components = DEF_NUM_COMPONENTS;
+  ica_params.seed = NULL;
+  ica_params.pca_dims = DEF_PCA_DIMS;
+  ica_params.pca_variance = DEF_PCA_VARIANCE;
+  ica_params.decorr = DEF_DECORR;
+  ica_params.num_lags = DEF_NUM_LAGS;
+  ica_params.precision = DEF_PRECISION;
+  ica_params.observer = NULL;
+  ica_params.observer_data = NULL;
+  ica_params.cancel = NULL;
+  ica_params.time_limit = cmd_args.time_limit;
+  ica_params.decimate = cmd_args.decimate;
+  ica_params.jade_eigenmats = DEF_JADE_EIGENMATS;
+
+  // Load the calibration table for ICA_AUTO, or measure one if there isn't
+  // one for this host yet.
+  if (cmd_args.calibration) {
+    cal = ica_loadCalibration( cmd_args.calibration );
+    if (cal == NULL) {
+      printf( "Calibrating (this may take a while)...\n" );
+      cal = ica_calibrate( &ica_params, 0, 0 );
+      if (cal == NULL || !ica_saveCalibration( cal, cmd_args.calibration )) {
+        printf( "Couldn't save the calibration table to %s.\n",
+                cmd_args.calibration );
+      }
+    }
+    ica_setCalibration( cal );
+  }
 
   // Perform the actual work.
   gettimeofday( &start, NULL );
@@ -46,6 +76,8 @@ int main( int argc, char **argv ){
 
   // Shutdown ICA.
   ica_shutdown();
+  ica_setCalibration( NULL );
+  ica_destroyCalibration( cal );
 
   return 0;
 }
@@ -77,6 +77,20 @@ int main( int argc, char **argv )
   ica_params.num_obs  = edf_file->num_samples;
   ica_params.use_gpu  = cmd_args.use_gpu;
   ica_params.gpu_device = 1;
+  ica_params.num_threads = DEF_NUM_THREADS;
+  ica_params.num_components = DEF_NUM_COMPONENTS;
+  ica_params.seed = NULL;
+  ica_params.pca_dims = DEF_PCA_DIMS;
+  ica_params.pca_variance = DEF_PCA_VARIANCE;
+  ica_params.decorr = DEF_DECORR;
+  ica_params.num_lags = DEF_NUM_LAGS;
+  ica_params.precision = DEF_PRECISION;
+  ica_params.observer = NULL;
+  ica_params.observer_data = NULL;
+  ica_params.cancel = NULL;
+  ica_params.time_limit = DEF_TIME_LIMIT;
+  ica_params.decimate = DEF_DECIMATE;
+  ica_params.jade_eigenmats = DEF_JADE_EIGENMATS;
 
   // Setup blink detection parameters.
   b_params.f_s = (NUMTYPE) edf_file->num_samples /
@@ -107,6 +121,8 @@ int main( int argc, char **argv )
   ica_thr_data.X = &X;  ica_thr_data.W = &Wa; ica_thr_data.mu_S = mu_Sa;
   ica_thr_data.S = &Sa; ica_thr_data.A = &Aa;
   ica_thr_data.ica_params = &ica_params;
+  ica_thr_data.W_init = NULL;
+  ica_thr_data.ctx = NULL;
 
   // Initialize blink detection stuff.
   channels = (NUMTYPE*) malloc( sizeof(NUMTYPE) * 4 * edf_file->num_samples );
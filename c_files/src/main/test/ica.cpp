@@ -1,5 +1,6 @@
 #include "matrix.h"
 #include "ica/ica.h"
+#include "ica/vmath.h"
 #include "numtype.h"
 
 #include "cmd_args/ica.h"
@@ -10,6 +11,280 @@
 #include <string.h>
 #include <sys/time.h>
 
+/**
+ * Name: printProgress
+ *
+ * Description:
+ * An ICA observer (see ICAObserver) that prints the convergence metric after
+ * every iteration/sweep, and the time spent in each phase at the end of a run.
+ *
+ * Parameters:
+ * @param progress    the progress of the run
+ * @param data        unused
+ */
+static void printProgress( ICAProgress const *progress, void *data )
+{
+  static const char *names[ICA_NUM_PHASES] = {
+    "remmean", "whiten", "contrast", "ortho", "finalize"
+  };
+  int i;
+
+  if (!progress->done) {
+    printf("  iteration %u: %g\n", progress->iter, progress->metric);
+    return;
+  }
+
+  printf("  phase times after %u iterations/sweeps:\n", progress->iter);
+  for (i = 0; i < ICA_NUM_PHASES; i++) {
+    printf("    %-9s %g seconds\n", names[i], progress->ns[i] * 1e-9);
+  }
+}
+
+/**
+ * Name: statusName
+ *
+ * Description:
+ * Returns a printable name for how an ICA run ended.
+ *
+ * Parameters:
+ * @param status      how the run ended
+ *
+ * Returns:
+ * @return const char*  the name of the status
+ */
+static const char *statusName( ICAStatus status )
+{
+  switch (status) {
+    case ICA_STATUS_CONVERGED:  return "converged";
+    case ICA_STATUS_MAX_ITER:   return "reached the iteration limit";
+    case ICA_STATUS_CANCELLED:  return "cancelled";
+    case ICA_STATUS_DEADLINE:   return "reached the time limit";
+    case ICA_STATUS_FAILED:
+    default:                    return "failed";
+  }
+}
+
+/**
+ * Name: choiceName
+ *
+ * Description:
+ * Returns a printable name for the implementation and contrast chosen by
+ * ica_choose().
+ *
+ * Parameters:
+ * @param params      the parameters ica_choose() filled in
+ *
+ * Returns:
+ * @return const char*  the name of the choice
+ */
+static const char *choiceName( ICAParams const *params )
+{
+  if (params->implem == ICA_JADE) {
+    return params->use_gpu ? "GPU JADE" : "JADE";
+  }
+
+  switch (params->contrast) {
+    case NONLIN_CUBE:   return params->use_gpu ? "GPU FastICA (cube)" :
+                                                 "FastICA (cube)";
+    case NONLIN_GAUSS:  return params->use_gpu ? "GPU FastICA (gauss)" :
+                                                 "FastICA (gauss)";
+    case NONLIN_TANH:
+    default:            return params->use_gpu ? "GPU FastICA (tanh)" :
+                                                 "FastICA (tanh)";
+  }
+}
+
+/**
+ * The data given to readColumns() and writeColumns(): where the observations
+ * are read from, and where the source signals are written to.
+ */
+typedef struct StreamData {
+  Matrix const *X;
+  Matrix *S;
+} StreamData;
+
+/**
+ * Name: readColumns
+ *
+ * Description:
+ * An ICAStream read function that copies columns of the observation matrix,
+ * for running ica_stream() on data that is in memory.
+ *
+ * Parameters:
+ * @param data        the StreamData
+ * @param X           where to store the columns
+ * @param first       the first column to copy
+ *
+ * Returns:
+ * @return int        nonzero
+ */
+static int readColumns( void *data, Matrix *X, unsigned int first )
+{
+  Matrix const *src = ((StreamData*) data)->X;
+
+  memcpy( X->elem, src->elem + first * src->ld,
+          sizeof(NUMTYPE) * X->ld * X->cols );
+  return 1;
+}
+
+/**
+ * Name: writeColumns
+ *
+ * Description:
+ * An ICAStream write function that copies source signals into the columns of
+ * the source signal matrix (see readColumns()).
+ *
+ * Parameters:
+ * @param data        the StreamData
+ * @param S           the source signals
+ * @param first       the first column to copy them to
+ *
+ * Returns:
+ * @return int        nonzero
+ */
+static int writeColumns( void *data, Matrix const *S, unsigned int first )
+{
+  Matrix *dst = ((StreamData*) data)->S;
+  int row, col;
+
+  dst->rows = S->rows;
+  for (col = 0; col < S->cols; col++) {
+    for (row = 0; row < S->rows; row++) {
+      dst->elem[(first + col) * dst->ld + row] = S->elem[col * S->ld + row];
+    }
+  }
+  return 1;
+}
+
+/**
+ * Name: runOnline
+ *
+ * Description:
+ * Feeds the observations to a running FastICA estimate (see
+ * ica_createOnline()) a block of columns at a time, as if they were arriving
+ * from an amplifier, and then unmixes all of them with the final estimate.
+ *
+ * Parameters:
+ * @param params      the ICA parameters
+ * @param block_cols  how many observations are in a block
+ * @param forget      the estimate's forgetting factor
+ * @param W           where to store the final unmixing matrix
+ * @param A           where to store the final mixing matrix
+ * @param S           where to store the source signals
+ * @param mu_S        where to store the means of the source signals
+ * @param X           the observations
+ *
+ * Returns:
+ * @return unsigned int   how many blocks there were (zero if the estimate
+ *                        couldn't be created, or never got started)
+ */
+static unsigned int runOnline( ICAParams const *params,
+                               unsigned int block_cols, NUMTYPE forget,
+                               Matrix *W, Matrix *A, Matrix *S, NUMTYPE *mu_S,
+                               Matrix const *X )
+{
+  ICAOnline *online;
+  Matrix block;
+  unsigned int first, num_blocks;
+  int row, col, k;
+
+  online = ica_createOnline( params, forget );
+  if (online == NULL) {
+    return 0;
+  }
+
+  block.rows = block.ld = X->rows;
+  num_blocks = 0;
+  for (first = 0; first < X->cols; first += block_cols) {
+    block.elem = X->elem + first * X->ld;
+    block.cols = block.lag = X->cols - first;
+    if (block.cols > block_cols) { block.cols = block.lag = block_cols; }
+
+    ica_updateOnline( online, &block );
+    num_blocks++;
+  }
+
+  if (!ica_onlineUnmixing( online, W, A, mu_S )) {
+    ica_destroyOnline( online );
+    return 0;
+  }
+  ica_destroyOnline( online );
+
+  // S = W * X - mu_S
+  S->rows = W->rows;
+  for (col = 0; col < X->cols; col++) {
+    for (row = 0; row < W->rows; row++) {
+      S->elem[col * S->ld + row] = -mu_S[row];
+      for (k = 0; k < X->rows; k++) {
+        S->elem[col * S->ld + row] += W->elem[k * W->ld + row] *
+                                      X->elem[col * X->ld + k];
+      }
+    }
+  }
+
+  return num_blocks;
+}
+
+/**
+ * Name: amariDistance
+ *
+ * Description:
+ * Measures how far apart two ICA results are, as the Amari distance of the
+ * product of one's unmixing matrix and the other's mixing matrix from a scaled
+ * permutation matrix: zero when the two found the same sources (in any order,
+ * and at any scale), and growing towards one as they differ.
+ *
+ * Parameters:
+ * @param W           the unmixing matrix of one result (r x n)
+ * @param A           the mixing matrix of the other (n x r)
+ *
+ * Returns:
+ * @return double     the Amari distance
+ */
+static double amariDistance( Matrix const *W, Matrix const *A )
+{
+  int r = W->rows, row, col, k;
+  double *P, sum, max, total;
+
+  if (r < 2) {
+    return 0.0;
+  }
+
+  // P = W * A
+  P = (double*) malloc( sizeof(double) * r * r );
+  for (col = 0; col < r; col++) {
+    for (row = 0; row < r; row++) {
+      P[col * r + row] = 0.0;
+      for (k = 0; k < W->cols; k++) {
+        P[col * r + row] += W->elem[k * W->ld + row] * A->elem[col * A->ld + k];
+      }
+      P[col * r + row] = fabs( P[col * r + row] );
+    }
+  }
+
+  // Each row, and then each column, of a scaled permutation has one nonzero.
+  total = 0.0;
+  for (row = 0; row < r; row++) {
+    sum = max = 0.0;
+    for (col = 0; col < r; col++) {
+      sum += P[col * r + row];
+      if (P[col * r + row] > max) { max = P[col * r + row]; }
+    }
+    total += sum / max - 1.0;
+  }
+  for (col = 0; col < r; col++) {
+    sum = max = 0.0;
+    for (row = 0; row < r; row++) {
+      sum += P[col * r + row];
+      if (P[col * r + row] > max) { max = P[col * r + row]; }
+    }
+    total += sum / max - 1.0;
+  }
+
+  free( P );
+  return total / (2.0 * r * (r - 1));
+}
+
 /**
  * Name: main
  *
@@ -22,10 +297,21 @@ int main( int argc, char **argv )
 {
   CmdLineArgs cmd_args;
   ICAParams ica_params;
+  ICAParams chosen;
+  ICACalibration *cal = NULL;
+  double predicted;
+  ICAStream stream;
+  StreamData stream_data;
+  ICAStatus status;
   NUMTYPE *mu_Sa;
-  int i, j;
+  Matrix Wf, Af, Sf;
+  NUMTYPE *mu_Sf;
+  double first_exec, full_exec;
+  int i, j, k;
 
   unsigned int num_iter[2];
+  double max_abs, tanh_err, exp_err;
+  VMathISA isa;
 #ifdef ENABLE_GPU
   double gpu_init;
   double gpu_exec;
@@ -52,6 +338,46 @@ int main( int argc, char **argv )
   ica_params.epsilon  = cmd_args.epsilon;
   ica_params.max_iter = cmd_args.max_iter;
   ica_params.implem   = cmd_args.implem;
+  ica_params.num_threads = cmd_args.num_threads;
+  ica_params.num_components = cmd_args.num_components;
+  ica_params.seed = NULL;
+  ica_params.pca_dims = cmd_args.pca_dims;
+  ica_params.pca_variance = cmd_args.pca_variance;
+  ica_params.decorr = cmd_args.decorr;
+  ica_params.num_lags = cmd_args.num_lags;
+  ica_params.precision = cmd_args.precision;
+  ica_params.observer = NULL;
+  ica_params.observer_data = NULL;
+  ica_params.cancel = NULL;
+  ica_params.time_limit = cmd_args.time_limit;
+  ica_params.decimate = cmd_args.decimate;
+  ica_params.jade_eigenmats = cmd_args.jade_eigenmats;
+  ica_params.use_gpu = cmd_args.gpu_only || cmd_args.compare;
+  ica_params.gpu_device = DEF_GPU_DEVICE;
+
+  // Select the vectorized math routines before the library gets a chance to
+  // pick them itself.
+  isa = vmath_init( cmd_args.vmath );
+  if (cmd_args.vmath != VMATH_AUTO && isa != cmd_args.vmath) {
+    printf("The %s vmath routines are not supported, using %s instead.\n",
+           vmath_isaName( cmd_args.vmath ), vmath_isaName( isa ));
+  }
+  printf("Using %s vmath routines.\n", vmath_isaName( isa ));
+
+  // Load the calibration table for ICA_AUTO, or measure one if there isn't
+  // one for this host yet.
+  if (cmd_args.calibration) {
+    cal = ica_loadCalibration( cmd_args.calibration );
+    if (cal == NULL) {
+      printf("Calibrating (this may take a while)...\n");
+      cal = ica_calibrate( &ica_params, 0, 0 );
+      if (cal == NULL || !ica_saveCalibration( cal, cmd_args.calibration )) {
+        printf("Couldn't save the calibration table to %s.\n",
+               cmd_args.calibration);
+      }
+    }
+    ica_setCalibration( cal );
+  }
 
   // Open up each matrix file that we were given. If we're checking output,
   // increment the argv[] index by 5 every iteration, otherwise, only increment
@@ -116,6 +442,15 @@ int main( int argc, char **argv )
     if (!cmd_args.gpu_only) {
       // Make sure the CPU implementation is enabled.
       ica_params.use_gpu = 0;
+      ica_params.observer = cmd_args.trace ? printProgress : NULL;
+
+      if (cmd_args.implem == ICA_AUTO && cal) {
+        memcpy( &chosen, &ica_params, sizeof(ICAParams) );
+        if (ica_choose( cal, &chosen, &predicted )) {
+          printf("Auto implementation: %s, predicted %g seconds.\n",
+                 choiceName( &chosen ), predicted);
+        }
+      }
 
       // Initialize the ICA library.
       gettimeofday( &start, NULL );
@@ -126,24 +461,115 @@ int main( int argc, char **argv )
       cpu_init = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
       printf("CPU setup time:     %g seconds.\n", cpu_init);
 
+      // Either run on all of X at once, stream X through a workspace of the
+      // given size a chunk of columns at a time, or update a running estimate
+      // with a block of columns at a time.
+      stream.num_var    = X.rows;
+      stream.num_obs    = X.cols;
+      stream.mem_budget = (size_t) (cmd_args.mem_budget * 1024 * 1024);
+      stream.read       = readColumns;
+      stream.write      = writeColumns;
+      stream.data       = &stream_data;
+      stream_data.X     = &X;
+      stream_data.S     = &Sa;
+
       gettimeofday( &start, NULL );
-        num_iter[0] = ica( &Wa, &Aa, &Sa, mu_Sa, &X );
+        if (cmd_args.mem_budget > 0.0) {
+          num_iter[0] = ica_stream( &ica_params, &Wa, &Aa, mu_Sa, &stream,
+                                    NULL, &status );
+        } else if (cmd_args.online_block > 0) {
+          num_iter[0] = runOnline( &ica_params, cmd_args.online_block,
+                                   cmd_args.forget, &Wa, &Aa, &Sa, mu_Sa,
+                                   &X );
+          status = num_iter[0] ? ICA_STATUS_CONVERGED : ICA_STATUS_FAILED;
+        } else {
+          num_iter[0] = ica( &Wa, &Aa, &Sa, mu_Sa, &X );
+          status = ica_lastStatus();
+        }
       gettimeofday( &stop, NULL );
       timersub( &stop, &start, &diff );
 
       cpu_exec = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
       printf("CPU execution time: %g seconds.\n", cpu_exec);
       printf("CPU iterations/sweeps: %d\n", num_iter[0] );
+      printf("CPU status: %s\n", statusName( status ));
+      first_exec = cpu_exec;
 
       if (isnan(Sa.elem[0])) {
         printf("CPU NaN\n");
       }
 
+      // Run again, this time starting from the unmixing matrix just found.
+      if (cmd_args.warm_start) {
+        gettimeofday( &start, NULL );
+          num_iter[0] = ica_warm( &Wa, &Aa, &Sa, mu_Sa, &X, &Wa );
+        gettimeofday( &stop, NULL );
+        timersub( &stop, &start, &diff );
+
+        cpu_exec = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+        printf("CPU warm start execution time: %g seconds.\n", cpu_exec);
+        printf("CPU warm start iterations/sweeps: %d\n", num_iter[0] );
+      }
+
+      // Run full JADE as well, to see what the eigenmatrix reduction cost in
+      // accuracy, and what it saved in time.
+      if (cmd_args.jade_eigenmats && cmd_args.implem == ICA_JADE &&
+          cmd_args.mem_budget <= 0.0 && cmd_args.online_block == 0) {
+        Wf = Wa; Af = Aa; Sf = Sa;
+        Wf.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * X.rows * X.rows );
+        Af.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * X.rows * X.rows );
+        Sf.elem = (NUMTYPE*) malloc( sizeof(NUMTYPE) * X.rows * X.cols );
+        mu_Sf   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * X.rows );
+
+        ica_params.jade_eigenmats = 0;
+        ica_init( &ica_params );
+
+        gettimeofday( &start, NULL );
+          num_iter[1] = ica( &Wf, &Af, &Sf, mu_Sf, &X );
+        gettimeofday( &stop, NULL );
+        timersub( &stop, &start, &diff );
+
+        full_exec = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+        printf("Full JADE execution time: %g seconds.\n", full_exec);
+        printf("Full JADE iterations/sweeps: %d\n", num_iter[1] );
+        printf("Eigenmatrix reduction: %.3gx faster, Amari distance from "
+               "full JADE %.4g\n", full_exec / first_exec,
+               amariDistance( &Wa, &Af ));
+
+        ica_params.jade_eigenmats = cmd_args.jade_eigenmats;
+        free( Wf.elem );
+        free( Af.elem );
+        free( Sf.elem );
+        free( mu_Sf );
+      }
+
       if (cmd_args.print) {
         mat_printToFile( "Wcpu.csv", &Wa, ROW_MAJOR );
         mat_printToFile( "Acpu.csv", &Aa, ROW_MAJOR );
         mat_printToFile( "Scpu.csv", &Sa, ROW_MAJOR );
       }
+
+      // The source signals are unit variance projections of the whitened
+      // data, so (once their means are removed) their range is the range of
+      // values the contrast functions evaluate tanh()/exp() over.
+      if (cmd_args.verify_vmath) {
+        max_abs = 0.0;
+        for (k = 0; k < Sa.rows * Sa.cols; k++) {
+          if (fabs( Sa.elem[k] - mu_Sa[k % Sa.rows] ) > max_abs) {
+            max_abs = fabs( Sa.elem[k] - mu_Sa[k % Sa.rows] );
+          }
+        }
+
+        printf("Verifying vmath routines over |y| <= %g:\n", max_abs);
+        for (k = VMATH_SCALAR; k <= VMATH_AVX512; k++) {
+          if (vmath_verify( (VMathISA) k, max_abs, &tanh_err, &exp_err )) {
+            printf("  %-8s tanh max rel err %.3g, exp max rel err %.3g\n",
+                   vmath_isaName( (VMathISA) k ), tanh_err, exp_err);
+          } else {
+            printf("  %-8s not supported\n", vmath_isaName( (VMathISA) k ));
+          }
+        }
+      }
     }
 
     // Free allocated memory.
@@ -157,5 +583,8 @@ int main( int argc, char **argv )
     ica_shutdown();
   }
 
+  ica_setCalibration( NULL );
+  ica_destroyCalibration( cal );
+
   return 0;
 }
@@ -1,6 +1,7 @@
 #include "matrix.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -163,12 +164,149 @@ int mat_printToFile( char const *filename, Matrix const *matrix,
 char _not_transpose = 'n';
 char _transpose = 't';
 NUMTYPE _beta  = 0.0;
-NUMTYPE _alpha = 1.0;
+NUMTYPE _beta_add = 1.0;
+MATRIX_TLS NUMTYPE _alpha = 1.0;
 
 char _jobz = 'V';
 char _uplo = 'U';
+char _left = 'L';
 int _one = 1;
 int _n1 = -1;
-int _lwork = 0;
-int _info = 0;
-NUMTYPE *_work = NULL;
+MATRIX_TLS int _info = 0;
+
+/**
+ * A thread's mat_eigSym() workspace: the size of the largest matrix it has
+ * room for, the workspaces of xSYEV/xSYEVD/xSYEVR, and the eigenvector and
+ * support arrays that xSYEVR needs. Each thread that uses SYEV() keeps its own,
+ * under a thread-specific key, so that it is freed when the thread exits.
+ */
+typedef struct EigWork {
+  int n;
+  int lwork, liwork;
+  NUMTYPE *work;
+  int *iwork;
+  NUMTYPE *Z;
+  int *isuppz;
+} EigWork;
+
+static pthread_key_t _eig_key;
+static pthread_once_t _eig_once = PTHREAD_ONCE_INIT;
+static int _eig_key_ok = 0;
+
+static void eig_createKey( void );
+static void eig_freeWork( void *data );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int mat_eigSym( Matrix *E, NUMTYPE *d )
+{
+  int n = E->rows, isize = 0;
+  NUMTYPE size;
+  EigWork *ew;
+#if defined(USE_SYEVR)
+  int col;
+  char const range = 'A';
+  NUMTYPE const vl = 0.0, vu = 0.0, abstol = 0.0;
+  int const il = 0, iu = 0;
+  int m;
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find this thread's workspace, creating an empty one the first time.
+  //////////////////////////////////////////////////////////////////////////////
+  pthread_once( &_eig_once, eig_createKey );
+  if (!_eig_key_ok) {
+    return 0;
+  }
+
+  ew = (EigWork*) pthread_getspecific( _eig_key );
+  if (ew == NULL) {
+    ew = (EigWork*) calloc( 1, sizeof(EigWork) );
+    if (ew == NULL || pthread_setspecific( _eig_key, ew ) != 0) {
+      free( ew );
+      return 0;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The first time this thread sees a matrix this large, ask LAPACK how much
+  // workspace it needs, and keep it for every matrix up to this size.
+  //////////////////////////////////////////////////////////////////////////////
+  if (n > ew->n) {
+#if defined(USE_SYEV)
+    xSYEV( &_jobz, &_uplo, &n, E->elem, &(E->ld), d, &size, &_n1, &_info );
+#elif defined(USE_SYEVR)
+    xSYEVR( &_jobz, &range, &_uplo, &n, E->elem, &(E->ld), &vl, &vu, &il, &iu,
+            &abstol, &m, d, ew->Z, &n, ew->isuppz, &size, &_n1, &isize, &_n1,
+            &_info );
+#else
+    xSYEVD( &_jobz, &_uplo, &n, E->elem, &(E->ld), d, &size, &_n1, &isize,
+            &_n1, &_info );
+#endif
+
+    free( ew->work );
+    free( ew->iwork );
+    free( ew->Z );
+    free( ew->isuppz );
+
+    ew->lwork  = (int) size;
+    ew->liwork = (isize > 0) ? isize : 1;
+    ew->work   = (NUMTYPE*) malloc( sizeof(NUMTYPE) * ew->lwork );
+    ew->iwork  = (int*) malloc( sizeof(int) * ew->liwork );
+    ew->Z      = NULL;
+    ew->isuppz = NULL;
+    ew->n = (_info == 0 && ew->work != NULL && ew->iwork != NULL) ? n : 0;
+#if defined(USE_SYEVR)
+    ew->Z      = (NUMTYPE*) malloc( sizeof(NUMTYPE) * n * n );
+    ew->isuppz = (int*) malloc( sizeof(int) * 2 * n );
+    if (ew->Z == NULL || ew->isuppz == NULL) {
+      ew->n = 0;
+    }
+#endif
+
+    if (ew->n == 0) {
+      return 0;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Find the decomposition. xSYEVR leaves E alone and puts the eigenvectors
+  // in a separate matrix, so they need to be copied back.
+  //////////////////////////////////////////////////////////////////////////////
+#if defined(USE_SYEV)
+  xSYEV( &_jobz, &_uplo, &n, E->elem, &(E->ld), d, ew->work, &ew->lwork,
+         &_info );
+#elif defined(USE_SYEVR)
+  xSYEVR( &_jobz, &range, &_uplo, &n, E->elem, &(E->ld), &vl, &vu, &il, &iu,
+          &abstol, &m, d, ew->Z, &n, ew->isuppz, ew->work, &ew->lwork,
+          ew->iwork, &ew->liwork, &_info );
+  for (col = 0; col < n && _info == 0; col++) {
+    memcpy( E->elem + col * E->ld, ew->Z + col * n, sizeof(NUMTYPE) * n );
+  }
+#else
+  xSYEVD( &_jobz, &_uplo, &n, E->elem, &(E->ld), d, ew->work, &ew->lwork,
+          ew->iwork, &ew->liwork, &_info );
+#endif
+
+  return (_info == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void eig_createKey( void )
+{
+  _eig_key_ok = (pthread_key_create( &_eig_key, eig_freeWork ) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void eig_freeWork( void *data )
+{
+  EigWork *ew = (EigWork*) data;
+
+  free( ew->work );
+  free( ew->iwork );
+  free( ew->Z );
+  free( ew->isuppz );
+  free( ew );
+}